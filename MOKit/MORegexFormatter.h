@@ -35,7 +35,8 @@ extern "C" {
     unsigned _lastMatchedExpressionIndex;
     struct __rfFlags {
         unsigned int allowsEmptyString:1;
-        unsigned int RESERVED:31;
+        unsigned int expressionSetIsCurrent:1;
+        unsigned int RESERVED:30;
     } _rfFlags;
     void *_reserved;
 }
@@ -135,7 +136,7 @@ extern "C" {
 /*!
  @method validateString:matchedExpressionIndex:
  @abstract Checks a string against the regular expression list.
- @discussion This method is automatically invoked by the -getObjectValue:forString:errorDescription: method.  You should not need to call it directly, but subclasses can override it.  This method should take the -allowsEmptyString setting into account.  This method is responsible for validating input strings and for identifying which regular expression of the formatter matched the string if it is valid.  MORegexFormatter implements this to check for empty string, and if the string is empty, check whether it is valid or not using the -allowsEmptyString setting (if the string is empty and valid, the matchedIndex is set to NSNotFound).  If the string is not empty, it is checked against the formatters regular expressions until a match is found or all the expressions are tested.
+ @discussion This method is automatically invoked by the -getObjectValue:forString:errorDescription: method.  You should not need to call it directly, but subclasses can override it.  This method should take the -allowsEmptyString setting into account.  This method is responsible for validating input strings and for identifying which regular expression of the formatter matched the string if it is valid.  MORegexFormatter implements this to check for empty string, and if the string is empty, check whether it is valid or not using the -allowsEmptyString setting (if the string is empty and valid, the matchedIndex is set to NSNotFound).  If the string is not empty, it is checked against the formatters regular expressions until a match is found or all the expressions are tested.  When the formatter has several expressions, and all of them are plain MORegularExpression instances, they are compiled together into a set which checks the string against every expression in a single pass, finding the same lowest matching index as testing them one at a time would.
  @param string The candidate string.
  @param matchedIndex A pointer to an unsigned int that will be set to the index of the matched regular expression if the return value is YES.
  @result YES if the string matches one of the formatter's regular expressions, NO otherwise.
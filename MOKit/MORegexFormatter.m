@@ -8,6 +8,7 @@
 #import <MOKit/MORegularExpression.h>
 #import <MOKit/MORuntimeUtilities.h>
 #import <MOKit/MOAssertions.h>
+#import <MOKit/MORegularExpression_Private.h>
 
 typedef enum {
     MOInitialVersion = 1,
@@ -15,6 +16,13 @@ typedef enum {
 
 static const MOClassVersion MOCurrentClassVersion = MOInitialVersion;
 
+@interface MORegexFormatter (MOPrivate)
+
+- (void *)_MO_expressionSet;
+- (void)_MO_invalidateExpressionSet;
+
+@end
+
 @implementation MORegexFormatter
 
 + (void)initialize {
@@ -51,6 +59,8 @@ static const MOClassVersion MOCurrentClassVersion = MOInitialVersion;
         }
         _lastMatchedExpressionIndex = NSNotFound;
         _rfFlags.allowsEmptyString = YES;
+        _rfFlags.expressionSetIsCurrent = NO;
+        _reserved = NULL;
         [self setFormatPattern:nil];
     }
 
@@ -66,6 +76,7 @@ static const MOClassVersion MOCurrentClassVersion = MOInitialVersion;
 }
 
 - (void)dealloc {
+    [self _MO_invalidateExpressionSet];
     [_expressions release];
     [super dealloc];
 }
@@ -76,6 +87,9 @@ static const MOClassVersion MOCurrentClassVersion = MOInitialVersion;
         copyObj->_expressions = [_expressions copyWithZone:zone];
         copyObj->_lastMatchedExpressionIndex = NSNotFound;
         copyObj->_rfFlags.allowsEmptyString = _rfFlags.allowsEmptyString;
+        // The compiled set is not shared, the copy builds its own if it needs one.
+        copyObj->_rfFlags.expressionSetIsCurrent = NO;
+        copyObj->_reserved = NULL;
         copyObj->_formatPattern = [_formatPattern copyWithZone:zone];
     }
 
@@ -136,6 +150,8 @@ static const MOClassVersion MOCurrentClassVersion = MOInitialVersion;
         }
     }
     _lastMatchedExpressionIndex = NSNotFound;
+    _rfFlags.expressionSetIsCurrent = NO;
+    _reserved = NULL;
     return self;
 }
 
@@ -151,6 +167,7 @@ static const MOClassVersion MOCurrentClassVersion = MOInitialVersion;
         _expressions = [[NSMutableArray allocWithZone:[self zone]] init];
     }
     [_expressions insertObject:expression atIndex:index];
+    [self _MO_invalidateExpressionSet];
 }
 
 - (void)addRegularExpression:(MORegularExpression *)expression {
@@ -164,6 +181,7 @@ static const MOClassVersion MOCurrentClassVersion = MOInitialVersion;
 
     if (_expressions) {
         [_expressions removeObjectAtIndex:index];
+        [self _MO_invalidateExpressionSet];
     }
 }
 
@@ -175,6 +193,7 @@ static const MOClassVersion MOCurrentClassVersion = MOInitialVersion;
         [NSException raise:NSRangeException format:@"*** %@: array index beyond end of array.", MOFullMethodName(self, _cmd)];
     }
     [_expressions replaceObjectAtIndex:index withObject:expression];
+    [self _MO_invalidateExpressionSet];
 }
 
 - (BOOL)allowsEmptyString {
@@ -202,6 +221,8 @@ static const MOClassVersion MOCurrentClassVersion = MOInitialVersion;
     return [obj description];
 }
 
+#define STACK_BUFF_SIZE 256
+
 - (BOOL)validateString:(NSString *)string matchedExpressionIndex:(unsigned *)matchedIndex {
     MOAssertStringOrNil(string);
     MOParameterAssert(matchedIndex != NULL);
@@ -220,6 +241,33 @@ static const MOClassVersion MOCurrentClassVersion = MOInitialVersion;
     // Now check expressions
     if (_expressions) {
         unsigned i, c = [_expressions count];
+        void *set = ((c > 1) ? [self _MO_expressionSet] : NULL);
+
+        if (set) {
+            // One pass over the string checks it against all the expressions.
+            const unichar *nativeBuff = CFStringGetCharactersPtr((CFStringRef)string);
+            unsigned len = [string length];
+
+            if (nativeBuff) {
+                i = MO_IndexOfFirstExpressionInSetMatchingCharactersInRange(nativeBuff, NSMakeRange(0, len), set);
+            } else {
+                unichar stackBuff[STACK_BUFF_SIZE];
+                unichar *charBuff = ((len <= STACK_BUFF_SIZE) ? stackBuff : malloc(len * sizeof(unichar)));
+
+                [string getCharacters:charBuff];
+                i = MO_IndexOfFirstExpressionInSetMatchingCharactersInRange(charBuff, NSMakeRange(0, len), set);
+                if (charBuff != stackBuff) {
+                    free(charBuff);
+                }
+            }
+            if (i != NSNotFound) {
+                if (matchedIndex) {
+                    *matchedIndex = i;
+                }
+                return YES;
+            }
+            return NO;
+        }
         for (i=0; i<c; i++) {
             if ([[_expressions objectAtIndex:i] matchesString:string]) {
                 if (matchedIndex) {
@@ -361,6 +409,31 @@ static const MOClassVersion MOCurrentClassVersion = MOInitialVersion;
     }
 }
 
+- (void *)_MO_expressionSet {
+    // Returns the expressions compiled as a set, or NULL if they cannot be matched that way.  The set is built lazily and kept in _reserved until the list of expressions changes.
+    if (!_rfFlags.expressionSetIsCurrent) {
+        unsigned i, c = [_expressions count];
+
+        // Subclasses of MORegularExpression might match differently, so only plain instances go in a set.
+        for (i=0; i<c; i++) {
+            if ([[_expressions objectAtIndex:i] class] != [MORegularExpression class]) {
+                break;
+            }
+        }
+        _reserved = (((c > 0) && (i == c)) ? MO_TestAndCompileExpressionSet(_expressions) : NULL);
+        _rfFlags.expressionSetIsCurrent = YES;
+    }
+    return _reserved;
+}
+
+- (void)_MO_invalidateExpressionSet {
+    if (_reserved) {
+        MO_FreeRegex(_reserved);
+        _reserved = NULL;
+    }
+    _rfFlags.expressionSetIsCurrent = NO;
+}
+
 @end
 
 
@@ -0,0 +1,169 @@
+/* ---:mferris: This file contains NO external definitions. */
+
+/*
+ * Bit-parallel form of small compacted NFAs.
+ * This file is #included by regcomp.c.
+ *
+ * An NFA whose full DFA is too big for determinize() can still be small
+ * enough that any set of its states fits in one machine word, if we're
+ * careful about what a bit stands for.  A bit per NFA state won't do by
+ * itself, since where a set goes next depends on which arcs carry the
+ * color in hand.  So each bit is a state together with the color of the
+ * arcs coming into it (a Glushkov position, more or less):  then every
+ * arc out of a state that is in the set at all leads to the same bits,
+ * whatever the color, and the color just says which of those survive.
+ * The step is an OR of precomputed successor sets, four bits at a time,
+ * and one AND.  Flags come out exactly as miss() would give them, so
+ * exec can use this in place of the lazy DFA with the same results.
+ */
+
+
+
+/*
+ - bitnfa - build the bit-parallel form of a compacted NFA, if it fits
+ * Not worth it if there's a full DFA, and can't be done with lookahead
+ * constraints.  Running out of bits isn't an error, just a reason not to.
+ ^ static VOID bitnfa(struct vars *, struct cnfa *);
+ */
+static VOID
+bitnfa(v, cnfa)
+struct vars *v;
+struct cnfa *cnfa;
+{
+	int nco = cnfa->ncolors;
+	int n = cnfa->nstates;
+	int *posof;		/* [state*nco + co] -> position, or -1 */
+	bpword *smask;		/* [state] -> its positions */
+	bpword *succ;		/* [state] -> positions its arcs lead to */
+	int *pstate;		/* [position] -> its state */
+	int npos;
+	int nib;
+	int i;
+	int j;
+	int k;
+	int co;
+	int any;
+	bpword m;
+	struct carc *ca;
+	struct bpnfa *bp;
+
+	if (NULLCNFA(*cnfa) || (cnfa->flags&HASLACONS) || cnfa->dtab != NULL)
+		return;
+	assert(cnfa->bits == NULL);
+	if (n > (int)BPBITS)		/* at least a position per state */
+		return;
+
+	posof = (int *)MALLOC(n * nco * sizeof(int));
+	smask = (bpword *)MALLOC(2 * n * sizeof(bpword));
+	pstate = (int *)MALLOC(BPBITS * sizeof(int));
+	if (posof == NULL || smask == NULL || pstate == NULL) {
+		if (posof != NULL)
+			FREE(posof);
+		if (smask != NULL)
+			FREE(smask);
+		if (pstate != NULL)
+			FREE(pstate);
+		ERR(REG_ESPACE);
+		return;
+	}
+	succ = &smask[n];
+	for (i = 0; i < n * nco; i++)
+		posof[i] = -1;
+	for (i = 0; i < n; i++)
+		for (ca = cnfa->states[i]+1; ca->co != COLORLESS; ca++)
+			posof[ca->to*nco + ca->co] = -2;	/* to be numbered */
+
+	/* number the positions, giving states nothing enters one anyway */
+	npos = 0;
+	for (i = 0; i < n && npos <= (int)BPBITS; i++) {
+		smask[i] = 0;
+		any = 0;
+		for (co = 0; co < nco; co++)
+			if (posof[i*nco + co] == -2) {
+				any = 1;
+				if (npos < (int)BPBITS) {
+					smask[i] |= (bpword)1 << npos;
+					pstate[npos] = i;
+				}
+				posof[i*nco + co] = npos++;
+			}
+		if (!any) {
+			if (npos < (int)BPBITS) {
+				smask[i] |= (bpword)1 << npos;
+				pstate[npos] = i;
+			}
+			npos++;
+		}
+	}
+	if (npos > (int)BPBITS) {
+		FREE(posof);
+		FREE(smask);
+		FREE(pstate);
+		return;
+	}
+	for (i = 0; i < n; i++) {
+		succ[i] = 0;
+		for (ca = cnfa->states[i]+1; ca->co != COLORLESS; ca++)
+			succ[i] |= (bpword)1 << posof[ca->to*nco + ca->co];
+	}
+
+	nib = BPNIBBLES(npos);
+	bp = (struct bpnfa *)MALLOC(sizeof(struct bpnfa));
+	if (bp != NULL) {
+		bp->follow = (bpword *)MALLOC((nib*16 + nco) * sizeof(bpword));
+		if (bp->follow == NULL) {
+			FREE(bp);
+			bp = NULL;
+		}
+	}
+	if (bp == NULL) {
+		FREE(posof);
+		FREE(smask);
+		FREE(pstate);
+		ERR(REG_ESPACE);
+		return;
+	}
+	bp->npos = npos;
+	bp->colors = &bp->follow[nib*16];
+	for (k = 0; k < nib; k++)
+		for (j = 0; j < 16; j++) {
+			m = 0;
+			for (i = 0; i < 4; i++)
+				if ((j & (1 << i)) && 4*k + i < npos)
+					m |= succ[pstate[4*k + i]];
+			bp->follow[k*16 + j] = m;
+		}
+	for (co = 0; co < nco; co++) {
+		m = 0;
+		for (i = 0; i < n; i++)
+			if (posof[i*nco + co] >= 0)
+				m |= (bpword)1 << posof[i*nco + co];
+		bp->colors[co] = m;
+	}
+
+	/* as initialize() and miss() have it */
+	bp->start = 0;
+	if (cnfa->flags&MIDSTART) {
+		for (i = 0; i < n; i++)
+			if (i != cnfa->pre && i != cnfa->post)
+				bp->start |= smask[i];
+	} else
+		bp->start = smask[cnfa->pre];
+	bp->post = smask[cnfa->post];
+	bp->progress = 0;
+	bp->live = 0;
+	bp->always = 0;
+	for (i = 0; i < n; i++) {
+		if (!cnfa->states[i]->co)
+			bp->progress |= smask[i];
+		if (!(cnfa->states[i]->to&CDEAD))
+			bp->live |= smask[i];
+		if (cnfa->states[i]->to&CALWAYS)
+			bp->always |= smask[i];
+	}
+	cnfa->bits = bp;
+
+	FREE(posof);
+	FREE(smask);
+	FREE(pstate);
+}
@@ -83,6 +83,10 @@ struct colormap *cm;
 	for (i = BYTTAB-1; i >= 0; i--)
 		t->tcolor[i] = WHITE;
 	cd->block = t;
+
+#if NBYTS == 2
+	cm->blocks = NULL;		/* see flattencm() */
+#endif
 }
 
 /*
@@ -107,6 +111,10 @@ struct colormap *cm;
 		}
 	if (cm->cd != cm->cdspace)
 		FREE(cm->cd);
+#if NBYTS == 2
+	if (cm->blocks != NULL)
+		FREE(cm->blocks);
+#endif
 }
 
 /*
@@ -423,9 +431,11 @@ struct state *rp;
 	if (from > to)			/* didn't reach a boundary */
 		return;
 
-	/* deal with whole blocks */
+	/* deal with whole blocks (an 8-bit chr range never holds one) */
+#if NBYTS > 1
 	for (; to - from >= BYTTAB; from += BYTTAB)
 		subblock(v, from, lp, rp);
+#endif
 
 	/* clean up any remaining partial table */
 	for (; from <= to; from++)
@@ -434,8 +444,11 @@ struct state *rp;
 
 /*
  - subblock - allocate new subcolors for one tree block of chrs, fill in arcs
+ ^ #if NBYTS > 1
  ^ static VOID subblock(struct vars *, pchr, struct state *, struct state *);
+ ^ #endif
  */
+#if NBYTS > 1
 static VOID
 subblock(v, start, lp, rp)
 struct vars *v;
@@ -522,6 +535,7 @@ struct state *rp;
 		cm->cd[sco].nchrs += ndone;
 	}
 }
+#endif				/* if NBYTS > 1 */
 
 /*
  - okcolors - promote subcolors to full colors
@@ -554,12 +568,9 @@ struct colormap *cm;
 			scd->sub = NOSUB;
 			while ((a = cd->arcs) != NULL) {
 				assert(a->co == co);
-				/* uncolorchain(cm, a); */
-				cd->arcs = a->colorchain;
+				uncolorchain(cm, a);
 				a->co = sco;
-				/* colorchain(cm, a); */
-				a->colorchain = scd->arcs;
-				scd->arcs = a;
+				colorchain(cm, a);
 			}
 			freecolor(cm, co);
 		} else {
@@ -588,7 +599,10 @@ struct arc *a;
 {
 	struct colordesc *cd = &cm->cd[a->co];
 
+	if (cd->arcs != NULL)
+		cd->arcs->colorchainRev = a;
 	a->colorchain = cd->arcs;
+	a->colorchainRev = NULL;
 	cd->arcs = a;
 }
 
@@ -602,18 +616,19 @@ struct colormap *cm;
 struct arc *a;
 {
 	struct colordesc *cd = &cm->cd[a->co];
-	struct arc *aa;
+	struct arc *aa = a->colorchainRev;
 
-	aa = cd->arcs;
-	if (aa == a)		/* easy case */
+	if (aa == NULL) {
+		assert(cd->arcs == a);
 		cd->arcs = a->colorchain;
-	else {
-		for (; aa != NULL && aa->colorchain != a; aa = aa->colorchain)
-			continue;
-		assert(aa != NULL);
+	} else {
+		assert(aa->colorchain == a);
 		aa->colorchain = a->colorchain;
 	}
+	if (a->colorchain != NULL)
+		a->colorchain->colorchainRev = aa;
 	a->colorchain = NULL;	/* paranoia */
+	a->colorchainRev = NULL;
 }
 
 /*
@@ -633,6 +648,44 @@ pchr c;
 	return 0;
 }
 
+/*
+ - colorchr - which character is alone in this color?
+ * Solid blocks can't hold it, so only the mixed ones need looking at.
+ ^ static chr colorchr(struct colormap *, pcolor);
+ */
+static chr
+colorchr(cm, co)
+struct colormap *cm;
+pcolor co;
+{
+#if NBYTS == 2
+	union tree *t;
+	int i;
+	int j;
+
+	assert(cm->cd[co].nchrs == 1 && cm->cd[co].sub == NOSUB);
+	for (i = 0; i < BYTTAB; i++) {
+		t = cm->tree->tptr[i];
+		if (t == &cm->tree[1] || t == cm->cd[t->tcolor[0]].block)
+			continue;	/* NOTE CONTINUE */
+		for (j = 0; j < BYTTAB; j++)
+			if (t->tcolor[j] == co)
+				return (chr)((i << BYTBITS) | j);
+	}
+#else
+	uchr c;
+
+	assert(cm->cd[co].nchrs == 1 && cm->cd[co].sub == NOSUB);
+	for (c = CHR_MIN; c < CHR_MAX; c++)
+		if (GETCOLOR(cm, c) == co)
+			return (chr)c;
+	if (GETCOLOR(cm, CHR_MAX) == co)
+		return (chr)CHR_MAX;
+#endif
+	assert(NOTREACHED);
+	return 0;
+}
+
 /*
  - rainbow - add arcs of all full colors (but one) between specified states
  ^ static VOID rainbow(struct nfa *, struct colormap *, int, pcolor,
@@ -685,6 +738,65 @@ struct state *to;
 
 
 
+/*
+ - flattencm - make the flat copy of a finished colormap, for exec
+ * For NBYTS == 2, exec's hot loops use FGETCOLOR(), which indexes one
+ * vector holding the distinct bottom-level blocks end to end (by a byte
+ * index per high byt) instead of chasing the tree's pointers.  Solid
+ * blocks are shared, so this is usually small.  The tree is left alone.
+ ^ static VOID flattencm(struct colormap *);
+ */
+static VOID
+flattencm(cm)
+struct colormap *cm;
+{
+#if NBYTS == 2
+	int i;
+	union tree *blks[BYTTAB];
+	unsigned sums[BYTTAB];
+	unsigned sum;
+	int nblks;
+	int j;
+	union tree *t;
+
+	/* find the distinct blocks, comparing contents (solid ones repeat) */
+	nblks = 0;
+	for (i = 0; i < BYTTAB; i++) {
+		t = cm->tree->tptr[i];
+		sum = 0;
+		for (j = 0; j < BYTTAB; j++)
+			sum = sum*31 + (unsigned)t->tcolor[j];
+		for (j = 0; j < nblks; j++)
+			if (blks[j] == t || (sums[j] == sum &&
+					memcmp(VS(blks[j]->tcolor), VS(t->tcolor),
+						sizeof(struct colors)) == 0))
+				break;		/* NOTE BREAK OUT */
+		if (j == nblks) {
+			blks[nblks] = t;
+			sums[nblks] = sum;
+			nblks++;
+		}
+		cm->blkidx[i] = (unsigned char)j;
+	}
+
+	assert(cm->blocks == NULL);
+	cm->blocks = (color *)MALLOC(nblks * sizeof(struct colors));
+	if (cm->blocks == NULL) {
+		CERR(REG_ESPACE);
+		return;
+	}
+	for (j = 0; j < nblks; j++)
+		memcpy(VS(&cm->blocks[j * BYTTAB]), VS(blks[j]->tcolor),
+							sizeof(struct colors));
+
+#ifdef REG_DEBUG
+	for (i = CHR_MIN; i <= CHR_MAX; i++)
+		assert(FGETCOLOR(cm, (uchr)i) == GETCOLOR(cm, (uchr)i));
+#endif
+#endif
+}
+
+
 #ifdef REG_DEBUG
 /*
  ^ #ifdef REG_DEBUG
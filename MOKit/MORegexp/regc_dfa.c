@@ -0,0 +1,344 @@
+/* ---:mferris: This file contains NO external definitions. */
+
+/*
+ * Full DFA construction, for small compacted NFAs.
+ * This file is #included by regcomp.c.
+ *
+ * The lazy DFA in rege_dfa.c builds state sets as the string demands
+ * them, which costs a cache miss the first time each transition is seen
+ * and a bitvector per set.  For an NFA small enough that the complete DFA
+ * is cheap, we build it here instead, minimize it, and leave exec a
+ * dense table to walk.  State sets get the same flags miss() would give
+ * them, and minimization keeps states with different flags apart, so the
+ * table walk sees success and no-progress points exactly where the lazy
+ * DFA would.
+ */
+
+#define	DAUTOSTATES	32	/* NFAs this small get a table unasked... */
+#define	DAUTOCOLORS	64	/* ...if they don't use too many colors... */
+#define	DAUTOMAX	128	/* ...and the DFA doesn't blow up */
+#define	DMAXSTATES	4096	/* limit when REG_FULLDFA asks for tables */
+#define	DMAXCELLS	(1<<20)	/* limit on states*colors, either way */
+
+
+
+/*
+ - determinize - build the full DFA for a compacted NFA, if it's small
+ * NFAs with lookahead constraints can't be done, since which way those
+ * go depends on the string.  Running into our limits on size isn't an
+ * error, just a reason not to bother.
+ ^ static VOID determinize(struct vars *, struct cnfa *);
+ */
+static VOID
+determinize(v, cnfa)
+struct vars *v;
+struct cnfa *cnfa;
+{
+	int nco = cnfa->ncolors;
+	int wordsper = (cnfa->nstates + UBITS - 1) / UBITS;
+	int max;		/* most DFA states we'll stand for */
+	unsigned *sets;		/* state sets, as bitvectors, plus work */
+	unsigned *work;
+	unsigned *bv;
+	int *trans;		/* [state*nco + co] -> state */
+	char *flags;		/* DPOST, DNOPR and DALWAYS, per state */
+	int *hashtab;		/* open-addressed index of sets */
+	int hmask;
+	unsigned h;
+	int n;			/* how many DFA states so far */
+	int i;
+	int j;
+	int k;
+	int co;
+	int ispost;
+	int noprogress;
+	int gotstate;
+	int always;
+	int nodead;		/* don't count dead sets as empty */
+	struct carc *ca;
+
+	if (NULLCNFA(*cnfa) || (cnfa->flags&HASLACONS))
+		return;
+	assert(cnfa->dtab == NULL);
+	if (v->cflags&REG_FULLDFA)
+		max = DMAXSTATES;
+	else if (cnfa->nstates <= DAUTOSTATES && nco <= DAUTOCOLORS)
+		max = DAUTOMAX;
+	else
+		return;
+	if (max > DMAXCELLS / nco)
+		max = DMAXCELLS / nco;
+	if (max < 2)			/* can't even hold DDEAD and DSTART */
+		return;
+
+	for (hmask = 1; hmask < 2*max; hmask <<= 1)
+		continue;
+	sets = (unsigned *)MALLOC((max+1) * wordsper * sizeof(unsigned));
+	trans = (int *)MALLOC(max * nco * sizeof(int));
+	flags = (char *)MALLOC(max);
+	hashtab = (int *)MALLOC(hmask * sizeof(int));
+	if (sets == NULL || trans == NULL || flags == NULL || hashtab == NULL) {
+		if (sets != NULL)
+			FREE(sets);
+		if (trans != NULL)
+			FREE(trans);
+		if (flags != NULL)
+			FREE(flags);
+		if (hashtab != NULL)
+			FREE(hashtab);
+		ERR(REG_ESPACE);
+		return;
+	}
+	hmask--;
+	for (i = 0; i <= hmask; i++)
+		hashtab[i] = -1;
+	work = &sets[max * wordsper];
+	nodead = !(cnfa->flags&HASDEAD) || (v->cflags&REG_EXPECT);
+
+	/* the empty set, which goes nowhere, and the initial set */
+	for (i = 0; i < 2*wordsper; i++)
+		sets[i] = 0;
+	flags[DDEAD] = 0;
+	if (cnfa->flags&MIDSTART) {
+		for (k = 0; k < cnfa->nstates; k++)
+			if (k != cnfa->pre && k != cnfa->post)
+				BSET(&sets[wordsper], k);
+	} else
+		BSET(&sets[wordsper], cnfa->pre);
+	flags[1] = DNOPR;		/* as initialize() has it */
+	n = 2;
+	h = dsethash(&sets[wordsper], wordsper);
+	hashtab[h & hmask] = 1;
+
+	/* subset construction, in the same way miss() does it */
+	for (i = 0; i < n; i++) {
+		bv = &sets[i * wordsper];
+		for (co = 0; co < nco; co++) {
+			for (k = 0; k < wordsper; k++)
+				work[k] = 0;
+			ispost = 0;
+			noprogress = 1;
+			gotstate = 0;
+			for (k = 0; k < cnfa->nstates; k++)
+				if (ISBSET(bv, k))
+					for (ca = cnfa->states[k]+1;
+						ca->co != COLORLESS; ca++)
+						if (ca->co == co) {
+							BSET(work, ca->to);
+							gotstate = 1;
+							if (ca->to == cnfa->post)
+								ispost = 1;
+							if (!cnfa->states[ca->to]->co)
+								noprogress = 0;
+						}
+			if (gotstate && !nodead) {
+				for (k = 0; k < cnfa->nstates; k++)
+					if (ISBSET(work, k) &&
+						!(cnfa->states[k]->to&CDEAD))
+						break;	/* NOTE BREAK OUT */
+				if (k == cnfa->nstates)
+					gotstate = 0;	/* dead, so empty */
+			}
+			if (!gotstate) {
+				trans[i*nco + co] = DDEAD;
+				continue;	/* NOTE CONTINUE */
+			}
+			always = 0;
+			for (k = 0; k < cnfa->nstates && ispost && !always; k++)
+				if (ISBSET(work, k) &&
+					(cnfa->states[k]->to&CALWAYS))
+					always = 1;
+
+			/* seen it already? */
+			h = dsethash(work, wordsper);
+			for (k = h & hmask; (j = hashtab[k]) >= 0;
+							k = (k+1) & hmask)
+				if (memcmp(VS(&sets[j * wordsper]), VS(work),
+						wordsper*sizeof(unsigned)) == 0)
+					break;	/* NOTE BREAK OUT */
+			if (j < 0) {		/* no, a new one */
+				if (n == max)
+					break;	/* NOTE BREAK OUT */
+				j = n++;
+				memcpy(VS(&sets[j * wordsper]), VS(work),
+						wordsper*sizeof(unsigned));
+				flags[j] = (ispost) ? DPOST : 0;
+				if (noprogress)
+					flags[j] |= DNOPR;
+				if (always)
+					flags[j] |= DALWAYS;
+				hashtab[k] = j;
+			}
+			trans[i*nco + co] = j;
+		}
+		if (co < nco)		/* ran out of room */
+			break;		/* NOTE BREAK OUT */
+	}
+
+	if (i == n)
+		dminimize(v, cnfa, n, trans, flags);
+	FREE(sets);
+	FREE(trans);
+	FREE(flags);
+	FREE(hashtab);
+}
+
+/*
+ - dsethash - hash a state-set bitvector for determinize()
+ ^ static unsigned dsethash(unsigned *, int);
+ */
+static unsigned
+dsethash(bv, n)
+unsigned *bv;
+int n;
+{
+	unsigned h;
+	int i;
+
+	h = 0;
+	for (i = 0; i < n; i++)
+		h = ((h << 7) | (h >> (UBITS - 7))) ^ bv[i];
+	return h * 0x9e3779b1U;
+}
+
+/*
+ - dminimize - minimize a finished DFA and store it as the cnfa's dtab
+ * Classic refinement:  start with the states grouped by flags (and the
+ * empty set by itself, since exec stops there), then keep splitting
+ * groups whose members go to different groups on some color, until
+ * nothing splits.  Each group becomes one state of the table.
+ ^ static VOID dminimize(struct vars *, struct cnfa *, int, int *, char *);
+ */
+static VOID
+dminimize(v, cnfa, n, trans, flags)
+struct vars *v;
+struct cnfa *cnfa;
+int n;				/* number of states */
+int *trans;			/* [state*nco + co] -> state */
+char *flags;
+{
+	int nco = cnfa->ncolors;
+	int *cls;		/* group of each state */
+	int *ncls;		/* same, being worked out */
+	int *tmp;
+	int *hashtab;		/* representative states, by signature */
+	int hmask;
+	int ngroups;
+	int nnew;
+	unsigned h;
+	int i;
+	int j;
+	int k;
+	int co;
+	struct dtab *dt;
+	int *map;		/* group -> table state, reusing ncls */
+	char *gflags;
+
+	for (hmask = 1; hmask < 2*n; hmask <<= 1)
+		continue;
+	cls = (int *)MALLOC(n * sizeof(int));
+	ncls = (int *)MALLOC(n * sizeof(int));
+	hashtab = (int *)MALLOC(hmask * sizeof(int));
+	gflags = (char *)MALLOC(n);
+	if (cls == NULL || ncls == NULL || hashtab == NULL || gflags == NULL) {
+		if (cls != NULL)
+			FREE(cls);
+		if (ncls != NULL)
+			FREE(ncls);
+		if (hashtab != NULL)
+			FREE(hashtab);
+		if (gflags != NULL)
+			FREE(gflags);
+		ERR(REG_ESPACE);
+		return;
+	}
+	hmask--;
+
+	/* initial groups:  DDEAD alone, and the rest by flags */
+	cls[DDEAD] = 0;
+	for (i = 1; i < n; i++)
+		cls[i] = 1 + flags[i];
+	ngroups = 0;			/* not the true count, but < any */
+
+	/* refine until stable */
+	for (;;) {
+		for (i = 0; i <= hmask; i++)
+			hashtab[i] = -1;
+		nnew = 0;
+		for (i = 0; i < n; i++) {
+			h = cls[i];
+			for (co = 0; co < nco; co++)
+				h = h*31 + cls[trans[i*nco + co]];
+			for (k = (h * 0x9e3779b1U) & hmask;
+					(j = hashtab[k]) >= 0; k = (k+1) & hmask) {
+				if (cls[j] != cls[i])
+					continue;	/* NOTE CONTINUE */
+				for (co = 0; co < nco; co++)
+					if (cls[trans[j*nco + co]] !=
+							cls[trans[i*nco + co]])
+						break;	/* NOTE BREAK OUT */
+				if (co == nco)
+					break;		/* NOTE BREAK OUT */
+			}
+			if (j < 0) {
+				hashtab[k] = i;
+				ncls[i] = nnew++;
+			} else
+				ncls[i] = ncls[j];
+		}
+		tmp = cls;
+		cls = ncls;
+		ncls = tmp;
+		if (nnew == ngroups)
+			break;		/* NOTE BREAK OUT */
+		ngroups = nnew;
+	}
+
+	/* number the groups so DDEAD and the initial state come first */
+	map = ncls;
+	for (i = 0; i < ngroups; i++)
+		map[i] = -1;
+	map[cls[DDEAD]] = DDEAD;
+	assert(cls[1] != cls[DDEAD]);
+	map[cls[1]] = 1;
+	j = 2;
+	for (i = 0; i < n; i++) {
+		if (map[cls[i]] < 0)
+			map[cls[i]] = j++;
+		gflags[map[cls[i]]] = flags[i];
+	}
+	assert(j == ngroups);
+
+	dt = (struct dtab *)MALLOC(sizeof(struct dtab));
+	if (dt != NULL) {
+		dt->trans = (int *)MALLOC(ngroups * nco * sizeof(int));
+		if (dt->trans == NULL) {
+			FREE(dt);
+			dt = NULL;
+		}
+	}
+	if (dt == NULL) {
+		FREE(cls);
+		FREE(ncls);
+		FREE(hashtab);
+		FREE(gflags);
+		ERR(REG_ESPACE);
+		return;
+	}
+	dt->nstates = ngroups;
+	for (i = 0; i < n; i++) {
+		k = map[cls[i]];
+		for (co = 0; co < nco; co++) {
+			j = map[cls[trans[i*nco + co]]];
+			dt->trans[k*nco + co] = ((j*nco) << DSHIFT) | gflags[j];
+		}
+	}
+	assert(dt->trans[DDEAD] == DDEAD);
+	dt->start = ((1*nco) << DSHIFT) | gflags[1];
+	cnfa->dtab = dt;
+
+	FREE(cls);
+	FREE(ncls);
+	FREE(hashtab);
+	FREE(gflags);
+}
@@ -856,6 +856,10 @@ int maxlen;
 	}
 	if (len < minlen)
 		ERR(REG_EESCAPE);
+#if CHRBITS == 8
+	if (n > CHR_MAX)		/* \u0100 and up are no chr here */
+		ERR(REG_EESCAPE);
+#endif
 
 	return (chr)n;
 }
@@ -0,0 +1,515 @@
+/* ---:mferris: This file contains NO external definitions. */
+
+/*
+ * Required-literal extraction.
+ * This file is #included by regcomp.c.
+ *
+ * If every path through the NFA runs through some state, and from there
+ * on the path is forced along arcs each of which matches just one chr,
+ * then every match contains that string of chrs.  Exec can look for it
+ * with a cheap scan, and give up at once on strings lacking it.
+ *
+ * Separately, if the paths out of the start all spell out one of a
+ * small set of literal strings before anything else can happen, every
+ * match starts with one of them, and the search DFA can skip ahead to
+ * the next place where one occurs whenever it has nothing in progress.
+ *
+ * Failing prefixes, knowing which colors a match can start with serves
+ * the same purpose, less sharply.  And the bounds on the length of a
+ * match, and whether it must start at the beginning, let exec turn down
+ * short strings unseen and go straight to the match when there's only
+ * one place it can start.
+ */
+
+#define	MAXLITSTATES	1000	/* don't bother with NFAs bigger than this */
+#define	PFXWORK		2000	/* most steps findpfx() will take */
+#define	COMMON		50	/* chrrank() above this is everyday text */
+
+
+
+/*
+ - findlit - find a literal that every match must contain, if any
+ * Works on the optimized NFA, before makesearch() scribbles on it.  The
+ * longest forced chain wins, with ties going to one that starts the match;
+ * if that one is also the whole prefix set, the prefix skip covers it.
+ ^ static VOID findlit(struct vars *, struct nfa *, struct guts *);
+ */
+static VOID
+findlit(v, nfa, g)
+struct vars *v;
+struct nfa *nfa;
+struct guts *g;
+{
+	struct state *s;
+	struct state *best;
+	struct arc *a;
+	int bestlen;
+	int bestpre;
+	int n;
+	int i;
+	int pre;
+	char *seen;		/* dominates() workspace */
+	struct state **stack;
+	chr lit[MAXLIT];
+
+	g->nlit = 0;
+	if (nfa->nstates > MAXLITSTATES)
+		return;
+	seen = (char *)MALLOC(nfa->nstates);
+	stack = (struct state **)MALLOC(nfa->nstates * sizeof(struct state *));
+	if (seen == NULL || stack == NULL) {
+		if (seen != NULL)
+			FREE(seen);
+		if (stack != NULL)
+			FREE(stack);
+		ERR(REG_ESPACE);
+		return;
+	}
+
+	best = NULL;
+	bestlen = 0;
+	bestpre = 0;
+	for (s = nfa->states; s != NULL; s = s->next) {
+		n = litchain(v, nfa, s, (chr *)NULL);
+		if (n == 0 || n < bestlen)
+			continue;	/* NOTE CONTINUE */
+		pre = 1;		/* does everything go straight from pre? */
+		for (a = nfa->pre->outs; a != NULL; a = a->outchain)
+			if (a->to != s)
+				pre = 0;
+		if (n == bestlen && (bestpre || !pre))
+			continue;	/* NOTE CONTINUE */
+		if (!dominates(nfa, s, seen, stack))
+			continue;	/* NOTE CONTINUE */
+		best = s;
+		bestlen = n;
+		bestpre = pre;
+	}
+	FREE(seen);
+	FREE(stack);
+	if (best == NULL)
+		return;
+
+	n = litchain(v, nfa, best, lit);
+	assert(n == bestlen);
+	g->litrare = 0;
+	for (i = 0; i < n; i++) {
+		g->lit[i] = lit[i];
+		if (chrrank(lit[i]) < chrrank(lit[g->litrare]))
+			g->litrare = i;
+	}
+	g->nlit = n;
+	if (bestpre && g->npfx == 1 && g->pfxlen[0] >= n)
+		g->nlit = 0;		/* redundant */
+}
+
+/*
+ - findpfx - find the set of literal prefixes of all matches, if any
+ ^ static VOID findpfx(struct vars *, struct nfa *, struct guts *);
+ */
+static VOID
+findpfx(v, nfa, g)
+struct vars *v;
+struct nfa *nfa;
+struct guts *g;
+{
+	struct arc *a;
+	struct arc *b;
+	chr str[MAXLIT];
+	int work;
+	int i;
+	int j;
+
+	g->npfx = 0;
+	work = PFXWORK;
+	for (a = nfa->pre->outs; a != NULL; a = a->outchain) {
+		if (a->type != PLAIN) {
+			g->npfx = 0;
+			return;
+		}
+		for (b = nfa->pre->outs; b != a; b = b->outchain)
+			if (b->to == a->to)
+				break;		/* NOTE BREAK OUT */
+		if (b != a)
+			continue;	/* did that state already */
+		if (!pfxwalk(v, nfa, a->to, str, 0, g, &work)) {
+			g->npfx = 0;
+			return;
+		}
+	}
+	if (g->npfx == 0)
+		return;
+
+	/* exec's aids for finding them */
+	g->nfirst = 0;
+	for (i = 0; i < BYTTAB; i++)
+		g->pfxmap[i] = 0;
+	for (i = 0; i < g->npfx; i++) {
+		for (j = 0; j < g->nfirst; j++)
+			if (g->pfxfirst[j] == g->pfx[i][0])
+				break;		/* NOTE BREAK OUT */
+		if (j == g->nfirst)
+			g->pfxfirst[g->nfirst++] = g->pfx[i][0];
+		g->pfxmap[g->pfx[i][0] & BYTMASK] = 1;
+	}
+	g->pfxrare = 0;
+	for (i = 1; i < g->pfxlen[0]; i++)
+		if (chrrank(g->pfx[0][i]) < chrrank(g->pfx[0][g->pfxrare]))
+			g->pfxrare = i;
+}
+
+/*
+ - pfxwalk - collect the literal strings leading out of a state
+ * One-chr arcs are followed, branching where there are several, up to a
+ * state where something else could happen (or MAXLIT); the strings so far
+ * are prefixes.  Returns 0 if that can't be done within our limits, e.g.
+ * if a match might begin with something other than a known chr.
+ ^ static int pfxwalk(struct vars *, struct nfa *, struct state *, chr *,
+ ^ 	int, struct guts *, int *);
+ */
+static int			/* success */
+pfxwalk(v, nfa, s, str, len, g, workp)
+struct vars *v;
+struct nfa *nfa;
+struct state *s;
+chr *str;			/* the prefix so far */
+int len;			/* and its length */
+struct guts *g;
+int *workp;			/* steps we may still take */
+{
+	struct arc *a;
+	struct colordesc *cd;
+	int i;
+
+	if (--*workp < 0)
+		return 0;
+
+	/* can every way out of s extend the string? */
+	for (a = s->outs; a != NULL && len < MAXLIT; a = a->outchain) {
+		if (a->type != PLAIN || a->to == nfa->post)
+			break;		/* NOTE BREAK OUT */
+		cd = &v->cm->cd[a->co];
+		if (cd->nchrs != 1 || cd->sub != NOSUB || (cd->flags&PSEUDO))
+			break;		/* NOTE BREAK OUT */
+	}
+	if (a != NULL || len == MAXLIT || s->outs == NULL) {
+		/* no, the string so far is a prefix */
+		if (len == 0)
+			return 0;
+		for (i = 0; i < g->npfx; i++)
+			if (g->pfxlen[i] <= len && memcmp(VS(g->pfx[i]), VS(str),
+						g->pfxlen[i]*sizeof(chr)) == 0)
+				return 1;	/* already covered */
+		if (g->npfx == MAXPFX)
+			return 0;
+		memcpy(VS(g->pfx[g->npfx]), VS(str), len*sizeof(chr));
+		g->pfxlen[g->npfx] = len;
+		g->npfx++;
+		return 1;
+	}
+
+	for (a = s->outs; a != NULL; a = a->outchain) {
+		str[len] = colorchr(v->cm, a->co);
+		if (!pfxwalk(v, nfa, a->to, str, len+1, g, workp))
+			return 0;
+	}
+	return 1;
+}
+
+/*
+ - findlens - find the bounds on match length, and how a match can start
+ * Lengths are in chrs of the match proper:  arcs from pre and to post
+ * look at context, and pseudocolors and lookahead constraints take no
+ * chrs at all.  The shortest way to post is found a level at a time, each
+ * level being the states one chr further on; the colors that can start a
+ * match are those of the first real arcs taken, out of level 0.
+ ^ static VOID findlens(struct vars *, struct nfa *, struct guts *);
+ */
+static VOID
+findlens(v, nfa, g)
+struct vars *v;
+struct nfa *nfa;
+struct guts *g;
+{
+	int n = nfa->nstates;
+	int *lo;		/* [state] -> fewest chrs to get there, or -1 */
+	struct state **cur;	/* states of this level still to look at */
+	struct state **nxt;	/* candidates for the next level */
+	struct arc **at;	/* maxpath() workspace */
+	int ncur;
+	int nnxt;
+	int level;
+	int narcs;
+	int nco;
+	int i;
+	chr c;
+	struct state *s;
+	struct arc *a;
+	unsigned char *sc;
+
+	/* anchored if the only ways out of pre are beginning of string */
+	g->anchored = (nfa->pre->outs != NULL);
+	for (a = nfa->pre->outs; a != NULL; a = a->outchain)
+		if (a->type != PLAIN || (a->co != nfa->bos[0] &&
+							a->co != nfa->bos[1]))
+			g->anchored = 0;
+
+	g->minlen = 0;
+	g->maxlen = -1;
+	if (n > MAXLITSTATES)
+		return;
+	narcs = 0;
+	for (s = nfa->states; s != NULL; s = s->next)
+		narcs += s->nouts;
+	lo = (int *)MALLOC(n * sizeof(int));
+	cur = (struct state **)MALLOC((n + narcs) * sizeof(struct state *));
+	at = (struct arc **)MALLOC(n * sizeof(struct arc *));
+	if (lo == NULL || cur == NULL || at == NULL) {
+		if (lo != NULL)
+			FREE(lo);
+		if (cur != NULL)
+			FREE(cur);
+		if (at != NULL)
+			FREE(at);
+		ERR(REG_ESPACE);
+		return;
+	}
+	nxt = &cur[n];
+
+	for (i = 0; i < n; i++)
+		lo[i] = -1;
+	lo[nfa->pre->no] = 0;
+	cur[0] = nfa->pre;
+	ncur = 1;
+	for (level = 0; ncur > 0 && lo[nfa->post->no] < 0; level++) {
+		nnxt = 0;
+		while (ncur > 0) {
+			s = cur[--ncur];
+			for (a = s->outs; a != NULL; a = a->outchain) {
+				if (lo[a->to->no] >= 0)
+					continue;	/* NOTE CONTINUE */
+				if (arclen(v, nfa, a) == 0) {
+					lo[a->to->no] = level;
+					cur[ncur++] = a->to;
+				} else
+					nxt[nnxt++] = a->to;
+			}
+		}
+		for (i = 0; i < nnxt; i++)
+			if (lo[nxt[i]->no] < 0) {
+				lo[nxt[i]->no] = level + 1;
+				cur[ncur++] = nxt[i];
+			}
+	}
+	if (lo[nfa->post->no] > 0)
+		g->minlen = lo[nfa->post->no];
+
+	/*
+	 * Start colors are worth having only if some color can't start a
+	 * match, and everyday text isn't full of chrs that can.
+	 */
+	nco = maxcolor(v->cm) + 1;
+	sc = NULL;
+	if (g->minlen > 0) {
+		sc = (unsigned char *)MALLOC(nco);
+		if (sc == NULL)
+			ERR(REG_ESPACE);
+	}
+	if (sc != NULL) {
+		for (i = 0; i < nco; i++)
+			sc[i] = 0;
+		for (s = nfa->states; s != NULL; s = s->next)
+			if (lo[s->no] == 0)
+				for (a = s->outs; a != NULL; a = a->outchain)
+					if (arclen(v, nfa, a) > 0)
+						sc[a->co] = 1;
+		for (i = 0; i < nco; i++)
+			if (!sc[i] && REALCOLOR(v->cm, i))
+				break;		/* NOTE BREAK OUT */
+		for (c = 0; c < 0x80 && i < nco; c++)
+			if (chrrank(c) > COMMON && sc[GETCOLOR(v->cm, c)])
+				i = nco;
+		if (i < nco)
+			g->startco = sc;
+		else
+			FREE(sc);
+	}
+
+	g->maxlen = maxpath(v, nfa, lo, cur, at);
+	FREE(lo);
+	FREE(cur);
+	FREE(at);
+}
+
+/*
+ - maxpath - most chrs on any path from pre to post, -1 if there's a loop
+ * Depth first, noting for each state the longest way on from it once all
+ * its successors are done; running into a state still under way means a
+ * loop, and then there's no bound.
+ ^ static int maxpath(struct vars *, struct nfa *, int *, struct state **,
+ ^ 	struct arc **);
+ */
+static int
+maxpath(v, nfa, far, stack, at)
+struct vars *v;
+struct nfa *nfa;
+int *far;			/* workspace, nfa->nstates long */
+struct state **stack;		/* ditto */
+struct arc **at;		/* ditto, each stacked state's next arc */
+{
+	struct state *s;
+	struct arc *a;
+	int sp;
+	int len;
+	int i;
+#	define	UNSEEN	(-2)
+#	define	UNDERWAY	(-1)
+
+	for (i = 0; i < nfa->nstates; i++)
+		far[i] = UNSEEN;
+	far[nfa->pre->no] = UNDERWAY;
+	stack[0] = nfa->pre;
+	at[0] = nfa->pre->outs;
+	sp = 1;
+	while (sp > 0) {
+		s = stack[sp-1];
+		a = at[sp-1];
+		if (a == NULL) {	/* successors all done */
+			far[s->no] = 0;
+			for (a = s->outs; a != NULL; a = a->outchain) {
+				len = far[a->to->no] + arclen(v, nfa, a);
+				if (len > far[s->no])
+					far[s->no] = len;
+			}
+			sp--;
+			continue;	/* NOTE CONTINUE */
+		}
+		at[sp-1] = a->outchain;
+		if (far[a->to->no] == UNDERWAY)
+			return -1;
+		if (far[a->to->no] == UNSEEN) {
+			far[a->to->no] = UNDERWAY;
+			stack[sp] = a->to;
+			at[sp] = a->to->outs;
+			sp++;
+		}
+	}
+	return far[nfa->pre->no];
+#	undef	UNSEEN
+#	undef	UNDERWAY
+}
+
+/*
+ - arclen - how many chrs of the match an arc takes, 0 or 1
+ ^ static int arclen(struct vars *, struct nfa *, struct arc *);
+ */
+static int
+arclen(v, nfa, a)
+struct vars *v;
+struct nfa *nfa;
+struct arc *a;
+{
+	if (a->type != PLAIN || a->from == nfa->pre || a->to == nfa->post)
+		return 0;
+	if (v->cm->cd[a->co].flags&PSEUDO)
+		return 0;
+	return 1;
+}
+
+/*
+ - litchain - length of the forced one-chr chain starting at a state
+ * Arcs from pre and to post are context, not part of the match, so they
+ * don't count.  If lit is non-NULL, the chrs are stored there.
+ ^ static int litchain(struct vars *, struct nfa *, struct state *, chr *);
+ */
+static int
+litchain(v, nfa, s, lit)
+struct vars *v;
+struct nfa *nfa;
+struct state *s;
+chr *lit;			/* if non-NULL, put the chrs here */
+{
+	struct arc *a;
+	struct colordesc *cd;
+	int n;
+
+	if (s == nfa->pre)
+		return 0;
+	for (n = 0; n < MAXLIT && s->nouts == 1; n++) {
+		a = s->outs;
+		if (a->type != PLAIN || a->to == nfa->post)
+			break;		/* NOTE BREAK OUT */
+		cd = &v->cm->cd[a->co];
+		if (cd->nchrs != 1 || cd->sub != NOSUB || (cd->flags&PSEUDO))
+			break;		/* NOTE BREAK OUT */
+		if (lit != NULL)
+			lit[n] = colorchr(v->cm, a->co);
+		s = a->to;
+	}
+	return n;
+}
+
+/*
+ - dominates - is every path from pre to post through this state?
+ ^ static int dominates(struct nfa *, struct state *, char *,
+ ^ 	struct state **);
+ */
+static int			/* predicate */
+dominates(nfa, s, seen, stack)
+struct nfa *nfa;
+struct state *s;
+char *seen;			/* workspace, nfa->nstates long */
+struct state **stack;		/* ditto */
+{
+	struct state *t;
+	struct arc *a;
+	int sp;
+	int i;
+
+	for (i = 0; i < nfa->nstates; i++)
+		seen[i] = 0;
+	seen[s->no] = 1;		/* can't get past it */
+	seen[nfa->pre->no] = 1;
+	sp = 0;
+	stack[sp++] = nfa->pre;
+	while (sp > 0) {
+		t = stack[--sp];
+		for (a = t->outs; a != NULL; a = a->outchain)
+			if (!seen[a->to->no]) {
+				if (a->to == nfa->post)
+					return 0;
+				seen[a->to->no] = 1;
+				stack[sp++] = a->to;
+			}
+	}
+	return 1;
+}
+
+/*
+ - chrrank - rough idea of how common a chr is in text, higher is commoner
+ * Exec scans for the least common chr of the literal, then checks the
+ * rest, so a poor guess costs time but never correctness.
+ ^ static int chrrank(pchr);
+ */
+static int
+chrrank(c)
+pchr c;
+{
+	static char common[] = " etaoinsrhldcumfpgwybvkxjqz";
+	static char punct[] = "\n.,-'\"\t:;()/";
+	char *p;
+
+	if (c >= 0x80 || c == '\0')
+		return 0;
+	if (c >= 'A' && c <= 'Z') {
+		p = strchr(common, (char)(c - 'A' + 'a'));
+		return 50 - (int)(p - common);
+	}
+	if ((p = strchr(common, (char)c)) != NULL)
+		return 100 - (int)(p - common);
+	if (c >= '0' && c <= '9')
+		return 45;
+	if (strchr(punct, (char)c) != NULL)
+		return 60;
+	return 20;
+}
@@ -120,11 +120,15 @@ static struct cname {
 	{NULL,	0}
 };
 
-/* Unicode character-class tables */
+/*
+ * Unicode character-class tables.  These are in Unicode whatever the
+ * size of chr; in the 8-bit build, tabchr() and tabrange() drop what
+ * lies beyond CHR_MAX.
+ */
 
 typedef struct crange {
-    chr start;
-    chr end;
+    MO_unichar start;
+    MO_unichar end;
 } crange;
 
 /* Unicode: (Alphabetic) */
@@ -169,7 +173,7 @@ static crange alphaRangeTable[] = {
 
 #define NUM_ALPHA_RANGE (int)(sizeof(alphaRangeTable)/sizeof(crange))
 
-static chr alphaCharTable[] = {
+static MO_unichar alphaCharTable[] = {
     0x00aa, 0x00b5, 0x00ba, 0x02d0, 0x02d1, 0x037a, 0x0386, 0x038c, 0x03da, 
     0x03dc, 0x03de, 0x03e0, 0x04c7, 0x04c8, 0x04cb, 0x04cc, 0x04f8, 0x04f9, 
     0x0559, 0x06d5, 0x06e5, 0x06e6, 0x093d, 0x0950, 0x098f, 0x0990, 0x09b2, 
@@ -184,7 +188,7 @@ static chr alphaCharTable[] = {
     0x3006, 0x309d, 0x309e, 0xfb3e, 0xfb40, 0xfb41, 0xfb43, 0xfb44, 0xfe74
 };
 
-#define NUM_ALPHA_CHAR (int)(sizeof(alphaCharTable)/sizeof(chr))
+#define NUM_ALPHA_CHAR (int)(sizeof(alphaCharTable)/sizeof(MO_unichar))
 
 /* Unicode: (Decimal digit) */
 
@@ -210,7 +214,7 @@ static crange punctRangeTable[] = {
 
 #define NUM_PUNCT_RANGE (int)(sizeof(punctRangeTable)/sizeof(crange))
 
-static chr punctCharTable[] = {
+static MO_unichar punctCharTable[] = {
     0x003a, 0x003b, 0x003f, 0x0040, 0x005f, 0x007b, 0x007d, 0x00a1, 0x00ab, 
     0x00ad, 0x00b7, 0x00bb, 0x00bf, 0x037e, 0x0387, 0x0589, 0x05be, 0x05c0, 
     0x05c3, 0x05f3, 0x05f4, 0x060c, 0x061b, 0x061f, 0x06d4, 0x0964, 0x0965, 
@@ -220,7 +224,7 @@ static chr punctCharTable[] = {
     0xff5d
 };
 
-#define NUM_PUNCT_CHAR (int)(sizeof(punctCharTable)/sizeof(chr))
+#define NUM_PUNCT_CHAR (int)(sizeof(punctCharTable)/sizeof(MO_unichar))
 
 /* Unicode: (White space) */
 
@@ -230,11 +234,11 @@ static crange spaceRangeTable[] = {
 
 #define NUM_SPACE_RANGE (int)(sizeof(spaceRangeTable)/sizeof(crange))
 
-static chr spaceCharTable[] = {
+static MO_unichar spaceCharTable[] = {
     0x0020, 0x00a0, 0x2028, 0x2029, 0x3000
 };
 
-#define NUM_SPACE_CHAR (int)(sizeof(spaceCharTable)/sizeof(chr))
+#define NUM_SPACE_CHAR (int)(sizeof(spaceCharTable)/sizeof(MO_unichar))
 
 /* Unicode: lowercase characters */
 
@@ -251,7 +255,7 @@ static crange lowerRangeTable[] = {
 
 #define NUM_LOWER_RANGE (int)(sizeof(lowerRangeTable)/sizeof(crange))
 
-static chr lowerCharTable[] = {
+static MO_unichar lowerCharTable[] = {
     0x00aa, 0x00b5, 0x00ba, 0x0101, 0x0103, 0x0105, 0x0107, 0x0109, 0x010b, 
     0x010d, 0x010f, 0x0111, 0x0113, 0x0115, 0x0117, 0x0119, 0x011b, 0x011d, 
     0x011f, 0x0121, 0x0123, 0x0125, 0x0127, 0x0129, 0x012b, 0x012d, 0x012f, 
@@ -292,7 +296,7 @@ static chr lowerCharTable[] = {
     0x210f, 0x2113, 0x2118, 0x212e, 0x212f, 0x2134
 };
 
-#define NUM_LOWER_CHAR (int)(sizeof(lowerCharTable)/sizeof(chr))
+#define NUM_LOWER_CHAR (int)(sizeof(lowerCharTable)/sizeof(MO_unichar))
 
 /* Unicode: uppercase characters */
 
@@ -310,7 +314,7 @@ static crange upperRangeTable[] = {
 
 #define NUM_UPPER_RANGE (int)(sizeof(upperRangeTable)/sizeof(crange))
 
-static chr upperCharTable[] = {
+static MO_unichar upperCharTable[] = {
     0x0100, 0x0102, 0x0104, 0x0106, 0x0108, 0x010a, 0x010c, 0x010e, 0x0110, 
     0x0112, 0x0114, 0x0116, 0x0118, 0x011a, 0x011c, 0x011e, 0x0120, 0x0122, 
     0x0124, 0x0126, 0x0128, 0x012a, 0x012c, 0x012e, 0x0130, 0x0132, 0x0134, 
@@ -351,7 +355,7 @@ static chr upperCharTable[] = {
     0x2131, 0x2133
 };
 
-#define NUM_UPPER_CHAR (int)(sizeof(upperCharTable)/sizeof(chr))
+#define NUM_UPPER_CHAR (int)(sizeof(upperCharTable)/sizeof(MO_unichar))
 
 /*
  * The graph table includes the set of characters that are Unicode
@@ -457,7 +461,7 @@ static crange graphRangeTable[] = {
 
 #define NUM_GRAPH_RANGE (int)(sizeof(graphRangeTable)/sizeof(crange))
 
-static chr graphCharTable[] = {
+static MO_unichar graphCharTable[] = {
     0x0360, 0x0361, 0x0374, 0x0375, 0x037a, 0x037e, 0x038c, 0x03da, 0x03dc, 
     0x03de, 0x03e0, 0x04c7, 0x04c8, 0x04cb, 0x04cc, 0x04f8, 0x04f9, 0x0589, 
     0x060c, 0x061b, 0x061f, 0x098f, 0x0990, 0x09b2, 0x09bc, 0x09c7, 0x09c8, 
@@ -474,7 +478,7 @@ static chr graphCharTable[] = {
     0xfffc, 0xfffd
 };
 
-#define NUM_GRAPH_CHAR (int)(sizeof(graphCharTable)/sizeof(chr))
+#define NUM_GRAPH_CHAR (int)(sizeof(graphCharTable)/sizeof(MO_unichar))
 
 
 #define	CH	NOCELT
@@ -539,7 +543,11 @@ chr *endp;			/* points just past end of name */
 
 	/* search table */
         /* !!!:mferris:20010210 Use NoCopy string creation! */
+#if CHRBITS == 8
+        cfstr = CFStringCreateWithBytes(NULL, (const UInt8 *)startp, (CFIndex)len, kCFStringEncodingISOLatin1, FALSE);
+#else
         cfstr = CFStringCreateWithCharacters(NULL, (const UniChar *)startp, (CFIndex)len);
+#endif
         utf8DataLen = CFStringGetMaximumSizeForEncoding((CFIndex)len, kCFStringEncodingUTF8);
         /* !!!:mferris:20010210 Avoid malloc for small strings? */
         utf8Data = malloc(utf8DataLen+1);
@@ -602,13 +610,13 @@ int cases;			/* case-independent? */
 		lc = MO_UniCharToLower((chr)c);
 		uc = MO_UniCharToUpper((chr)c);
 		tc = MO_UniCharToTitle((chr)c);
-		if (c != lc) {
+		if (c != lc && lc <= CHR_MAX) {
 			addchr(cv, lc);
 		}
-		if (c != uc) {
+		if (c != uc && uc <= CHR_MAX) {
 			addchr(cv, uc);
 		}
-		if (c != tc && tc != uc) {
+		if (c != tc && tc != uc && tc <= CHR_MAX) {
 			addchr(cv, tc);
 		}
 	}
@@ -704,7 +712,11 @@ int cases;			/* case-independent? */
 
     len = endp - startp;
     /* !!!:mferris:20010210 Use NoCopy string creation! */
+#if CHRBITS == 8
+    cfstr = CFStringCreateWithBytes(NULL, (const UInt8 *)startp, (CFIndex)len, kCFStringEncodingISOLatin1, FALSE);
+#else
     cfstr = CFStringCreateWithCharacters(NULL, (const UniChar *)startp, (CFIndex)len);
+#endif
     utf8DataLen = CFStringGetMaximumSizeForEncoding((CFIndex)len, kCFStringEncodingUTF8);
     /* !!!:mferris:20010210 Avoid malloc for small strings? */
     utf8Data = malloc(utf8DataLen+1);
@@ -749,14 +761,14 @@ int cases;			/* case-independent? */
 		    NUM_DIGIT_RANGE + NUM_ALPHA_RANGE, 0);
 	    if (cv) {
 		for (i = 0; i < NUM_ALPHA_CHAR; i++) {
-		    addchr(cv, alphaCharTable[i]);
+		    tabchr(cv, alphaCharTable[i]);
 		}
 		for (i = 0; i < NUM_ALPHA_RANGE; i++) {
-		    addrange(cv, alphaRangeTable[i].start,
+		    tabrange(cv, alphaRangeTable[i].start,
 			     alphaRangeTable[i].end);
 		}
 		for (i = 0; i < NUM_DIGIT_RANGE; i++) {
-		    addrange(cv, digitRangeTable[i].start,
+		    tabrange(cv, digitRangeTable[i].start,
 			    digitRangeTable[i].end);
 		}
 	    }
@@ -765,11 +777,11 @@ int cases;			/* case-independent? */
 	    cv = getcvec(v, NUM_ALPHA_CHAR, NUM_ALPHA_RANGE, 0);
 	    if (cv) {
 		for (i = 0; i < NUM_ALPHA_RANGE; i++) {
-		    addrange(cv, alphaRangeTable[i].start,
+		    tabrange(cv, alphaRangeTable[i].start,
 			     alphaRangeTable[i].end);
 		}
 		for (i = 0; i < NUM_ALPHA_CHAR; i++) {
-		    addchr(cv, alphaCharTable[i]);
+		    tabchr(cv, alphaCharTable[i]);
 		}
 	    }
 	    break;
@@ -793,7 +805,7 @@ int cases;			/* case-independent? */
 	    cv = getcvec(v, 0, NUM_DIGIT_RANGE, 0);
 	    if (cv) {	
 		for (i = 0; i < NUM_DIGIT_RANGE; i++) {
-		    addrange(cv, digitRangeTable[i].start,
+		    tabrange(cv, digitRangeTable[i].start,
 			    digitRangeTable[i].end);
 		}
 	    }
@@ -802,11 +814,11 @@ int cases;			/* case-independent? */
 	    cv = getcvec(v, NUM_PUNCT_CHAR, NUM_PUNCT_RANGE, 0);
 	    if (cv) {
 		for (i = 0; i < NUM_PUNCT_RANGE; i++) {
-		    addrange(cv, punctRangeTable[i].start,
+		    tabrange(cv, punctRangeTable[i].start,
 			     punctRangeTable[i].end);
 		}
 		for (i = 0; i < NUM_PUNCT_CHAR; i++) {
-		    addchr(cv, punctCharTable[i]);
+		    tabchr(cv, punctCharTable[i]);
 		}
 	    }
 	    break;
@@ -822,11 +834,11 @@ int cases;			/* case-independent? */
 	    cv = getcvec(v, NUM_SPACE_CHAR, NUM_SPACE_RANGE, 0);
 	    if (cv) {
 		for (i = 0; i < NUM_SPACE_RANGE; i++) {
-		    addrange(cv, spaceRangeTable[i].start,
+		    tabrange(cv, spaceRangeTable[i].start,
 			     spaceRangeTable[i].end);
 		}
 		for (i = 0; i < NUM_SPACE_CHAR; i++) {
-		    addchr(cv, spaceCharTable[i]);
+		    tabchr(cv, spaceCharTable[i]);
 		}
 	    }
 	    break;
@@ -834,11 +846,11 @@ int cases;			/* case-independent? */
 	    cv  = getcvec(v, NUM_LOWER_CHAR, NUM_LOWER_RANGE, 0);
 	    if (cv) {
 		for (i = 0; i < NUM_LOWER_RANGE; i++) {
-		    addrange(cv, lowerRangeTable[i].start,
+		    tabrange(cv, lowerRangeTable[i].start,
 			     lowerRangeTable[i].end);
 		}
 		for (i = 0; i < NUM_LOWER_CHAR; i++) {
-		    addchr(cv, lowerCharTable[i]);
+		    tabchr(cv, lowerCharTable[i]);
 		}
 	    }
 	    break;
@@ -846,11 +858,11 @@ int cases;			/* case-independent? */
 	    cv  = getcvec(v, NUM_UPPER_CHAR, NUM_UPPER_RANGE, 0);
 	    if (cv) {
 		for (i = 0; i < NUM_UPPER_RANGE; i++) {
-		    addrange(cv, upperRangeTable[i].start,
+		    tabrange(cv, upperRangeTable[i].start,
 			     upperRangeTable[i].end);
 		}
 		for (i = 0; i < NUM_UPPER_CHAR; i++) {
-		    addchr(cv, upperCharTable[i]);
+		    tabchr(cv, upperCharTable[i]);
 		}
 	    }
 	    break;
@@ -858,11 +870,11 @@ int cases;			/* case-independent? */
 	    cv  = getcvec(v, NUM_GRAPH_CHAR, NUM_GRAPH_RANGE, 0);
 	    if (cv) {
 		for (i = 0; i < NUM_GRAPH_RANGE; i++) {
-		    addrange(cv, graphRangeTable[i].start,
+		    tabrange(cv, graphRangeTable[i].start,
 			     graphRangeTable[i].end);
 		}
 		for (i = 0; i < NUM_GRAPH_CHAR; i++) {
-		    addchr(cv, graphCharTable[i]);
+		    tabchr(cv, graphCharTable[i]);
 		}
 	    }
 	    break;
@@ -886,11 +898,18 @@ pchr pc;
 {
 	struct cvec *cv;
 	chr c = (chr)pc;
-	chr lc, uc, tc;
+	celt lc, uc, tc;
 
 	lc = MO_UniCharToLower((chr)c);
 	uc = MO_UniCharToUpper((chr)c);
 	tc = MO_UniCharToTitle((chr)c);
+	/* in the 8-bit build, a counterpart might not be a chr at all */
+	if (lc > CHR_MAX)
+		lc = c;
+	if (uc > CHR_MAX)
+		uc = c;
+	if (tc > CHR_MAX)
+		tc = uc;
 
 	if (tc != uc) {
 	    cv = getcvec(v, 3, 0, 0);
@@ -905,6 +924,34 @@ pchr pc;
 	return cv;
 }
 
+/*
+ - tabchr - add a chr from a class table to a cvec, if it is a chr here
+ ^ static VOID tabchr(struct cvec *, pchr);
+ */
+static VOID
+tabchr(cv, c)
+struct cvec *cv;
+pchr c;				/* Unicode */
+{
+	if (c <= CHR_MAX)
+		addchr(cv, c);
+}
+
+/*
+ - tabrange - add a range from a class table to a cvec, as far as it goes
+ ^ static VOID tabrange(struct cvec *, pchr, pchr);
+ */
+static VOID
+tabrange(cv, from, to)
+struct cvec *cv;
+pchr from;			/* Unicode */
+pchr to;
+{
+	if (from > CHR_MAX)
+		return;
+	addrange(cv, from, (to > CHR_MAX) ? CHR_MAX : to);
+}
+
 /*
  - cmp - chr-substring compare
  * Backrefs need this.  It should preferably be efficient.
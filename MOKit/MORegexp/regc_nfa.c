@@ -1027,6 +1027,13 @@ struct arc *a;
 
 /*
  - fixempties - get rid of EMPTY arcs
+ * Taking them out one at a time, copying arcs around each, can go on
+ * forever:  with loops of EMPTYs about, taking one out can put back one
+ * taken out before.  Instead, each state gets copies of the non-EMPTY
+ * inarcs of all the states that reach it by EMPTYs, and then the EMPTYs
+ * can simply go.  States that are only aliases for a neighbor, with an
+ * EMPTY as their only outarc or only inarc, are folded in first, to keep
+ * the NFA small.
  ^ static VOID fixempties(struct nfa *, FILE *);
  */
 static VOID
@@ -1035,79 +1042,89 @@ struct nfa *nfa;
 FILE *f;			/* for debug output; NULL none */
 {
 	struct state *s;
+	struct state *s2;
 	struct state *nexts;
 	struct arc *a;
 	struct arc *nexta;
-	int progress;
 
-	/* find and eliminate empties until there are no more */
-	do {
-		progress = 0;
-		for (s = nfa->states; s != NULL && !NISERR(); s = nexts) {
-			nexts = s->next;
-			for (a = s->outs; a != NULL && !NISERR(); a = nexta) {
-				nexta = a->outchain;
-				if (a->type == EMPTY && unempty(nfa, a))
-					progress = 1;
-				assert(nexta == NULL || s->no != FREESTATE);
-			}
+	/* a state whose only outarc is an EMPTY is an alias for its successor */
+	for (s = nfa->states; s != NULL && !NISERR(); s = nexts) {
+		nexts = s->next;
+		if (s->flag || s->nouts != 1 || s->outs->type != EMPTY)
+			continue;	/* NOTE CONTINUE */
+		if (s->outs->to != s)
+			moveins(nfa, s, s->outs->to);
+		dropstate(nfa, s);
+	}
+
+	/* likewise one whose only inarc is an EMPTY, for its predecessor */
+	for (s = nfa->states; s != NULL && !NISERR(); s = nexts) {
+		nexts = s->next;
+		if (s->flag || s->nins != 1 || s->ins->type != EMPTY)
+			continue;	/* NOTE CONTINUE */
+		if (s->ins->from != s)
+			moveouts(nfa, s, s->ins->from);
+		dropstate(nfa, s);
+	}
+
+	/* the rest get the inarcs of the states reaching them by EMPTYs */
+	for (s = nfa->states; s != NULL && !NISERR(); s = s->next) {
+		emptyreach(nfa, s);
+		for (s2 = s->tmp; s2 != s; s2 = nexts) {
+			for (a = s2->ins; a != NULL && !NISERR(); a = a->inchain)
+				if (a->type != EMPTY)
+					cparc(nfa, a, a->from, s);
+			nexts = s2->tmp;
+			s2->tmp = NULL;
 		}
-		if (progress && f != NULL)
-			dumpnfa(nfa, f);
-	} while (progress && !NISERR());
+		s->tmp = NULL;
+	}
+
+	/* now the EMPTYs are no longer needed, nor states left useless */
+	for (s = nfa->states; s != NULL; s = s->next)
+		for (a = s->outs; a != NULL; a = nexta) {
+			nexta = a->outchain;
+			if (a->type == EMPTY)
+				freearc(nfa, a);
+		}
+	for (s = nfa->states; s != NULL; s = nexts) {
+		nexts = s->next;
+		if (!s->flag && (s->nins == 0 || s->nouts == 0))
+			dropstate(nfa, s);
+	}
+
+	if (f != NULL)
+		dumpnfa(nfa, f);
 }
 
 /*
- - unempty - optimize out an EMPTY arc, if possible
- * Actually, as it stands this function always succeeds, but the return
- * value is kept with an eye on possible future changes.
- ^ static int unempty(struct nfa *, struct arc *);
+ - emptyreach - list the states that reach one by EMPTY arcs
+ * The list runs through the tmp fields, from s around and back to s;
+ * the caller unmarks them all, s last.  It's built breadth-first, with
+ * the list itself as the queue, so a big NFA can't run the stack out.
+ ^ static VOID emptyreach(struct nfa *, struct state *);
  */
-static int			/* 0 couldn't, 1 could */
-unempty(nfa, a)
+static VOID
+emptyreach(nfa, s)
 struct nfa *nfa;
-struct arc *a;
+struct state *s;
 {
-	struct state *from = a->from;
-	struct state *to = a->to;
-	int usefrom;		/* work on from, as opposed to to? */
-
-	assert(a->type == EMPTY);
-	assert(from != nfa->pre && to != nfa->post);
-
-	if (from == to) {		/* vacuous loop */
-		freearc(nfa, a);
-		return 1;
-	}
-
-	/* decide which end to work on */
-	usefrom = 1;			/* default:  attack from */
-	if (from->nouts > to->nins)
-		usefrom = 0;
-	else if (from->nouts == to->nins) {
-		/* decide on secondary issue:  move/copy fewest arcs */
-		if (from->nins > to->nouts)
-			usefrom = 0;
-	}
-		
-	freearc(nfa, a);
-	if (usefrom) {
-		if (from->nouts == 0) {
-			/* was the state's only outarc */
-			moveins(nfa, from, to);
-			freestate(nfa, from);
-		} else
-			copyins(nfa, from, to);
-	} else {
-		if (to->nins == 0) {
-			/* was the state's only inarc */
-			moveouts(nfa, to, from);
-			freestate(nfa, to);
-		} else
-			copyouts(nfa, to, from);
-	}
+	struct state *scan;		/* next state to look into */
+	struct state *last;		/* end of the list so far */
+	struct arc *a;
 
-	return 1;
+	s->tmp = s;
+	last = s;
+	scan = s;
+	do {
+		for (a = scan->ins; a != NULL; a = a->inchain)
+			if (a->type == EMPTY && a->from->tmp == NULL) {
+				a->from->tmp = s;
+				last->tmp = a->from;
+				last = a->from;
+			}
+		scan = scan->tmp;
+	} while (scan != s);
 }
 
 /*
@@ -1252,6 +1269,8 @@ struct cnfa *cnfa;
 	cnfa->eos[1] = nfa->eos[1];
 	cnfa->ncolors = maxcolor(nfa->cm) + 1;
 	cnfa->flags = 0;
+	cnfa->dtab = NULL;
+	cnfa->bits = NULL;
 
 	ca = cnfa->arcs;
 	for (s = nfa->states; s != NULL; s = s->next) {
@@ -1290,6 +1309,226 @@ struct cnfa *cnfa;
 	for (a = nfa->pre->outs; a != NULL; a = a->outchain)
 		cnfa->states[a->to->no]->co = 1;
 	cnfa->states[nfa->pre->no]->co = 1;
+
+	markfates(nfa, cnfa);
+}
+
+/*
+ - markfates - mark the states whose outcome is already settled
+ * A state from which post can't be reached, given that bos comes only
+ * first and eos only last, is dead.  A state that reaches post on every
+ * next chr and on eos, and on every chr also goes to another such state,
+ * will have a match ending at every point from here on, whatever the
+ * string holds; exec's longest() needn't read any further.  The marks go
+ * in the "to" of each state's flags "arc".
+ ^ static VOID markfates(struct nfa *, struct cnfa *);
+ */
+static VOID
+markfates(nfa, cnfa)
+struct nfa *nfa;
+struct cnfa *cnfa;
+{
+	struct colormap *cm = nfa->cm;
+	struct state *s;
+	struct state *t;
+	struct arc *a;
+	struct state **stack;
+	char *live;
+	char *always;
+	char *topost;		/* [color] s goes to post on it */
+	char *toalways;		/* [color] s goes to an always state on it */
+	int nco = cnfa->ncolors;
+	int sp;
+	int co;
+	int changed;
+
+	stack = (struct state **)MALLOC(cnfa->nstates * sizeof(struct state *));
+	live = (char *)MALLOC(2*cnfa->nstates + 2*nco);
+	if (stack == NULL || live == NULL) {
+		if (stack != NULL)
+			FREE(stack);
+		if (live != NULL)
+			FREE(live);
+		NERR(REG_ESPACE);
+		return;
+	}
+	always = &live[cnfa->nstates];
+	topost = &always[cnfa->nstates];
+	toalways = &topost[nco];
+
+	/* live states, back from post along arcs that can be taken */
+	for (s = nfa->states; s != NULL; s = s->next)
+		live[s->no] = 0;
+	live[nfa->post->no] = 1;
+	stack[0] = nfa->post;
+	sp = 1;
+	while (sp > 0) {
+		t = stack[--sp];
+		for (a = t->ins; a != NULL; a = a->inchain) {
+			if (live[a->from->no])
+				continue;	/* NOTE CONTINUE */
+			if (a->type == PLAIN && a->from != nfa->pre &&
+				(a->co == nfa->bos[0] || a->co == nfa->bos[1]))
+				continue;	/* NOTE CONTINUE */
+			if (a->type == PLAIN && t != nfa->post &&
+				(a->co == nfa->eos[0] || a->co == nfa->eos[1]))
+				continue;	/* NOTE CONTINUE */
+			live[a->from->no] = 1;
+			stack[sp++] = a->from;
+		}
+	}
+
+	/* always states, by whittling down the likely ones */
+	for (s = nfa->states; s != NULL; s = s->next) {
+		always[s->no] = 0;
+		if (s == nfa->pre || s == nfa->post)
+			continue;	/* NOTE CONTINUE */
+		for (co = 0; co < nco; co++)
+			topost[co] = 0;
+		for (a = s->outs; a != NULL; a = a->outchain)
+			if (a->type == PLAIN && a->to == nfa->post)
+				topost[a->co] = 1;
+		for (co = 0; co < nco; co++)
+			if (!topost[co] && (co == nfa->eos[0] ||
+					co == nfa->eos[1] || REALCOLOR(cm, co)))
+				break;		/* NOTE BREAK OUT */
+		always[s->no] = (co == nco);
+	}
+	do {
+		changed = 0;
+		for (s = nfa->states; s != NULL; s = s->next) {
+			if (!always[s->no])
+				continue;	/* NOTE CONTINUE */
+			for (co = 0; co < nco; co++)
+				toalways[co] = 0;
+			for (a = s->outs; a != NULL; a = a->outchain)
+				if (a->type == PLAIN && always[a->to->no])
+					toalways[a->co] = 1;
+			for (co = 0; co < nco; co++)
+				if (!toalways[co] && REALCOLOR(cm, co))
+					break;	/* NOTE BREAK OUT */
+			if (co < nco) {
+				always[s->no] = 0;
+				changed = 1;
+			}
+		}
+	} while (changed);
+
+	for (s = nfa->states; s != NULL; s = s->next) {
+		cnfa->states[s->no]->to = 0;
+		if (!live[s->no]) {
+			cnfa->states[s->no]->to |= CDEAD;
+			cnfa->flags |= HASDEAD;
+		}
+		if (always[s->no]) {
+			cnfa->states[s->no]->to |= CALWAYS;
+			cnfa->flags |= HASALWAYS;
+		}
+	}
+	FREE(stack);
+	FREE(live);
+}
+
+/*
+ - rcompact - compact an NFA with all its arcs reversed, as a search NFA
+ * The result runs from post back to pre, and its pre (the old post) loops
+ * on every color, so that walked backward from some point it finds where
+ * any match ending at or before that point could have begun.  The context
+ * colors stay as they were:  bos still marks the beginning of the string,
+ * now reached last.  Lookahead constraints don't reverse, so an NFA with
+ * any is left alone and cnfa stays empty.
+ ^ static VOID rcompact(struct nfa *, struct cnfa *);
+ */
+static VOID
+rcompact(nfa, cnfa)
+struct nfa *nfa;
+struct cnfa *cnfa;
+{
+	struct state *s;
+	struct arc *a;
+	size_t nstates;
+	size_t narcs;
+	struct carc *ca;
+	struct carc *first;
+	struct carc *p;
+	struct carc *q;
+	int ncolors = maxcolor(nfa->cm) + 1;
+	color co;
+
+	assert (!NISERR());
+
+	nstates = 0;
+	narcs = ncolors;		/* the loop */
+	for (s = nfa->states; s != NULL; s = s->next) {
+		nstates++;
+		narcs += 1 + s->nins + 1;
+		for (a = s->outs; a != NULL; a = a->outchain)
+			if (a->type != PLAIN)
+				return;
+	}
+
+	cnfa->states = (struct carc **)MALLOC(nstates * sizeof(struct carc *));
+	cnfa->arcs = (struct carc *)MALLOC(narcs * sizeof(struct carc));
+	if (cnfa->states == NULL || cnfa->arcs == NULL) {
+		if (cnfa->states != NULL)
+			FREE(cnfa->states);
+		if (cnfa->arcs != NULL)
+			FREE(cnfa->arcs);
+		NERR(REG_ESPACE);
+		return;
+	}
+	cnfa->nstates = nstates;
+	cnfa->pre = nfa->post->no;
+	cnfa->post = nfa->pre->no;
+	cnfa->bos[0] = nfa->bos[0];
+	cnfa->bos[1] = nfa->bos[1];
+	cnfa->eos[0] = nfa->eos[0];
+	cnfa->eos[1] = nfa->eos[1];
+	cnfa->ncolors = ncolors;
+	cnfa->flags = 0;
+	cnfa->dtab = NULL;
+	cnfa->bits = NULL;
+
+	ca = cnfa->arcs;
+	for (s = nfa->states; s != NULL; s = s->next) {
+		assert((size_t)s->no < nstates);
+		cnfa->states[s->no] = ca;
+		ca->co = 0;		/* clear and skip flags "arc" */
+		ca->to = 0;
+		ca++;
+		first = ca;
+		for (a = s->ins; a != NULL; a = a->inchain) {
+			assert(a->type == PLAIN);
+			ca->co = a->co;
+			ca->to = a->from->no;
+			ca++;
+		}
+		carcsort(first, ca-1);
+		if (s == nfa->post) {
+			/* merge in the loop, keeping the colors in order */
+			p = ca - 1;
+			ca += ncolors;
+			q = ca - 1;
+			for (co = ncolors - 1; co >= 0; co--) {
+				while (p >= first && p->co > co)
+					*q-- = *p--;
+				q->co = co;
+				q->to = s->no;
+				q--;
+			}
+			assert(q == p);
+		}
+		ca->co = COLORLESS;
+		ca->to = 0;
+		ca++;
+	}
+	assert(ca == &cnfa->arcs[narcs]);
+	assert(cnfa->nstates != 0);
+
+	/* mark no-progress states */
+	for (a = nfa->post->ins; a != NULL; a = a->inchain)
+		cnfa->states[a->from->no]->co = 1;
+	cnfa->states[nfa->post->no]->co = 1;
 }
 
 /*
@@ -1333,6 +1572,14 @@ struct cnfa *cnfa;
 	cnfa->nstates = 0;
 	FREE(cnfa->states);
 	FREE(cnfa->arcs);
+	if (cnfa->dtab != NULL) {
+		FREE(cnfa->dtab->trans);
+		FREE(cnfa->dtab);
+	}
+	if (cnfa->bits != NULL) {
+		FREE(cnfa->bits->follow);
+		FREE(cnfa->bits);
+	}
 }
 
 /*
@@ -1552,7 +1799,8 @@ FILE *f;
 	int i;
 	int pos;
 
-	fprintf(f, "%d%s", st, (ca[0].co) ? ":" : ".");
+	fprintf(f, "%d%s%s", st, (ca[0].co) ? ":" : ".",
+		(ca[0].to&CDEAD) ? "x" : ((ca[0].to&CALWAYS) ? "*" : ""));
 	pos = 1;
 	for (i = 1; ca[i].co != COLORLESS; i++) {
 		if (ca[i].co < cnfa->ncolors)
@@ -0,0 +1,344 @@
+/* ---:mferris: This file contains NO external definitions. */
+
+/*
+ * One-pass programs, for REs that never leave a choice open.
+ * This file is #included by regcomp.c.
+ *
+ * In the usual capturing RE, at each point the next chr (or the end of
+ * the string) picks out just one path through the NFA.  For those there
+ * is no need to dissect a match; one walk along it, from where it starts,
+ * finds where every subexpression begins and ends.  If the RE is also
+ * anchored at the start of the string, the same walk finds the match,
+ * and there's no need to search either.  We work on the NFA as parse()
+ * left it, before optimize() merges away the states where captures begin
+ * and end, and record for each place the walk can be where each color
+ * takes it, and which boundaries it passes on the way.  If anything could
+ * go two ways, there's no program and exec does things the usual way.
+ *
+ * Capturing parens that sit in a loop are always rewritten by parse()
+ * so that only the last time around is tagged, so no path goes through
+ * a tagged state twice.  The one path that enters a subexpression's end
+ * state without going through its start is the bypass of a {0,...}
+ * quantifier, which is how exec tells a skipped subexpression.
+ */
+
+#define	OMAXSTATES	256	/* most program states we'll build */
+#define	OMAXCELLS	(1<<16)	/* limit on states*colors */
+#define	OCMID	01		/* oneclose() conditions:  short of the end, */
+#define	OCEND(e)	(02 << (e))	/* or at the end with eos color index e */
+#define	OCALL	07
+
+
+
+/*
+ - onepass - build the one-pass program for an RE, if it has one
+ * Must be called before optimize(), while the tree's states still mark
+ * the capture boundaries.  Program states 0 and 1 are the start of the
+ * string, with bos color index 0 or 1, and 2 is a start further on; the
+ * rest are where arcs out of those lead.  Running into our limits on size
+ * isn't an error, just a reason not to bother.
+ ^ static VOID onepass(struct vars *, struct nfa *, struct guts *);
+ */
+static VOID
+onepass(v, nfa, g)
+struct vars *v;
+struct nfa *nfa;
+struct guts *g;
+{
+	struct state *s;
+	struct arc *a;
+	int nco;
+	int n;			/* program states so far */
+	int max;		/* program states there's room for */
+	int nreach;
+	int ok;
+	int i;
+	int j;
+	int e;
+	int to;
+	unsigned tags;
+	char *work;		/* one allocation for the per-state arrays */
+	struct state **reach;	/* oneclose() workspace */
+	unsigned *ctags;
+	char *cconds;
+	unsigned *stag;		/* tags noted on entering, by NFA state */
+	int *index;		/* program state, by NFA state */
+	struct state **todo;	/* NFA state, by program state */
+	struct oarc *arcs;
+	struct oarc *ends;
+	struct oarc *oa;
+	struct onepass *op;
+
+	g->one = NULL;
+	if (v->nsubexp == 0 || v->nsubexp > OMAXSUB || v->nlacons > 0 ||
+			(v->cflags&REG_NOSUB) || (v->re->re_info&REG_UBACKREF))
+		return;
+	for (s = nfa->states; s != NULL; s = s->next)
+		for (a = s->outs; a != NULL; a = a->outchain)
+			if (a->type != PLAIN && a->type != EMPTY &&
+					a->type != '^' && a->type != '$')
+				return;		/* lookahead or -behind */
+	nco = maxcolor(nfa->cm) + 1;
+	if (nco > OMAXCELLS / 4)
+		return;
+
+	n = nfa->nstates;
+	work = (char *)MALLOC((4*n + 2) * sizeof(struct state *) +
+				n * (2*sizeof(unsigned) + sizeof(int) + 1));
+	max = 8;
+	arcs = (struct oarc *)MALLOC(max * nco * sizeof(struct oarc));
+	ends = (struct oarc *)MALLOC(max * 3 * sizeof(struct oarc));
+	if (work == NULL || arcs == NULL || ends == NULL) {
+		if (work != NULL)
+			FREE(work);
+		if (arcs != NULL)
+			FREE(arcs);
+		if (ends != NULL)
+			FREE(ends);
+		ERR(REG_ESPACE);
+		return;
+	}
+	reach = (struct state **)work;		/* 3 per state, see oneclose() */
+	todo = reach + 3*n;
+	stag = (unsigned *)(todo + n + 2);
+	ctags = stag + n;
+	index = (int *)(ctags + n);
+	cconds = (char *)(index + n);
+	for (i = 0; i < n; i++) {
+		stag[i] = 0;
+		index[i] = ONONE;
+		cconds[i] = 0;
+	}
+	onetags(v->tree, stag);
+
+	/* the starts, then wherever the arcs lead */
+	todo[0] = todo[1] = nfa->pre;
+	todo[2] = nfa->init;		/* pre's other arcs were the chr before */
+	for (i = 0; i < 3*nco; i++)
+		arcs[i].to = ONONE;
+	for (i = 0; i < 3*3; i++)
+		ends[i].to = ONONE;
+	n = 3;
+	ok = 1;
+	for (i = 0; i < n && ok; i++) {
+		nreach = oneclose(nfa, todo[i], (i < 2) ? i : -1, stag, reach,
+								ctags, cconds);
+		if (nreach < 0) {
+			ok = 0;
+			break;		/* NOTE BREAK OUT */
+		}
+		for (j = 0; j < nreach && ok; j++) {
+			s = reach[j];
+			tags = ctags[s->no];
+			if (s == nfa->final) {
+				oa = &ends[i*3];
+				if (cconds[s->no]&OCMID) {
+					oa[OMID].to = 0;
+					oa[OMID].tags = tags;
+				}
+				for (e = 0; e < 2; e++)
+					if (cconds[s->no]&OCEND(e)) {
+						oa[OEND(e)].to = 0;
+						oa[OEND(e)].tags = tags;
+					}
+				continue;	/* NOTE CONTINUE */
+			}
+			if (!(cconds[s->no]&OCMID) || s == nfa->pre)
+				continue;	/* NOTE CONTINUE */
+			for (a = s->outs; a != NULL && ok; a = a->outchain) {
+				if (a->type != PLAIN)
+					continue;	/* NOTE CONTINUE */
+				assert(a->co < nco);
+				to = index[a->to->no];
+				if (to == ONONE) {
+					if (n == OMAXSTATES || n >= OMAXCELLS/nco) {
+						ok = 0;
+						break;	/* NOTE BREAK OUT */
+					}
+					if (n == max && !onegrow(&arcs, &ends,
+								&max, nco)) {
+						ERR(REG_ESPACE);
+						ok = 0;
+						break;	/* NOTE BREAK OUT */
+					}
+					to = n++;
+					index[a->to->no] = to;
+					todo[to] = a->to;
+					for (e = 0; e < nco; e++)
+						arcs[to*nco + e].to = ONONE;
+					for (e = 0; e < 3; e++)
+						ends[to*3 + e].to = ONONE;
+				}
+				oa = &arcs[i*nco + a->co];
+				if (oa->to == ONONE) {
+					oa->to = to;
+					oa->tags = tags;
+				} else if (oa->to != to || oa->tags != tags)
+					ok = 0;		/* two ways to go */
+			}
+		}
+		for (j = 0; j < nreach; j++)
+			cconds[reach[j]->no] = 0;
+	}
+	FREE(work);
+
+	op = NULL;
+	if (ok)
+		op = (struct onepass *)MALLOC(sizeof(struct onepass));
+	if (op == NULL) {
+		if (ok)
+			ERR(REG_ESPACE);
+		FREE(arcs);
+		FREE(ends);
+		return;
+	}
+	op->nstates = n;
+	op->ncolors = nco;
+	op->arcs = arcs;
+	op->ends = ends;
+	op->start[0] = 0;
+	op->start[1] = 1;
+	op->start[OSTARTMID] = 2;
+	/* can a match start after the start of the string? */
+	op->anchored = 1;
+	for (i = 0; i < nco; i++)
+		if (arcs[OSTARTMID*nco + i].to != ONONE)
+			op->anchored = 0;
+	for (i = 0; i < 3; i++)
+		if (ends[OSTARTMID*3 + i].to != ONONE)
+			op->anchored = 0;
+	g->one = op;
+}
+
+/*
+ - onetags - note which states mark capture boundaries
+ ^ static VOID onetags(struct subre *, unsigned *);
+ */
+static VOID
+onetags(t, stag)
+struct subre *t;
+unsigned *stag;
+{
+	if (t->op == '(') {
+		assert(t->subno > 0 && t->subno <= OMAXSUB);
+		stag[t->begin->no] |= OTAG(t->subno, 0);
+		stag[t->end->no] |= OTAG(t->subno, 1);
+	}
+	if (t->left != NULL)
+		onetags(t->left, stag);
+	if (t->right != NULL)
+		onetags(t->right, stag);
+}
+
+/*
+ - oneclose - find what's reachable from a state without consuming a chr
+ * Each state reached gets, in ctags, the capture boundaries passed on
+ * the way (including its own) and, in cconds, where in the string the
+ * route is good:  short of the end, and/or at the end with one eos color
+ * or the other.  A state that two routes with different boundaries
+ * reach is one exec couldn't be sure of, and the whole thing fails.
+ * Routes differing only in where they're good merge, so a state may be
+ * reached, and listed, up to three times.  cconds is 0 for states not
+ * reached, and the caller clears it for the reach list afterward.
+ ^ static int oneclose(struct nfa *, struct state *, int, unsigned *,
+ ^ 	struct state **, unsigned *, char *);
+ */
+static int			/* number listed in reach, or -1 */
+oneclose(nfa, from, bos, stag, reach, ctags, cconds)
+struct nfa *nfa;
+struct state *from;
+int bos;			/* bos color index for '^', -1 if not at start */
+unsigned *stag;
+struct state **reach;
+unsigned *ctags;
+char *cconds;
+{
+	struct state *s;
+	struct state *to;
+	struct arc *a;
+	unsigned tags;
+	int conds;
+	int n;
+	int i;
+
+	n = 0;
+	reach[n++] = from;
+	ctags[from->no] = stag[from->no];
+	cconds[from->no] = OCALL;
+	for (i = 0; i < n; i++) {
+		s = reach[i];
+		if (s == nfa->final)
+			continue;	/* beyond here is the caller's business */
+		for (a = s->outs; a != NULL; a = a->outchain) {
+			conds = cconds[s->no];
+			switch (a->type) {
+			case EMPTY:
+				break;
+			case '^':
+				if (a->co != bos)
+					continue;	/* NOTE CONTINUE */
+				break;
+			case '$':
+				conds &= OCEND(a->co);
+				if (conds == 0)
+					continue;	/* NOTE CONTINUE */
+				break;
+			default:	/* PLAIN, for the caller */
+				continue;	/* NOTE CONTINUE */
+				break;
+			}
+			to = a->to;
+			tags = ctags[s->no] | stag[to->no];
+			if (cconds[to->no] == 0)
+				ctags[to->no] = tags;
+			else if (ctags[to->no] != tags) {
+				for (i = 0; i < n; i++)
+					cconds[reach[i]->no] = 0;
+				return -1;
+			} else if ((cconds[to->no]|conds) == cconds[to->no])
+				continue;	/* nothing new */
+			cconds[to->no] |= conds;
+			reach[n++] = to;
+		}
+	}
+	return n;
+}
+
+/*
+ - onegrow - double the room for program states
+ ^ static int onegrow(struct oarc **, struct oarc **, int *, int);
+ */
+static int			/* success */
+onegrow(arcsp, endsp, maxp, nco)
+struct oarc **arcsp;
+struct oarc **endsp;
+int *maxp;
+int nco;
+{
+	struct oarc *p;
+	int max = *maxp * 2;
+
+	p = (struct oarc *)REALLOC(*arcsp, max * nco * sizeof(struct oarc));
+	if (p == NULL)
+		return 0;
+	*arcsp = p;
+	p = (struct oarc *)REALLOC(*endsp, max * 3 * sizeof(struct oarc));
+	if (p == NULL)
+		return 0;
+	*endsp = p;
+	*maxp = max;
+	return 1;
+}
+
+/*
+ - freeone - free a one-pass program
+ ^ static VOID freeone(struct onepass *);
+ */
+static VOID
+freeone(op)
+struct onepass *op;
+{
+	FREE(op->arcs);
+	FREE(op->ends);
+	FREE(op);
+}
@@ -1,6 +1,7 @@
 /* ---:mferris: This file contains ONLY the following external definitions:
  *
  * function compile() which is #defined to MO_ReComp()
+ * function regsetcomp() which is #defined to MO_ReSetComp()
  */
 
 /*
@@ -46,6 +47,8 @@
 /* automatically gathered by fwd; do not hand-edit */
 /* === regcomp.c === */
 int compile _ANSI_ARGS_((regex_t *, CONST chr *, size_t, int));
+int regsetcomp _ANSI_ARGS_((regex_t *, int, CONST chr *CONST [], CONST size_t [], CONST int []));
+static int prepare _ANSI_ARGS_((struct vars *, regex_t *, int));
 static VOID moresubs _ANSI_ARGS_((struct vars *, int));
 static int freev _ANSI_ARGS_((struct vars *, int));
 static VOID makesearch _ANSI_ARGS_((struct vars *, struct nfa *));
@@ -71,6 +74,7 @@ static VOID freesrnode _ANSI_ARGS_((struct vars *, struct subre *));
 static VOID optst _ANSI_ARGS_((struct vars *, struct subre *));
 static int numst _ANSI_ARGS_((struct subre *, int));
 static VOID markst _ANSI_ARGS_((struct subre *));
+static VOID refst _ANSI_ARGS_((struct subre *));
 static VOID cleanst _ANSI_ARGS_((struct vars *));
 static long nfatree _ANSI_ARGS_((struct vars *, struct subre *, FILE *));
 static long nfanode _ANSI_ARGS_((struct vars *, struct subre *, FILE *));
@@ -108,13 +112,17 @@ static color pseudocolor _ANSI_ARGS_((struct colormap *));
 static color subcolor _ANSI_ARGS_((struct colormap *, pchr c));
 static color newsub _ANSI_ARGS_((struct colormap *, pcolor));
 static VOID subrange _ANSI_ARGS_((struct vars *, pchr, pchr, struct state *, struct state *));
+#if NBYTS > 1
 static VOID subblock _ANSI_ARGS_((struct vars *, pchr, struct state *, struct state *));
+#endif
 static VOID okcolors _ANSI_ARGS_((struct nfa *, struct colormap *));
 static VOID colorchain _ANSI_ARGS_((struct colormap *, struct arc *));
 static VOID uncolorchain _ANSI_ARGS_((struct colormap *, struct arc *));
 static int singleton _ANSI_ARGS_((struct colormap *, pchr c));
+static chr colorchr _ANSI_ARGS_((struct colormap *, pcolor));
 static VOID rainbow _ANSI_ARGS_((struct nfa *, struct colormap *, int, pcolor, struct state *, struct state *));
 static VOID colorcomplement _ANSI_ARGS_((struct nfa *, struct colormap *, int, struct state *, struct state *, struct state *));
+static VOID flattencm _ANSI_ARGS_((struct colormap *));
 #ifdef REG_DEBUG
 static VOID dumpcolors _ANSI_ARGS_((struct colormap *, FILE *));
 static VOID fillcheck _ANSI_ARGS_((struct colormap *, union tree *, int, FILE *));
@@ -154,12 +162,14 @@ static int push _ANSI_ARGS_((struct nfa *, struct arc *));
 #define	COMPATIBLE	3	/* compatible but not satisfied yet */
 static int combine _ANSI_ARGS_((struct arc *, struct arc *));
 static VOID fixempties _ANSI_ARGS_((struct nfa *, FILE *));
-static int unempty _ANSI_ARGS_((struct nfa *, struct arc *));
+static VOID emptyreach _ANSI_ARGS_((struct nfa *, struct state *));
 static VOID cleanup _ANSI_ARGS_((struct nfa *));
 static VOID markreachable _ANSI_ARGS_((struct nfa *, struct state *, struct state *, struct state *));
 static VOID markcanreach _ANSI_ARGS_((struct nfa *, struct state *, struct state *, struct state *));
 static long analyze _ANSI_ARGS_((struct nfa *));
 static VOID compact _ANSI_ARGS_((struct nfa *, struct cnfa *));
+static VOID markfates _ANSI_ARGS_((struct nfa *, struct cnfa *));
+static VOID rcompact _ANSI_ARGS_((struct nfa *, struct cnfa *));
 static VOID carcsort _ANSI_ARGS_((struct carc *, struct carc *));
 static VOID freecnfa _ANSI_ARGS_((struct cnfa *));
 static VOID dumpnfa _ANSI_ARGS_((struct nfa *, FILE *));
@@ -173,6 +183,28 @@ static VOID dumpcnfa _ANSI_ARGS_((struct cnfa *, FILE *));
 #ifdef REG_DEBUG
 static VOID dumpcstate _ANSI_ARGS_((int, struct carc *, struct cnfa *, FILE *));
 #endif
+/* === regc_dfa.c === */
+static VOID determinize _ANSI_ARGS_((struct vars *, struct cnfa *));
+static unsigned dsethash _ANSI_ARGS_((unsigned *, int));
+static VOID dminimize _ANSI_ARGS_((struct vars *, struct cnfa *, int, int *, char *));
+/* === regc_bit.c === */
+static VOID bitnfa _ANSI_ARGS_((struct vars *, struct cnfa *));
+/* === regc_lit.c === */
+static VOID findlit _ANSI_ARGS_((struct vars *, struct nfa *, struct guts *));
+static int litchain _ANSI_ARGS_((struct vars *, struct nfa *, struct state *, chr *));
+static int dominates _ANSI_ARGS_((struct nfa *, struct state *, char *, struct state **));
+static int chrrank _ANSI_ARGS_((pchr));
+static VOID findpfx _ANSI_ARGS_((struct vars *, struct nfa *, struct guts *));
+static int pfxwalk _ANSI_ARGS_((struct vars *, struct nfa *, struct state *, chr *, int, struct guts *, int *));
+static VOID findlens _ANSI_ARGS_((struct vars *, struct nfa *, struct guts *));
+static int maxpath _ANSI_ARGS_((struct vars *, struct nfa *, int *, struct state **, struct arc **));
+static int arclen _ANSI_ARGS_((struct vars *, struct nfa *, struct arc *));
+/* === regc_one.c === */
+static VOID onepass _ANSI_ARGS_((struct vars *, struct nfa *, struct guts *));
+static VOID onetags _ANSI_ARGS_((struct subre *, unsigned *));
+static int oneclose _ANSI_ARGS_((struct nfa *, struct state *, int, unsigned *, struct state **, unsigned *, char *));
+static int onegrow _ANSI_ARGS_((struct oarc **, struct oarc **, int *, int));
+static VOID freeone _ANSI_ARGS_((struct onepass *));
 /* === regc_cvec.c === */
 static struct cvec *newcvec _ANSI_ARGS_((int, int, int));
 static struct cvec *clearcvec _ANSI_ARGS_((struct cvec *));
@@ -192,6 +224,8 @@ static int before _ANSI_ARGS_((celt, celt));
 static struct cvec *eclass _ANSI_ARGS_((struct vars *, celt, int));
 static struct cvec *cclass _ANSI_ARGS_((struct vars *, chr *, chr *, int));
 static struct cvec *allcases _ANSI_ARGS_((struct vars *, pchr));
+static VOID tabchr _ANSI_ARGS_((struct cvec *, pchr));
+static VOID tabrange _ANSI_ARGS_((struct cvec *, pchr, pchr));
 static int cmp _ANSI_ARGS_((CONST chr *, CONST chr *, size_t));
 static int casecmp _ANSI_ARGS_((CONST chr *, CONST chr *, size_t));
 /* automatically gathered by fwd; do not hand-edit */
@@ -298,7 +332,6 @@ int flags;
 	struct vars *v = &var;
 	struct guts *g;
 	int i;
-	size_t j;
 	FILE *debug = (flags&REG_PROGRESS) ? stdout : (FILE *)NULL;
 #	define	CNOERR()	{ if (ISERR()) return freev(v, v->err); }
 
@@ -312,61 +345,13 @@ int flags;
 	if (!(flags&REG_EXTENDED) && (flags&REG_ADVF))
 		return REG_INVARG;
 
-	/* initial setup (after which freev() is callable) */
-	v->re = re;
+	/* setup, after which freev() is callable */
+	i = prepare(v, re, flags);
+	if (i != REG_OKAY)
+		return i;
+	g = (struct guts *)re->re_guts;
 	v->now = (chr *)string;
 	v->stop = v->now + len;
-	v->savenow = v->savestop = NULL;
-	v->err = 0;
-	v->cflags = flags;
-	v->nsubexp = 0;
-	v->subs = v->sub10;
-	v->nsubs = 10;
-	for (j = 0; j < v->nsubs; j++)
-		v->subs[j] = NULL;
-	v->nfa = NULL;
-	v->cm = NULL;
-	v->nlcolor = COLORLESS;
-	v->wordchrs = NULL;
-	v->tree = NULL;
-	v->treechain = NULL;
-	v->treefree = NULL;
-	v->cv = NULL;
-	v->cv2 = NULL;
-	v->mcces = NULL;
-	v->lacons = NULL;
-	v->nlacons = 0;
-	re->re_magic = REMAGIC;
-	re->re_info = 0;		/* bits get set during parse */
-	re->re_csize = sizeof(chr);
-	re->re_guts = NULL;
-	re->re_fns = VS(&functions);
-
-	/* more complex setup, malloced things */
-	re->re_guts = VS(MALLOC(sizeof(struct guts)));
-	if (re->re_guts == NULL)
-		return freev(v, REG_ESPACE);
-	g = (struct guts *)re->re_guts;
-	g->tree = NULL;
-	initcm(v, &g->cmap);
-	v->cm = &g->cmap;
-	g->lacons = NULL;
-	g->nlacons = 0;
-	ZAPCNFA(g->search);
-	v->nfa = newnfa(v, v->cm, (struct nfa *)NULL);
-	CNOERR();
-	v->cv = newcvec(100, 20, 10);
-	if (v->cv == NULL)
-		return freev(v, REG_ESPACE);
-	i = nmcces(v);
-	if (i > 0) {
-		v->mcces = newcvec(nleaders(v), 0, i);
-		CNOERR();
-		v->mcces = allmcces(v, v->mcces);
-		leaders(v, v->mcces);
-		addmcce(v->mcces, (chr *)NULL, (chr *)NULL);	/* dummy */
-	}
-	CNOERR();
 
 	/* parsing */
 	lexstart(v);			/* also handles prefixes */
@@ -393,6 +378,7 @@ int flags;
 	v->ntree = numst(v->tree, 1);
 	markst(v->tree);
 	cleanst(v);
+	refst(v->tree);
 	if (debug != NULL) {
 		fprintf(debug, "\n\n\n========= TREE FIXED ==========\n");
 		dumpst(v->tree, debug, 1);
@@ -411,16 +397,50 @@ int flags;
 	if (v->tree->flags&SHORTER)
 		NOTE(REG_USHORTEST);
 
+	/* one-pass program, while the NFA still shows where captures are */
+	onepass(v, v->nfa, g);
+	CNOERR();
+
 	/* build compacted NFAs for tree, lacons, fast search */
 	if (debug != NULL)
 		fprintf(debug, "\n\n\n========= SEARCH ==========\n");
 	/* can sacrifice main NFA now, so use it as work area */
 	(DISCARD)optimize(v->nfa, debug);
 	CNOERR();
+	findpfx(v, v->nfa, g);
+	findlit(v, v->nfa, g);
+	findlens(v, v->nfa, g);
+	CNOERR();
+	rcompact(v->nfa, &g->reverse);
+	CNOERR();
+	if (!NULLCNFA(g->reverse)) {
+		compact(v->nfa, &g->ahead);
+		CNOERR();
+		g->ahead.flags |= MIDSTART;
+	}
+	determinize(v, &g->reverse);
+	CNOERR();
+	determinize(v, &g->ahead);
+	CNOERR();
 	makesearch(v, v->nfa);
 	CNOERR();
 	compact(v->nfa, &g->search);
 	CNOERR();
+	determinize(v, &g->search);
+	CNOERR();
+	bitnfa(v, &g->search);
+	CNOERR();
+	flattencm(v->cm);
+	CNOERR();
+
+	/* empty DFA cache, one slot per compacted NFA that exec runs */
+	g->dfas = (struct dfa **)MALLOC((v->ntree + 2 + v->nlacons) *
+							sizeof(struct dfa *));
+	if (g->dfas == NULL)
+		return freev(v, REG_ESPACE);
+	g->ndfas = v->ntree + 2 + v->nlacons;
+	for (i = 0; i < g->ndfas; i++)
+		g->dfas[i] = NULL;
 
 	/* looks okay, package it up */
 	re->re_nsub = v->nsubexp;
@@ -444,6 +464,309 @@ int flags;
 	return freev(v, 0);
 }
 
+/*
+ - regsetcomp - compile a set of REs, to be matched all at once
+ * The REs, each with its own flags, go into one NFA and so share one
+ * colormap.  Each gets its own initial and final states, and its final
+ * state leads to an accept state of its own just as it does to post,
+ * so the accept state is entered with post on the chr after a match of
+ * that RE.  Accept states are flagged, like pre and post, so that they
+ * come through optimization as themselves, and their numbers tell
+ * regsetexec() which REs a state set has seen matched.  Backreferences
+ * the NFA can only approximate, so an RE with any is also compiled
+ * alone, for regsetexec() to confirm what the NFA claims.
+ ^ int regsetcomp(regex_t *, int, CONST chr *CONST [], CONST size_t [],
+ ^ 					CONST int []);
+ */
+int
+regsetcomp(re, n, pats, lens, flags)
+regex_t *re;
+int n;				/* number of REs */
+CONST chr *CONST pats[];
+CONST size_t lens[];
+CONST int flags[];		/* compile flags of each */
+{
+	struct vars var;
+	struct vars *v = &var;
+	struct guts *g;
+	struct state **acc;	/* accept state of each RE, then final */
+	struct state *init;
+	struct arc *a;
+	struct arc *b;
+	struct subre *t;
+	long info;
+	int i;
+	int j;
+	int st;
+	size_t k;
+	FILE *debug = NULL;
+#	define	SNOERR()	{ if (ISERR()) { FREE(acc); return freev(v, v->err); } }
+
+	/* sanity checks */
+	if (re == NULL || n <= 0 || pats == NULL || lens == NULL ||
+								flags == NULL)
+		return REG_INVARG;
+	for (i = 0; i < n; i++) {
+		if (pats[i] == NULL)
+			return REG_INVARG;
+		if ((flags[i]&REG_QUOTE) &&
+			(flags[i]&(REG_ADVANCED|REG_EXPANDED|REG_NEWLINE)))
+			return REG_INVARG;
+		if (!(flags[i]&REG_EXTENDED) && (flags[i]&REG_ADVF))
+			return REG_INVARG;
+		if (flags[i]&REG_EXPECT)
+			return REG_INVARG;	/* no one match to report on */
+		if (flags[i]&REG_PROGRESS)
+			debug = stdout;
+	}
+	acc = (struct state **)MALLOC(2 * n * sizeof(struct state *));
+	if (acc == NULL)
+		return REG_ESPACE;
+
+	/* setup, after which freev() is callable */
+	st = prepare(v, re, 0);
+	if (st != REG_OKAY) {
+		FREE(acc);
+		return st;
+	}
+	g = (struct guts *)re->re_guts;
+	g->setre = (regex_t *)MALLOC(n * sizeof(regex_t));
+	if (g->setre == NULL)
+		ERR(REG_ESPACE);
+	SNOERR();
+	g->nset = n;
+	for (i = 0; i < n; i++)
+		g->setre[i].re_magic = 0;
+
+	/* parsing, one RE at a time, into the one NFA */
+	for (i = 0; i < n; i++) {
+		v->now = (chr *)pats[i];
+		v->stop = v->now + lens[i];
+		v->cflags = flags[i] & ~(REG_SHARED|REG_FULLDFA);
+		v->nsubexp = 0;
+		for (k = 0; k < v->nsubs; k++)
+			v->subs[k] = NULL;
+		v->wordchrs = NULL;
+		info = re->re_info;
+		re->re_info = 0;
+		lexstart(v);		/* also handles prefixes */
+		if (((v->cflags&REG_NLSTOP) || (v->cflags&REG_NLANCH)) &&
+						v->nlcolor == COLORLESS) {
+			/* assign newline a unique color */
+			v->nlcolor = subcolor(v->cm, newline());
+			okcolors(v->nfa, v->cm);
+		}
+		SNOERR();
+		init = newstate(v->nfa);
+		acc[n + i] = newstate(v->nfa);
+		acc[i] = newfstate(v->nfa, '#');	/* not optimized away */
+		SNOERR();
+		EMPTYARC(v->nfa->init, init);
+		/* out of each final state, as newnfa() has it, to post too */
+		rainbow(v->nfa, v->cm, PLAIN, COLORLESS, acc[n + i], acc[i]);
+		newarc(v->nfa, '$', 1, acc[n + i], acc[i]);
+		newarc(v->nfa, '$', 0, acc[n + i], acc[i]);
+		rainbow(v->nfa, v->cm, PLAIN, COLORLESS, acc[n + i],
+							v->nfa->post);
+		newarc(v->nfa, '$', 1, acc[n + i], v->nfa->post);
+		newarc(v->nfa, '$', 0, acc[n + i], v->nfa->post);
+		t = parse(v, EOS, PLAIN, init, acc[n + i]);
+		assert(SEE(EOS));	/* even if error; ISERR() => SEE(EOS) */
+		SNOERR();
+		freesubre(v, t);
+		if (re->re_info&REG_UBACKREF) {
+			/* the NFA's idea of a match needs checking */
+			st = compile(&g->setre[i], pats[i], lens[i], flags[i]);
+			if (st != REG_OKAY)
+				ERR(st);
+			SNOERR();
+		}
+		re->re_info |= info;
+	}
+
+	/* finish setup of nfa */
+	specialcolors(v->nfa);
+	SNOERR();
+	if (debug != NULL) {
+		fprintf(debug, "\n\n\n========= RAW ==========\n");
+		dumpnfa(v->nfa, debug);
+	}
+
+	/* compacted NFAs for lacons, and the search NFA */
+	assert(v->nlacons == 0 || v->lacons != NULL);
+	for (i = 1; i < v->nlacons; i++) {
+		if (debug != NULL)
+			fprintf(debug, "\n\n\n========= LA%d ==========\n", i);
+		nfanode(v, &v->lacons[i], debug);
+	}
+	SNOERR();
+	if (debug != NULL)
+		fprintf(debug, "\n\n\n========= SEARCH ==========\n");
+	(DISCARD)optimize(v->nfa, debug);
+	SNOERR();
+	for (i = 0; i < n; i++)		/* as pushfwd() does for post */
+		for (a = acc[i]->ins; a != NULL; a = b) {
+			b = a->inchain;
+			if (a->type == '$') {
+				assert(a->co == 0 || a->co == 1);
+				newarc(v->nfa, PLAIN, v->nfa->eos[a->co],
+							a->from, a->to);
+				freearc(v->nfa, a);
+			}
+		}
+	SNOERR();
+	makesearch(v, v->nfa);
+	SNOERR();
+	compact(v->nfa, &g->search);
+	SNOERR();
+	flattencm(v->cm);
+	SNOERR();
+
+	/* which search states accept for which REs */
+	j = (g->search.nstates + UBITS - 1) / UBITS;
+	g->setpat = (int *)MALLOC(g->search.nstates * sizeof(int));
+	g->setmask = (unsigned *)MALLOC(j * sizeof(unsigned));
+	if (g->setpat == NULL || g->setmask == NULL)
+		ERR(REG_ESPACE);
+	SNOERR();
+	for (i = 0; i < g->search.nstates; i++)
+		g->setpat[i] = -1;
+	for (i = 0; i < j; i++)
+		g->setmask[i] = 0;
+	for (i = 0; i < n; i++) {
+		assert(acc[i]->no >= 0 && acc[i]->no < g->search.nstates);
+		g->setpat[acc[i]->no] = i;
+		BSET(g->setmask, acc[i]->no);
+	}
+
+	/* empty DFA cache, laid out as compile's with a one-node tree */
+	g->dfas = (struct dfa **)MALLOC((1 + 2 + v->nlacons) *
+							sizeof(struct dfa *));
+	if (g->dfas == NULL)
+		ERR(REG_ESPACE);
+	SNOERR();
+	g->ndfas = 1 + 2 + v->nlacons;
+	for (i = 0; i < g->ndfas; i++)
+		g->dfas[i] = NULL;
+
+	/* looks okay, package it up */
+	re->re_nsub = 0;
+	v->re = NULL;			/* freev no longer frees re */
+	g->magic = GUTSMAGIC;
+	for (i = 0, j = 0; i < n; i++)
+		j |= flags[i];
+	g->cflags = j & ~(REG_SHARED|REG_FULLDFA);
+	g->info = re->re_info;
+	g->nsub = 0;
+	g->ntree = 1;
+	g->compare = cmp;
+	g->lacons = v->lacons;
+	v->lacons = NULL;
+	g->nlacons = v->nlacons;
+
+	FREE(acc);
+	assert(v->err == 0);
+	return freev(v, 0);
+}
+
+/*
+ - prepare - set up the vars and an empty RE, for compile or regsetcomp
+ * On failure everything is freed again, and the error code returned.
+ ^ static int prepare(struct vars *, regex_t *, int);
+ */
+static int
+prepare(v, re, flags)
+struct vars *v;
+regex_t *re;
+int flags;
+{
+	struct guts *g;
+	int i;
+	size_t j;
+
+	/* initial setup (after which freev() is callable) */
+	v->re = re;
+	v->now = NULL;		/* the caller points these at the RE */
+	v->stop = NULL;
+	v->savenow = v->savestop = NULL;
+	v->err = 0;
+	v->cflags = flags;
+	v->nsubexp = 0;
+	v->subs = v->sub10;
+	v->nsubs = 10;
+	for (j = 0; j < v->nsubs; j++)
+		v->subs[j] = NULL;
+	v->nfa = NULL;
+	v->cm = NULL;
+	v->nlcolor = COLORLESS;
+	v->wordchrs = NULL;
+	v->tree = NULL;
+	v->treechain = NULL;
+	v->treefree = NULL;
+	v->cv = NULL;
+	v->cv2 = NULL;
+	v->mcces = NULL;
+	v->lacons = NULL;
+	v->nlacons = 0;
+	re->re_magic = REMAGIC;
+	re->re_info = 0;		/* bits get set during parse */
+	re->re_csize = sizeof(chr);
+	re->re_guts = NULL;
+	re->re_fns = VS(&functions);
+
+	/* more complex setup, malloced things */
+	re->re_guts = VS(MALLOC(sizeof(struct guts)));
+	if (re->re_guts == NULL)
+		return freev(v, REG_ESPACE);
+	g = (struct guts *)re->re_guts;
+	g->tree = NULL;
+	initcm(v, &g->cmap);
+	v->cm = &g->cmap;
+	g->lacons = NULL;
+	g->nlacons = 0;
+	g->dfas = NULL;
+	g->ndfas = 0;
+	g->dfafree = NULL;
+	g->cache.rc_budget = 0;
+	g->cache.rc_policy = 0;
+	g->cache.rc_flushes = 0;
+	g->cache.rc_evictions = 0;
+	g->nlit = 0;
+	g->litrare = 0;
+	g->npfx = 0;
+	g->one = NULL;
+	g->minlen = 0;
+	g->maxlen = -1;
+	g->anchored = 0;
+	g->startco = NULL;
+	g->nset = 0;
+	g->setpat = NULL;
+	g->setmask = NULL;
+	g->setre = NULL;
+	ZAPCNFA(g->search);
+	ZAPCNFA(g->reverse);
+	ZAPCNFA(g->ahead);
+	v->nfa = newnfa(v, v->cm, (struct nfa *)NULL);
+	if (ISERR())
+		return freev(v, v->err);
+	v->cv = newcvec(100, 20, 10);
+	if (v->cv == NULL)
+		return freev(v, REG_ESPACE);
+	i = nmcces(v);
+	if (i > 0) {
+		v->mcces = newcvec(nleaders(v), 0, i);
+		if (ISERR())
+			return freev(v, v->err);
+		v->mcces = allmcces(v, v->mcces);
+		leaders(v, v->mcces);
+		addmcce(v->mcces, (chr *)NULL, (chr *)NULL);	/* dummy */
+	}
+	if (ISERR())
+		return freev(v, v->err);
+
+	return REG_OKAY;
+}
+
 /*
  - moresubs - enlarge subRE vector
  ^ static VOID moresubs(struct vars *, int);
@@ -552,10 +875,12 @@ struct nfa *nfa;
 	 * and no-progress states.
 	 */
 
-	/* first, make a list of the states */
-	slist = NULL;
+	/* first, make a list of the states, each once (pre ends it) */
+	slist = pre;
 	for (a = pre->outs; a != NULL; a = a->outchain) {
 		s = a->to;
+		if (s->tmp != NULL)
+			continue;	/* NOTE CONTINUE */
 		for (b = s->ins; b != NULL; b = b->inchain)
 			if (b->from != pre)
 				break;
@@ -566,7 +891,7 @@ struct nfa *nfa;
 	}
 
 	/* do the splits */
-	for (s = slist; s != NULL; s = s2) {
+	for (s = slist; s != pre; s = s2) {
 		s2 = newstate(nfa);
 		copyouts(nfa, s, s2);
 		for (a = s->ins; a != NULL; a = b) {
@@ -1779,6 +2104,7 @@ struct state *end;
 	ret->retry = 0;
 	ret->subno = 0;
 	ret->min = ret->max = 1;
+	ret->refs = 0;
 	ret->left = NULL;
 	ret->right = NULL;
 	ret->begin = begin;
@@ -1889,6 +2215,30 @@ struct subre *t;
 		markst(t->right);
 }
 
+/*
+ - refst - note which groups each subtree's backrefs refer to
+ ^ static VOID refst(struct subre *);
+ */
+static VOID
+refst(t)
+struct subre *t;
+{
+	assert(t != NULL);
+
+	if (t->op == 'b')
+		t->refs = (t->subno < UBITS) ? 1U << t->subno : MANYREFS;
+	else
+		t->refs = 0;
+	if (t->left != NULL) {
+		refst(t->left);
+		t->refs |= t->left->refs;
+	}
+	if (t->right != NULL) {
+		refst(t->right);
+		t->refs |= t->right->refs;
+	}
+}
+
 /*
  - cleanst - free any tree nodes not marked INUSE
  ^ static VOID cleanst(struct vars *);
@@ -1957,6 +2307,10 @@ FILE *f;			/* for debug output */
 	}
 	if (!ISERR())
 		compact(nfa, &t->cnfa);
+	if (!ISERR())
+		determinize(v, &t->cnfa);
+	if (!ISERR())
+		bitnfa(v, &t->cnfa);
 
 	freenfa(nfa);
 	return ret;
@@ -2025,6 +2379,7 @@ rfree(re)
 regex_t *re;
 {
 	struct guts *g;
+	int i;
 
 	if (re == NULL || re->re_magic != REMAGIC)
 		return;
@@ -2041,6 +2396,29 @@ regex_t *re;
 		freelacons(g->lacons, g->nlacons);
 	if (!NULLCNFA(g->search))
 		freecnfa(&g->search);
+	if (!NULLCNFA(g->reverse))
+		freecnfa(&g->reverse);
+	if (!NULLCNFA(g->ahead))
+		freecnfa(&g->ahead);
+	if (g->one != NULL)
+		freeone(g->one);
+	if (g->startco != NULL)
+		FREE(g->startco);
+	if (g->setpat != NULL)
+		FREE(g->setpat);
+	if (g->setmask != NULL)
+		FREE(g->setmask);
+	if (g->setre != NULL) {
+		for (i = 0; i < g->nset; i++)
+			rfree(&g->setre[i]);	/* nop if never compiled */
+		FREE(g->setre);
+	}
+	if (g->dfas != NULL) {
+		for (i = 0; i < g->ndfas; i++)
+			if (g->dfas[i] != NULL)
+				(*g->dfafree)(g->dfas[i]);
+		FREE(g->dfas);
+	}
 	FREE(g);
 }
 
@@ -2056,6 +2434,7 @@ FILE *f;
 #ifdef REG_DEBUG
 	struct guts *g;
 	int i;
+	int j;
 
 	if (re->re_magic != REMAGIC)
 		fprintf(f, "bad magic number (0x%x not 0x%x)\n", re->re_magic,
@@ -2072,12 +2451,35 @@ FILE *f;
 	fprintf(f, "\n\n\n========= DUMP ==========\n");
 	fprintf(f, "nsub %d, info 0%lo, csize %d, ntree %d\n", 
 		re->re_nsub, re->re_info, re->re_csize, g->ntree);
+	if (g->nlit > 0) {
+		fprintf(f, "literal \"");
+		for (i = 0; i < g->nlit; i++)
+			dumpchr(g->lit[i], f);
+		fprintf(f, "\", rarest at %d\n", g->litrare);
+	}
+	for (i = 0; i < g->npfx; i++) {
+		fprintf(f, "prefix \"");
+		for (j = 0; j < g->pfxlen[i]; j++)
+			dumpchr(g->pfx[i][j], f);
+		fprintf(f, "\"\n");
+	}
+	fprintf(f, "length %d to %d%s%s\n", g->minlen, g->maxlen,
+		(g->anchored) ? ", anchored" : "",
+		(g->startco != NULL) ? ", start colors known" : "");
+	if (g->one != NULL)
+		fprintf(f, "one-pass, %d states\n", g->one->nstates);
 
 	dumpcolors(&g->cmap, f);
 	if (!NULLCNFA(g->search)) {
 		printf("\nsearch:\n");
 		dumpcnfa(&g->search, f);
 	}
+	if (!NULLCNFA(g->reverse)) {
+		fprintf(f, "\nreverse:\n");
+		dumpcnfa(&g->reverse, f);
+		fprintf(f, "\nahead:\n");
+		dumpcnfa(&g->ahead, f);
+	}
 	for (i = 1; i < g->nlacons; i++) {
 		fprintf(f, "\nla%d (%s):\n", i,
 				(g->lacons[i].subno) ? "positive" : "negative");
@@ -2178,5 +2580,9 @@ size_t bufsize;
 #include "regc_lex.c"
 #include "regc_color.c"
 #include "regc_nfa.c"
+#include "regc_dfa.c"
+#include "regc_bit.c"
+#include "regc_lit.c"
+#include "regc_one.c"
 #include "regc_cvec.c"
 #include "regc_locale.c"
@@ -0,0 +1,14 @@
+/* ---:mferris: This file contains ONLY the following external definitions:
+ *
+ * function compile() which is #defined to MO_ReComp8()
+ * function regsetcomp() which is #defined to MO_ReSetComp8()
+ */
+
+/*
+ * The RE compiler again, this time with 8-bit chrs (see regcustom.h).
+ * REs compiled here are for Latin-1 text, and only the functions from
+ * regexec8.c will match them; the rest of the world gets REG_MIXED.
+ */
+
+#define	REG_CHR8	/* chr is unsigned char */
+#include "regcomp.c"
@@ -39,7 +39,11 @@
 
 #define VOID void
 #define CONST const
+#ifdef REG_CHR8
+#define UCHAR (unsigned char)
+#else
 #define UCHAR (MO_unichar)
+#endif
 
 
 /*
@@ -73,42 +77,108 @@
 #undef __REG_NOCHAR
 #endif
 /* interface types */
+#ifdef REG_CHR8
+#define	__REG_WIDE_T	unsigned char	/* the 8-bit build, see below */
+#else
 #define	__REG_WIDE_T	MO_unichar
+#endif
 #define	__REG_REGOFF_T	long	/* not really right, but good enough... */
 #define	__REG_VOID_T	VOID
 #define	__REG_CONST	CONST
 /* names and declarations */
-#define	__REG_WIDE_COMPILE	MO_ReComp
-#define	__REG_WIDE_EXEC		MO_ReExec
 #define	__REG_NOFRONT		/* don't want regcomp() and regexec() */
-#define	__REG_NOCHAR		/* or the char versions */
 #define	regfree		MO_ReFree
 #define	regerror	MO_ReError
+#ifdef REG_CHR8
+#define	__REG_WIDE_COMPILE	MO_ReComp8
+#define	__REG_WIDE_EXEC		MO_ReExec8
+#define	__REG_NOCHAR		/* the char versions are these */
+#define	regtune		MO_ReTune8
+#define	regstats	MO_ReStats8
+#define	regbegin	MO_ReIterBegin8
+#define	regnext		MO_ReIterNext8
+#define	regend		MO_ReIterEnd8
+#define	regsbegin	MO_ReStreamBegin8
+#define	regsfeed	MO_ReStreamFeed8
+#define	regsnext	MO_ReStreamNext8
+#define	regsend		MO_ReStreamEnd8
+#define	regsetcomp	MO_ReSetComp8
+#define	regsetexec	MO_ReSetExec8
+#else
+#define	__REG_WIDE_COMPILE	MO_ReComp
+#define	__REG_WIDE_EXEC		MO_ReExec
+#define	re_comp		MO_ReComp8	/* char versions are the 8-bit build */
+#define	re_exec		MO_ReExec8
+#define	re_tune		MO_ReTune8
+#define	re_stats	MO_ReStats8
+#define	re_begin	MO_ReIterBegin8
+#define	re_next		MO_ReIterNext8
+#define	re_end		MO_ReIterEnd8
+#define	re_sbegin	MO_ReStreamBegin8
+#define	re_sfeed	MO_ReStreamFeed8
+#define	re_snext	MO_ReStreamNext8
+#define	re_send		MO_ReStreamEnd8
+#define	re_setcomp	MO_ReSetComp8
+#define	re_setexec	MO_ReSetExec8
+#define	regtune		MO_ReTune
+#define	regstats	MO_ReStats
+#define	regbegin	MO_ReIterBegin
+#define	regnext		MO_ReIterNext
+#define	regend		MO_ReIterEnd
+#define	regsbegin	MO_ReStreamBegin
+#define	regsfeed	MO_ReStreamFeed
+#define	regsnext	MO_ReStreamNext
+#define	regsend		MO_ReStreamEnd
+#define	regsetcomp	MO_ReSetComp
+#define	regsetexec	MO_ReSetExec
+#define	regsfeedu	MO_ReStreamFeedUTF8
+#define	regexecu	MO_ReExecUTF8
+#endif
 /* --- end --- */
 
 
 
-/* internal character type and related */
+/*
+ * Internal character type and related.  The engine proper is compiled
+ * once per character size:  regcomp.c and regexec.c with 16-bit chrs
+ * for Unicode text, and regcomp8.c and regexec8.c, which define REG_CHR8
+ * and #include those two, with 8-bit chrs for Latin-1 (and ASCII) text.
+ * The 8-bit build has single-level colormaps and smaller everything.
+ */
+#ifdef REG_CHR8
+typedef unsigned char chr;	/* the type itself */
+#else
 typedef MO_unichar chr;	/* the type itself */
+#endif
 typedef int pchr;		/* what it promotes to */
 typedef unsigned uchr;		/* unsigned type that will hold a chr */
 typedef int celt;		/* type to hold chr, MCCE number, or NOCELT */
 #define	NOCELT	(-1)		/* celt value which is not valid chr or MCCE */
 #define	CHR(c)	(UCHAR(c))	/* turn char literal into chr literal */
 #define	DIGITVAL(c)	((c)-'0')	/* turn chr digit into its value */
-#define	CHRBITS	16		/* bits in a chr; must not use sizeof */
 #define	CHR_MIN	0x0000		/* smallest and largest chr; the value */
+#ifdef REG_CHR8
+#define	CHRBITS	8		/* bits in a chr; must not use sizeof */
+#define	CHR_MAX	0xff		/*  CHR_MAX-CHR_MIN+1 should fit in uchr */
+#else
+#define	CHRBITS	16		/* bits in a chr; must not use sizeof */
 #define	CHR_MAX	0xffff		/*  CHR_MAX-CHR_MIN+1 should fit in uchr */
+#endif
 
-/* functions operating on chr */
+/* functions operating on chr (Latin-1 is the first 256 of Unicode) */
 #define	iscalnum(x)	MO_UniCharIsAlnum(x)
 #define	iscalpha(x)	MO_UniCharIsAlpha(x)
 #define	iscdigit(x)	MO_UniCharIsDigit(x)
 #define	iscspace(x)	MO_UniCharIsSpace(x)
 
 /* name the external functions */
+#ifdef REG_CHR8
+#define	compile		MO_ReComp8
+#define	exec		MO_ReExec8
+#else
 #define	compile		MO_ReComp
 #define	exec		MO_ReExec
+#endif
 
 /* enable/disable debugging code (by whether REG_DEBUG is defined or not) */
 #if 0		/* no debug unless requested by makefile */
@@ -0,0 +1,218 @@
+/* ---:mferris: This file contains NO external definitions. */
+
+/*
+ * Bit-parallel NFA simulation.
+ * This file is #included by regexec.c.
+ *
+ * See regc_bit.c for the form.  A step costs a few table lookups however
+ * new the set of states is, where the lazy DFA pays for a miss the first
+ * time it sees each transition; so on strings too short for the cache to
+ * warm up, these are cheaper.  They answer exactly what longest() and
+ * shortest() would, down to giving up on a set that can't reach post
+ * and settling on one from which a match ends everywhere.
+ */
+
+/* a set with none of these is as good as none, as in miss() */
+#define	BLIVE(v, bp)	(((v)->g->cflags&REG_EXPECT) ? ~(bpword)0 : (bp)->live)
+/* a match ends at every point from here on, as for ALWAYS in miss() */
+#define	BALWAYS(bp, set)	(((set)&(bp)->always) && ((set)&(bp)->post))
+
+
+
+/*
+ - blongest - longest() with the bit-parallel NFA
+ ^ static chr *blongest(struct vars *, struct dfa *, chr *, chr *, int *);
+ */
+static chr *			/* endpoint, or NULL */
+blongest(v, d, start, stop, hitstopp)
+struct vars *v;
+struct dfa *d;
+chr *start;			/* where the match should start */
+chr *stop;			/* match must end at or before here */
+int *hitstopp;			/* record whether hit v->stop, if non-NULL */
+{
+	struct bpnfa *bp = d->cnfa->bits;
+	chr *cp;
+	chr *realstop = (stop == v->stop) ? stop : stop + 1;
+	color co;
+	bpword cur;
+	bpword nxt;
+	bpword live = BLIVE(v, bp);
+	chr *post;
+	chr *chk;		/* where to pay for the chrs so far */
+	struct colormap *cm = d->cm;
+
+	cp = start;
+	if (hitstopp != NULL)
+		*hitstopp = 0;
+
+	/* startup */
+	if (cp == v->start)
+		co = d->cnfa->bos[(v->eflags&REG_NOTBOL) ? 0 : 1];
+	else
+		co = FGETCOLOR(cm, *(cp - 1));
+	cur = bfollow(bp, bp->start) & bp->colors[co];
+	if (!(cur&live))
+		return NULL;
+	post = (cur&bp->post) ? cp : NULL;
+
+	/* main loop */
+	chk = SPENDAT(v, cp, realstop);
+	while (cp < realstop) {
+		if (cp >= chk) {	/* see SPENDAT() */
+			if (SPEND(v, 1))
+				return NULL;
+			chk = SPENDAT(v, cp, realstop);
+		}
+		co = FGETCOLOR(cm, *cp);
+		nxt = bfollow(bp, cur) & bp->colors[co];
+		if (!(nxt&live))
+			break;		/* NOTE BREAK OUT */
+		cp++;
+		if (nxt&bp->post)
+			post = cp;
+		cur = nxt;
+		if (BALWAYS(bp, cur))
+			break;		/* NOTE BREAK OUT */
+	}
+
+	/* settled:  a match ends at every point from here to stop */
+	if (BALWAYS(bp, cur)) {
+		if (hitstopp != NULL && stop == v->stop)
+			*hitstopp = 1;
+		return stop;
+	}
+
+	/* shutdown */
+	if (cp == v->stop && stop == v->stop) {
+		if (hitstopp != NULL)
+			*hitstopp = 1;
+		co = d->cnfa->eos[(v->eflags&REG_NOTEOL) ? 0 : 1];
+		/* special case:  match ended at eol? */
+		if (bfollow(bp, cur) & bp->colors[co] & bp->post)
+			return cp;
+	}
+
+	if (post != NULL)
+		return post - 1;
+	return NULL;
+}
+
+/*
+ - bshortest - shortest() with the bit-parallel NFA
+ ^ static chr *bshortest(struct vars *, struct dfa *, chr *, chr *, chr *,
+ ^ 	chr **, int *);
+ */
+static chr *			/* endpoint, or NULL */
+bshortest(v, d, start, min, max, coldp, hitstopp)
+struct vars *v;
+struct dfa *d;
+chr *start;			/* where the match should start */
+chr *min;			/* match must end at or after here */
+chr *max;			/* match must end at or before here */
+chr **coldp;			/* store coldstart pointer here, if nonNULL */
+int *hitstopp;			/* record whether hit v->stop, if non-NULL */
+{
+	struct bpnfa *bp = d->cnfa->bits;
+	chr *cp;
+	chr *realmin = (min == v->stop) ? min : min + 1;
+	chr *realmax = (max == v->stop) ? max : max + 1;
+	color co;
+	bpword cur;
+	bpword nxt;
+	bpword live = BLIVE(v, bp);
+	chr *nopr;		/* last place nothing was in progress */
+	chr *next;		/* no prefix starts before here */
+	chr *chk;		/* where to pay for the chrs so far */
+	int skip;
+	struct colormap *cm = d->cm;
+
+	skip = (d->cnfa == &v->g->search && USESKIP(v));
+	next = start;
+	nopr = start;
+	cp = start;
+	if (hitstopp != NULL)
+		*hitstopp = 0;
+
+	/* startup */
+	if (cp == v->start)
+		co = d->cnfa->bos[(v->eflags&REG_NOTBOL) ? 0 : 1];
+	else
+		co = FGETCOLOR(cm, *(cp - 1));
+	cur = bfollow(bp, bp->start) & bp->colors[co];
+	if (!(cur&live))
+		return NULL;
+	if (!(cur&bp->progress))
+		nopr = cp;
+
+	/* main loop */
+	chk = SPENDAT(v, cp, realmax);
+	while (cp < realmax) {
+		if (cp >= chk) {	/* see SPENDAT() */
+			if (SPEND(v, 1))
+				return NULL;
+			chk = SPENDAT(v, cp, realmax);
+		}
+		if (skip && !(cur&bp->progress) && cp >= next) {
+			/* nothing in progress, so on to next prefix */
+			next = skipscan(v, cp, max);
+			if (next == NULL)
+				return NULL;
+			if (next > cp) {
+				cp = next;
+				co = FGETCOLOR(cm, *(cp - 1));
+				cur = bfollow(bp, bp->start) & bp->colors[co];
+				if (!(cur&live))
+					return NULL;
+				if (!(cur&bp->progress))
+					nopr = cp;
+			}
+			next++;
+		}
+		co = FGETCOLOR(cm, *cp);
+		nxt = bfollow(bp, cur) & bp->colors[co];
+		if (!(nxt&live))
+			return NULL;
+		cp++;
+		cur = nxt;
+		if (!(cur&bp->progress))
+			nopr = cp;
+		if ((cur&bp->post) && cp >= realmin)
+			break;		/* NOTE BREAK OUT */
+	}
+
+	if (coldp != NULL)	/* report last no-progress state set */
+		*coldp = nopr;
+
+	if ((cur&bp->post) && cp > min) {
+		assert(cp >= realmin);
+		cp--;
+	} else if (cp == v->stop && max == v->stop) {
+		co = d->cnfa->eos[(v->eflags&REG_NOTEOL) ? 0 : 1];
+		cur = bfollow(bp, cur) & bp->colors[co];
+		/* match might have ended at eol */
+		if (!(cur&bp->post) && hitstopp != NULL)
+			*hitstopp = 1;
+	}
+
+	if (!(cur&bp->post))
+		return NULL;
+	return cp;
+}
+
+/*
+ - bfollow - everywhere the arcs out of a set of positions lead
+ ^ static bpword bfollow(struct bpnfa *, bpword);
+ */
+static bpword
+bfollow(bp, set)
+struct bpnfa *bp;
+bpword set;
+{
+	bpword *f = bp->follow;
+	bpword next = 0;
+
+	for (; set != 0; set >>= 4, f += 16)
+		next |= f[set & 0xf];
+	return next;
+}
@@ -50,11 +50,38 @@ int *hitstopp;			/* record whether hit v->stop, if non-NULL */
 	struct sset *css;
 	struct sset *ss;
 	chr *post;
+	chr *chk;		/* where to pay for the chrs so far */
 	int i;
+	long ev0;		/* evictions before we started */
 	struct colormap *cm = d->cm;
 
+	if (SPEND(v, 1))
+		return NULL;
+	if (d->cnfa->dtab != NULL)
+		return tlongest(v, d, start, stop, hitstopp);
+	if (d->cnfa->bits != NULL)
+		return blongest(v, d, start, stop, hitstopp);
+
+	if (d->shared) {
+		v->dfafull = 0;
+		cp = slongest(v, d, start, stop, hitstopp);
+		if (!v->dfafull)
+			return cp;
+		FDEBUG(("shared DFA full, going private\n"));
+		d = newdfa(v, d->cnfa, cm, DOMALLOC);
+		if (d == NULL)
+			return NULL;
+		cp = longest(v, d, start, stop, hitstopp);
+		freedfa(d);
+		return cp;
+	}
+
+	if (d->thrashed)
+		return nlongest(v, d, start, stop, hitstopp);
+
 	/* initialize */
 	css = initialize(v, d, start);
+	ev0 = v->nevictions;
 	cp = start;
 	if (hitstopp != NULL)
 		*hitstopp = 0;
@@ -65,7 +92,7 @@ int *hitstopp;			/* record whether hit v->stop, if non-NULL */
 		co = d->cnfa->bos[(v->eflags&REG_NOTBOL) ? 0 : 1];
 		FDEBUG(("color %ld\n", (long)co));
 	} else {
-		co = GETCOLOR(cm, *(cp - 1));
+		co = FGETCOLOR(cm, *(cp - 1));
 		FDEBUG(("char %c, color %ld\n", (char)*(cp-1), (long)co));
 	}
 	css = miss(v, d, css, co, cp, start);
@@ -74,35 +101,71 @@ int *hitstopp;			/* record whether hit v->stop, if non-NULL */
 	css->lastseen = cp;
 
 	/* main loop */
+	chk = SPENDAT(v, cp, realstop);
 	if (v->eflags&REG_FTRACE)
 		while (cp < realstop) {
+			if (cp >= chk) {	/* see SPENDAT() */
+				if (SPEND(v, 1))
+					return NULL;
+				chk = SPENDAT(v, cp, realstop);
+			}
 			FDEBUG(("+++ at c%d +++\n", css - d->ssets));
-			co = GETCOLOR(cm, *cp);
+			co = FGETCOLOR(cm, *cp);
 			FDEBUG(("char %c, color %ld\n", (char)*cp, (long)co));
 			ss = css->outs[co];
 			if (ss == NULL) {
 				ss = miss(v, d, css, co, cp+1, start);
 				if (ss == NULL)
 					break;	/* NOTE BREAK OUT */
+				if (THRASHING(v, d, ev0, cp - start)) {
+					d->thrashed = 1;
+					break;	/* NOTE BREAK OUT */
+				}
 			}
 			cp++;
 			ss->lastseen = cp;
 			css = ss;
+			if (css->flags&ALWAYS)
+				break;	/* NOTE BREAK OUT */
 		}
 	else
 		while (cp < realstop) {
-			co = GETCOLOR(cm, *cp);
+			if (cp >= chk) {	/* see SPENDAT() */
+				if (SPEND(v, 1))
+					return NULL;
+				chk = SPENDAT(v, cp, realstop);
+			}
+			co = FGETCOLOR(cm, *cp);
 			ss = css->outs[co];
 			if (ss == NULL) {
 				ss = miss(v, d, css, co, cp+1, start);
 				if (ss == NULL)
 					break;	/* NOTE BREAK OUT */
+				if (THRASHING(v, d, ev0, cp - start)) {
+					d->thrashed = 1;
+					break;	/* NOTE BREAK OUT */
+				}
 			}
 			cp++;
 			ss->lastseen = cp;
 			css = ss;
+			if (css->flags&ALWAYS)
+				break;	/* NOTE BREAK OUT */
 		}
 
+	if (d->thrashed) {	/* cache can't keep up, do without it */
+		FDEBUG(("DFA thrashing, going to NFA\n"));
+		return nlongest(v, d, start, stop, hitstopp);
+	}
+
+	/* settled:  a match ends at every point from here to stop */
+	if (css->flags&ALWAYS) {
+		FDEBUG(("+++ always at c%d +++\n", css - d->ssets));
+		if (hitstopp != NULL && stop == v->stop)
+			*hitstopp = 1;
+		return stop;
+	}
+
 	/* shutdown */
 	FDEBUG(("+++ shutdown at c%d +++\n", css - d->ssets));
 	if (cp == v->stop && stop == v->stop) {
@@ -151,10 +214,43 @@ int *hitstopp;			/* record whether hit v->stop, if non-NULL */
 	color co;
 	struct sset *css;
 	struct sset *ss;
+	struct sset *starter;
+	chr *next;		/* no prefix starts before here */
+	chr *chk;		/* where to pay for the chrs so far */
+	int skip;
+	long ev0;		/* evictions before we started */
 	struct colormap *cm = d->cm;
 
+	if (SPEND(v, 1))
+		return NULL;
+	if (d->cnfa->dtab != NULL)
+		return tshortest(v, d, start, min, max, coldp, hitstopp);
+	if (d->cnfa->bits != NULL)
+		return bshortest(v, d, start, min, max, coldp, hitstopp);
+
+	if (d->shared) {
+		v->dfafull = 0;
+		cp = sshortest(v, d, start, min, max, coldp, hitstopp);
+		if (!v->dfafull)
+			return cp;
+		FDEBUG(("shared DFA full, going private\n"));
+		d = newdfa(v, d->cnfa, cm, DOMALLOC);
+		if (d == NULL)
+			return NULL;
+		cp = shortest(v, d, start, min, max, coldp, hitstopp);
+		freedfa(d);
+		return cp;
+	}
+
+	if (d->thrashed)
+		return nshortest(v, d, start, min, max, coldp, hitstopp);
+
 	/* initialize */
 	css = initialize(v, d, start);
+	ev0 = v->nevictions;
+	starter = css;
+	skip = (d->cnfa == &v->g->search && USESKIP(v));
+	next = start;
 	cp = start;
 	if (hitstopp != NULL)
 		*hitstopp = 0;
@@ -165,7 +261,7 @@ int *hitstopp;			/* record whether hit v->stop, if non-NULL */
 		co = d->cnfa->bos[(v->eflags&REG_NOTBOL) ? 0 : 1];
 		FDEBUG(("color %ld\n", (long)co));
 	} else {
-		co = GETCOLOR(cm, *(cp - 1));
+		co = FGETCOLOR(cm, *(cp - 1));
 		FDEBUG(("char %c, color %ld\n", (char)*(cp-1), (long)co));
 	}
 	css = miss(v, d, css, co, cp, start);
@@ -175,16 +271,26 @@ int *hitstopp;			/* record whether hit v->stop, if non-NULL */
 	ss = css;
 
 	/* main loop */
+	chk = SPENDAT(v, cp, realmax);
 	if (v->eflags&REG_FTRACE)
 		while (cp < realmax) {
+			if (cp >= chk) {	/* see SPENDAT() */
+				if (SPEND(v, 1))
+					return NULL;
+				chk = SPENDAT(v, cp, realmax);
+			}
 			FDEBUG(("--- at c%d ---\n", css - d->ssets));
-			co = GETCOLOR(cm, *cp);
+			co = FGETCOLOR(cm, *cp);
 			FDEBUG(("char %c, color %ld\n", (char)*cp, (long)co));
 			ss = css->outs[co];
 			if (ss == NULL) {
 				ss = miss(v, d, css, co, cp+1, start);
 				if (ss == NULL)
 					break;	/* NOTE BREAK OUT */
+				if (THRASHING(v, d, ev0, cp - start)) {
+					d->thrashed = 1;
+					break;	/* NOTE BREAK OUT */
+				}
 			}
 			cp++;
 			ss->lastseen = cp;
@@ -194,12 +300,37 @@ int *hitstopp;			/* record whether hit v->stop, if non-NULL */
 		}
 	else
 		while (cp < realmax) {
-			co = GETCOLOR(cm, *cp);
+			if (cp >= chk) {	/* see SPENDAT() */
+				if (SPEND(v, 1))
+					return NULL;
+				chk = SPENDAT(v, cp, realmax);
+			}
+			if (skip && (css->flags&NOPROGRESS) && cp >= next) {
+				/* nothing in progress, so on to next prefix */
+				next = skipscan(v, cp, max);
+				if (next == NULL)
+					return NULL;
+				if (next > cp) {
+					cp = next;
+					co = FGETCOLOR(cm, *(cp - 1));
+					css = miss(v, d, starter, co, cp,
+									start);
+					if (css == NULL)
+						return NULL;
+					css->lastseen = cp;
+				}
+				next++;
+			}
+			co = FGETCOLOR(cm, *cp);
 			ss = css->outs[co];
 			if (ss == NULL) {
 				ss = miss(v, d, css, co, cp+1, start);
 				if (ss == NULL)
 					break;	/* NOTE BREAK OUT */
+				if (THRASHING(v, d, ev0, cp - start)) {
+					d->thrashed = 1;
+					break;	/* NOTE BREAK OUT */
+				}
 			}
 			cp++;
 			ss->lastseen = cp;
@@ -208,28 +339,644 @@ int *hitstopp;			/* record whether hit v->stop, if non-NULL */
 				break;		/* NOTE BREAK OUT */
 		}
 
-	if (ss == NULL)
-		return NULL;
+	if (d->thrashed) {	/* cache can't keep up, do without it */
+		FDEBUG(("DFA thrashing, going to NFA\n"));
+		return nshortest(v, d, start, min, max, coldp, hitstopp);
+	}
+
+	if (ss == NULL)
+		return NULL;
+
+	if (coldp != NULL)	/* report last no-progress state set, if any */
+		*coldp = lastcold(v, d);
+
+	if ((ss->flags&POSTSTATE) && cp > min) {
+		assert(cp >= realmin);
+		cp--;
+	} else if (cp == v->stop && max == v->stop) {
+		co = d->cnfa->eos[(v->eflags&REG_NOTEOL) ? 0 : 1];
+		FDEBUG(("color %ld\n", (long)co));
+		ss = miss(v, d, css, co, cp, start);
+		/* match might have ended at eol */
+		if ((ss == NULL || !(ss->flags&POSTSTATE)) && hitstopp != NULL)
+			*hitstopp = 1;
+	}
+
+	if (ss == NULL || !(ss->flags&POSTSTATE))
+		return NULL;
+
+	return cp;
+}
+
+/*
+ - slongest - longest() for a shared DFA
+ * Other threads are using the DFA too, so only miss() may write to it;
+ * rather than noting lastseen, we keep track of the last success here.
+ * If the DFA runs out of room, v->dfafull is set and the result is junk.
+ ^ static chr *slongest(struct vars *, struct dfa *, chr *, chr *, int *);
+ */
+static chr *			/* endpoint, or NULL */
+slongest(v, d, start, stop, hitstopp)
+struct vars *v;
+struct dfa *d;
+chr *start;			/* where the match should start */
+chr *stop;			/* match must end at or before here */
+int *hitstopp;			/* record whether hit v->stop, if non-NULL */
+{
+	chr *cp;
+	chr *realstop = (stop == v->stop) ? stop : stop + 1;
+	color co;
+	struct sset *css;
+	struct sset *ss;
+	chr *post;
+	chr *chk;		/* where to pay for the chrs so far */
+	struct colormap *cm = d->cm;
+
+	/* initialize */
+	css = initialize(v, d, start);
+	cp = start;
+	if (hitstopp != NULL)
+		*hitstopp = 0;
+
+	/* startup */
+	if (cp == v->start)
+		co = d->cnfa->bos[(v->eflags&REG_NOTBOL) ? 0 : 1];
+	else
+		co = FGETCOLOR(cm, *(cp - 1));
+	css = miss(v, d, css, co, cp, start);
+	if (css == NULL)
+		return NULL;
+	post = (css->flags&POSTSTATE) ? cp : NULL;
+
+	/* main loop */
+	chk = SPENDAT(v, cp, realstop);
+	while (cp < realstop) {
+		if (cp >= chk) {	/* see SPENDAT() */
+			if (SPEND(v, 1))
+				return NULL;
+			chk = SPENDAT(v, cp, realstop);
+		}
+		co = FGETCOLOR(cm, *cp);
+		ss = ATOMGET(&css->outs[co]);
+		if (ss == NULL) {
+			ss = miss(v, d, css, co, cp+1, start);
+			if (ss == NULL)
+				break;	/* NOTE BREAK OUT */
+		}
+		cp++;
+		if (ss->flags&POSTSTATE)
+			post = cp;
+		css = ss;
+		if (css->flags&ALWAYS)
+			break;		/* NOTE BREAK OUT */
+	}
+	if (v->dfafull)
+		return NULL;
+	if (css->flags&ALWAYS) {
+		if (hitstopp != NULL && stop == v->stop)
+			*hitstopp = 1;
+		return stop;
+	}
+
+	/* shutdown */
+	if (cp == v->stop && stop == v->stop) {
+		if (hitstopp != NULL)
+			*hitstopp = 1;
+		co = d->cnfa->eos[(v->eflags&REG_NOTEOL) ? 0 : 1];
+		ss = miss(v, d, css, co, cp, start);
+		if (v->dfafull)
+			return NULL;
+		/* special case:  match ended at eol? */
+		if (ss != NULL && (ss->flags&POSTSTATE))
+			return cp;
+	}
+
+	if (post != NULL)		/* found one */
+		return post - 1;
+
+	return NULL;
+}
+
+/*
+ - sshortest - shortest() for a shared DFA
+ * As for slongest(), the last no-progress point is tracked here.
+ ^ static chr *sshortest(struct vars *, struct dfa *, chr *, chr *, chr *,
+ ^ 	chr **, int *);
+ */
+static chr *			/* endpoint, or NULL */
+sshortest(v, d, start, min, max, coldp, hitstopp)
+struct vars *v;
+struct dfa *d;
+chr *start;			/* where the match should start */
+chr *min;			/* match must end at or after here */
+chr *max;			/* match must end at or before here */
+chr **coldp;			/* store coldstart pointer here, if nonNULL */
+int *hitstopp;			/* record whether hit v->stop, if non-NULL */
+{
+	chr *cp;
+	chr *realmin = (min == v->stop) ? min : min + 1;
+	chr *realmax = (max == v->stop) ? max : max + 1;
+	color co;
+	struct sset *css;
+	struct sset *ss;
+	chr *nopr;
+	chr *next;		/* no prefix starts before here */
+	chr *chk;		/* where to pay for the chrs so far */
+	int skip = (d->cnfa == &v->g->search && USESKIP(v));
+	struct colormap *cm = d->cm;
+
+	/* initialize */
+	css = initialize(v, d, start);
+	cp = start;
+	nopr = start;			/* the starter makes no progress */
+	next = start;
+	if (hitstopp != NULL)
+		*hitstopp = 0;
+
+	/* startup */
+	if (cp == v->start)
+		co = d->cnfa->bos[(v->eflags&REG_NOTBOL) ? 0 : 1];
+	else
+		co = FGETCOLOR(cm, *(cp - 1));
+	css = miss(v, d, css, co, cp, start);
+	if (css == NULL)
+		return NULL;
+	if (css->flags&NOPROGRESS)
+		nopr = cp;
+	ss = css;
+
+	/* main loop */
+	chk = SPENDAT(v, cp, realmax);
+	while (cp < realmax) {
+		if (cp >= chk) {	/* see SPENDAT() */
+			if (SPEND(v, 1))
+				return NULL;
+			chk = SPENDAT(v, cp, realmax);
+		}
+		if (skip && (css->flags&NOPROGRESS) && cp >= next) {
+			/* nothing in progress, so on to the next prefix */
+			next = skipscan(v, cp, max);
+			if (next == NULL)
+				return NULL;
+			if (next > cp) {
+				cp = next;
+				co = FGETCOLOR(cm, *(cp - 1));
+				css = miss(v, d, &d->ssets[0], co, cp, start);
+				if (v->dfafull || css == NULL)
+					return NULL;
+				nopr = cp;
+			}
+			next++;
+		}
+		co = FGETCOLOR(cm, *cp);
+		ss = ATOMGET(&css->outs[co]);
+		if (ss == NULL) {
+			ss = miss(v, d, css, co, cp+1, start);
+			if (ss == NULL)
+				break;	/* NOTE BREAK OUT */
+		}
+		cp++;
+		css = ss;
+		if (ss->flags&(POSTSTATE|NOPROGRESS)) {
+			if (ss->flags&NOPROGRESS)
+				nopr = cp;
+			if ((ss->flags&POSTSTATE) && cp >= realmin)
+				break;		/* NOTE BREAK OUT */
+		}
+	}
+	if (v->dfafull || ss == NULL)
+		return NULL;
+
+	if (coldp != NULL)	/* report last no-progress state set, if any */
+		*coldp = nopr;
+
+	if ((ss->flags&POSTSTATE) && cp > min) {
+		assert(cp >= realmin);
+		cp--;
+	} else if (cp == v->stop && max == v->stop) {
+		co = d->cnfa->eos[(v->eflags&REG_NOTEOL) ? 0 : 1];
+		ss = miss(v, d, css, co, cp, start);
+		if (v->dfafull)
+			return NULL;
+		/* match might have ended at eol */
+		if ((ss == NULL || !(ss->flags&POSTSTATE)) && hitstopp != NULL)
+			*hitstopp = 1;
+	}
+
+	if (ss == NULL || !(ss->flags&POSTSTATE))
+		return NULL;
+
+	return cp;
+}
+
+/*
+ - tlongest - longest() for a cnfa with a full DFA table
+ * The table was built and minimized at compile time, so there are no
+ * misses and nothing to write; success is tracked here, as in slongest().
+ ^ static chr *tlongest(struct vars *, struct dfa *, chr *, chr *, int *);
+ */
+static chr *			/* endpoint, or NULL */
+tlongest(v, d, start, stop, hitstopp)
+struct vars *v;
+struct dfa *d;
+chr *start;			/* where the match should start */
+chr *stop;			/* match must end at or before here */
+int *hitstopp;			/* record whether hit v->stop, if non-NULL */
+{
+	chr *cp;
+	chr *realstop = (stop == v->stop) ? stop : stop + 1;
+	int *trans = d->cnfa->dtab->trans;
+	int x;			/* current table entry */
+	color co;
+	chr *post;
+	chr *chk;		/* where to pay for the chrs so far */
+	struct colormap *cm = d->cm;
+
+	cp = start;
+	if (hitstopp != NULL)
+		*hitstopp = 0;
+
+	/* startup */
+	if (cp == v->start)
+		co = d->cnfa->bos[(v->eflags&REG_NOTBOL) ? 0 : 1];
+	else
+		co = FGETCOLOR(cm, *(cp - 1));
+	x = trans[(d->cnfa->dtab->start >> DSHIFT) + co];
+	if (x == DDEAD)
+		return NULL;
+	post = (x&DPOST) ? cp : NULL;
+
+	/* main loop */
+	chk = SPENDAT(v, cp, realstop);
+	while (cp < realstop) {
+		if (cp >= chk) {	/* see SPENDAT() */
+			if (SPEND(v, 1))
+				return NULL;
+			chk = SPENDAT(v, cp, realstop);
+		}
+		x = trans[(x >> DSHIFT) + FGETCOLOR(cm, *cp)];
+		if (x == DDEAD)
+			break;		/* NOTE BREAK OUT */
+		cp++;
+		post = (x&DPOST) ? cp : post;	/* no branch to mispredict */
+		if (x&DALWAYS)
+			break;		/* NOTE BREAK OUT */
+	}
+
+	/* settled:  a match ends at every point from here to stop */
+	if (x&DALWAYS) {
+		if (hitstopp != NULL && stop == v->stop)
+			*hitstopp = 1;
+		return stop;
+	}
+
+	/* shutdown */
+	if (cp == v->stop && stop == v->stop) {
+		if (hitstopp != NULL)
+			*hitstopp = 1;
+		co = d->cnfa->eos[(v->eflags&REG_NOTEOL) ? 0 : 1];
+		/* special case:  match ended at eol? */
+		if (trans[(x >> DSHIFT) + co]&DPOST)
+			return cp;
+	}
+
+	if (post != NULL)		/* found one */
+		return post - 1;
+
+	return NULL;
+}
+
+/*
+ - tshortest - shortest() for a cnfa with a full DFA table
+ ^ static chr *tshortest(struct vars *, struct dfa *, chr *, chr *, chr *,
+ ^ 	chr **, int *);
+ */
+static chr *			/* endpoint, or NULL */
+tshortest(v, d, start, min, max, coldp, hitstopp)
+struct vars *v;
+struct dfa *d;
+chr *start;			/* where the match should start */
+chr *min;			/* match must end at or after here */
+chr *max;			/* match must end at or before here */
+chr **coldp;			/* store coldstart pointer here, if nonNULL */
+int *hitstopp;			/* record whether hit v->stop, if non-NULL */
+{
+	chr *cp;
+	chr *realmin = (min == v->stop) ? min : min + 1;
+	chr *realmax = (max == v->stop) ? max : max + 1;
+	int *trans = d->cnfa->dtab->trans;
+	int x;			/* current table entry */
+	color co;
+	chr *nopr;
+	chr *next;		/* no prefix starts before here */
+	chr *chk;		/* where to pay for the chrs so far */
+	int skip = (d->cnfa == &v->g->search && USESKIP(v));
+	struct colormap *cm = d->cm;
+
+	cp = start;
+	nopr = start;			/* the starter makes no progress */
+	next = start;
+	if (hitstopp != NULL)
+		*hitstopp = 0;
+
+	/* startup */
+	if (cp == v->start)
+		co = d->cnfa->bos[(v->eflags&REG_NOTBOL) ? 0 : 1];
+	else
+		co = FGETCOLOR(cm, *(cp - 1));
+	x = trans[(d->cnfa->dtab->start >> DSHIFT) + co];
+	if (x == DDEAD)
+		return NULL;
+	if (x&DNOPR)
+		nopr = cp;
+
+	/* main loop */
+	chk = SPENDAT(v, cp, realmax);
+	while (cp < realmax) {
+		if (cp >= chk) {	/* see SPENDAT() */
+			if (SPEND(v, 1))
+				return NULL;
+			chk = SPENDAT(v, cp, realmax);
+		}
+		if (skip && (x&DNOPR) && cp >= next) {
+			/* nothing in progress, so on to the next prefix */
+			next = skipscan(v, cp, max);
+			if (next == NULL)
+				return NULL;
+			if (next > cp) {
+				cp = next;
+				co = FGETCOLOR(cm, *(cp - 1));
+				x = trans[(d->cnfa->dtab->start >> DSHIFT) + co];
+				if (x == DDEAD)
+					return NULL;
+				nopr = cp;
+			}
+			next++;
+		}
+		x = trans[(x >> DSHIFT) + FGETCOLOR(cm, *cp)];
+		if (x == DDEAD)
+			return NULL;
+		cp++;
+		nopr = (x&DNOPR) ? cp : nopr;	/* no branch to mispredict */
+		if ((x&DPOST) && cp >= realmin)
+			break;		/* NOTE BREAK OUT */
+	}
+
+	if (coldp != NULL)	/* report last no-progress state set, if any */
+		*coldp = nopr;
+
+	if ((x&DPOST) && cp > min) {
+		assert(cp >= realmin);
+		cp--;
+	} else if (cp == v->stop && max == v->stop) {
+		co = d->cnfa->eos[(v->eflags&REG_NOTEOL) ? 0 : 1];
+		x = trans[(x >> DSHIFT) + co];
+		/* match might have ended at eol */
+		if (!(x&DPOST) && hitstopp != NULL)
+			*hitstopp = 1;
+	}
+
+	if (!(x&DPOST))
+		return NULL;
+
+	return cp;
+}
+
+/*
+ - reach - find how far a match under way at some point could go
+ * The DFA is for the main NFA started in every state but pre and post
+ * (MIDSTART), so it keeps going as long as any match could, whatever it
+ * had been doing before start; where it dies is as far as one can end.
+ ^ static chr *reach(struct vars *, struct dfa *, chr *);
+ */
+static chr *			/* no match under way at start ends past here */
+reach(v, d, start)
+struct vars *v;
+struct dfa *d;
+chr *start;
+{
+	chr *cp;
+	color co;
+	struct sset *css;
+	struct sset *ss;
+	chr *chk;		/* where to pay for the chrs so far */
+	struct colormap *cm = d->cm;
+
+	assert(d->cnfa->flags&MIDSTART);
+	if (d->cnfa->dtab != NULL)
+		return treach(v, d, start);
+
+	v->dfafull = 0;			/* only a shared DFA fills up */
+	css = initialize(v, d, start);
+	cp = start;
+	chk = SPENDAT(v, cp, v->stop);
+	while (cp < v->stop) {
+		if (cp >= chk) {	/* see SPENDAT() */
+			if (SPEND(v, 1))
+				return NULL;
+			chk = SPENDAT(v, cp, v->stop);
+		}
+		co = FGETCOLOR(cm, *cp);
+		ss = ATOMGET(&css->outs[co]);
+		if (ss == NULL) {
+			ss = miss(v, d, css, co, cp+1, start);
+			if (ss == NULL)
+				break;	/* NOTE BREAK OUT */
+		}
+		cp++;
+		if (!d->shared)
+			ss->lastseen = cp;
+		css = ss;
+	}
+
+	if (v->dfafull) {
+		FDEBUG(("shared DFA full, going private\n"));
+		d = newdfa(v, d->cnfa, cm, DOMALLOC);
+		if (d == NULL)
+			return NULL;
+		cp = reach(v, d, start);
+		freedfa(d);
+	}
+	return cp;
+}
+
+/*
+ - treach - reach() for a cnfa with a full DFA table
+ ^ static chr *treach(struct vars *, struct dfa *, chr *);
+ */
+static chr *			/* no match under way at start ends past here */
+treach(v, d, start)
+struct vars *v;
+struct dfa *d;
+chr *start;
+{
+	chr *cp;
+	int *trans = d->cnfa->dtab->trans;
+	int x;			/* current table entry */
+	chr *chk;		/* where to pay for the chrs so far */
+	struct colormap *cm = d->cm;
+
+	x = d->cnfa->dtab->start;
+	chk = SPENDAT(v, start, v->stop);
+	for (cp = start; cp < v->stop; cp++) {
+		if (cp >= chk) {	/* see SPENDAT() */
+			if (SPEND(v, 1))
+				return NULL;
+			chk = SPENDAT(v, cp, v->stop);
+		}
+		x = trans[(x >> DSHIFT) + FGETCOLOR(cm, *cp)];
+		if (x == DDEAD)
+			break;		/* NOTE BREAK OUT */
+	}
+	return cp;
+}
+
+/*
+ - backward - find the leftmost start of a match ending by some point
+ * The DFA is for the reverse search NFA, walked from stop back toward
+ * min; every time it reaches the (reversed) goal state, some match of the
+ * main NFA, ending somewhere at or before stop, could have started there.
+ * The cache's replacement machinery wants positions that grow as we go,
+ * so it is shown the distance walked instead.
+ ^ static chr *backward(struct vars *, struct dfa *, chr *, chr *);
+ */
+static chr *			/* leftmost start, or NULL */
+backward(v, d, min, stop)
+struct vars *v;
+struct dfa *d;
+chr *min;			/* match must start at or after here */
+chr *stop;			/* and end at or before here */
+{
+	chr *cp;
+	chr *realmin = (min == v->start) ? min : min - 1;
+	color co;
+	struct sset *css;
+	struct sset *ss;
+	chr *found;
+	chr *chk;		/* where to pay for the chrs so far */
+	struct colormap *cm = d->cm;
+#	define	WALKED(p)	(realmin + (stop - (p)))
+
+	if (d->cnfa->dtab != NULL)
+		return tbackward(v, d, min, stop);
+
+	v->dfafull = 0;			/* only a shared DFA fills up */
+	css = initialize(v, d, realmin);
+	cp = stop;
+	found = NULL;
+
+	/* startup */
+	if (cp == v->stop)
+		co = d->cnfa->eos[(v->eflags&REG_NOTEOL) ? 0 : 1];
+	else
+		co = FGETCOLOR(cm, *cp);
+	css = miss(v, d, css, co, WALKED(cp), realmin);
+	if (css == NULL || v->dfafull)
+		cp = realmin;		/* skip the rest */
+	else if (!d->shared)
+		css->lastseen = WALKED(cp);
+
+	/* main loop */
+	chk = SPENDBACK(v, cp, realmin);
+	while (cp > realmin) {
+		if (cp <= chk) {	/* see SPENDAT() */
+			if (SPEND(v, 1))
+				return NULL;
+			chk = SPENDBACK(v, cp, realmin);
+		}
+		co = FGETCOLOR(cm, *(cp - 1));
+		ss = ATOMGET(&css->outs[co]);
+		if (ss == NULL) {
+			ss = miss(v, d, css, co, WALKED(cp - 1), realmin);
+			if (ss == NULL)
+				break;	/* NOTE BREAK OUT */
+		}
+		cp--;
+		if (!d->shared)
+			ss->lastseen = WALKED(cp);
+		if (ss->flags&POSTSTATE)
+			found = cp + 1;
+		css = ss;
+	}
+
+	/* shutdown:  could it have started at the beginning? */
+	if (cp == v->start && min == v->start && css != NULL &&
+							!v->dfafull) {
+		co = d->cnfa->bos[(v->eflags&REG_NOTBOL) ? 0 : 1];
+		ss = miss(v, d, css, co, WALKED(cp), realmin);
+		if (ss != NULL && (ss->flags&POSTSTATE))
+			found = cp;
+		else if (ss != NULL && !d->shared)
+			ss->lastseen = WALKED(cp);	/* to be tidy */
+	}
+#	undef	WALKED
 
-	if (coldp != NULL)	/* report last no-progress state set, if any */
-		*coldp = lastcold(v, d);
+	if (v->dfafull) {
+		FDEBUG(("shared DFA full, going private\n"));
+		d = newdfa(v, d->cnfa, cm, DOMALLOC);
+		if (d == NULL)
+			return NULL;
+		found = backward(v, d, min, stop);
+		freedfa(d);
+	}
+	return found;
+}
 
-	if ((ss->flags&POSTSTATE) && cp > min) {
-		assert(cp >= realmin);
-		cp--;
-	} else if (cp == v->stop && max == v->stop) {
+/*
+ - tbackward - backward() for a cnfa with a full DFA table
+ ^ static chr *tbackward(struct vars *, struct dfa *, chr *, chr *);
+ */
+static chr *			/* leftmost start, or NULL */
+tbackward(v, d, min, stop)
+struct vars *v;
+struct dfa *d;
+chr *min;			/* match must start at or after here */
+chr *stop;			/* and end at or before here */
+{
+	chr *cp;
+	chr *realmin = (min == v->start) ? min : min - 1;
+	int *trans = d->cnfa->dtab->trans;
+	int x;			/* current table entry */
+	color co;
+	chr *found;
+	chr *chk;		/* where to pay for the chrs so far */
+	struct colormap *cm = d->cm;
+
+	cp = stop;
+	found = NULL;
+
+	/* startup */
+	if (cp == v->stop)
 		co = d->cnfa->eos[(v->eflags&REG_NOTEOL) ? 0 : 1];
-		FDEBUG(("color %ld\n", (long)co));
-		ss = miss(v, d, css, co, cp, start);
-		/* match might have ended at eol */
-		if ((ss == NULL || !(ss->flags&POSTSTATE)) && hitstopp != NULL)
-			*hitstopp = 1;
+	else
+		co = FGETCOLOR(cm, *cp);
+	x = trans[(d->cnfa->dtab->start >> DSHIFT) + co];
+	if (x == DDEAD)
+		return NULL;
+
+	/* main loop */
+	chk = SPENDBACK(v, cp, realmin);
+	while (cp > realmin) {
+		if (cp <= chk) {	/* see SPENDAT() */
+			if (SPEND(v, 1))
+				return NULL;
+			chk = SPENDBACK(v, cp, realmin);
+		}
+		x = trans[(x >> DSHIFT) + FGETCOLOR(cm, *(cp - 1))];
+		if (x == DDEAD)
+			return found;
+		cp--;
+		found = (x&DPOST) ? cp + 1 : found;	/* no branch */
 	}
 
-	if (ss == NULL || !(ss->flags&POSTSTATE))
-		return NULL;
+	/* shutdown:  could it have started at the beginning? */
+	if (cp == v->start && min == v->start) {
+		co = d->cnfa->bos[(v->eflags&REG_NOTBOL) ? 0 : 1];
+		if (trans[(x >> DSHIFT) + co]&DPOST)
+			found = cp;
+	}
 
-	return cp;
+	return found;
 }
 
 /*
@@ -247,13 +994,156 @@ struct dfa *d;
 
 	nopr = d->lastnopr;
 	if (nopr == NULL)
-		nopr = v->start;
+		nopr = v->from;
 	for (ss = d->ssets, i = d->nssused; i > 0; ss++, i--)
 		if ((ss->flags&NOPROGRESS) && nopr < ss->lastseen)
 			nopr = ss->lastseen;
 	return nopr;
 }
 
+/*
+ - resume - carry a stream's search on through the text it has been fed
+ * Where shortest() starts afresh each time, this picks up with the state
+ * set it stopped in, which is all that the text behind it left behind.
+ * It goes until the search has seen a match end and then run out of
+ * things in progress, so that a match lies in [cold, close) and nothing
+ * past close can change which match or how long; or until the text
+ * runs out.  Only at the real end of the stream is eos fed in.
+ ^ static int resume(struct vars *, struct stream *);
+ */
+static int			/* 1 if a match is in hand, 0 if text ran out */
+resume(v, s)
+struct vars *v;
+struct stream *s;
+{
+	struct dfa *d = s->d;
+	struct colormap *cm = d->cm;
+	struct sset *css = s->css;
+	struct sset *ss;
+	struct sset *starter;
+	chr *cp = v->start + s->scanned;
+	chr *start = cp;
+	chr *next = cp;		/* no prefix starts before here */
+	chr *lim;		/* skip no further than here */
+	int skip = USESKIP(v);
+	chr *chk;		/* where to pay for the chrs so far */
+	int closed = 0;
+	color co;
+	int i;
+	int n;
+
+	if (css == NULL) {		/* fresh start here */
+		css = initialize(v, d, cp);
+		if (cp == v->start)
+			co = d->cnfa->bos[(v->eflags&REG_NOTBOL) ? 0 : 1];
+		else
+			co = FGETCOLOR(cm, *(cp - 1));
+		css = miss(v, d, css, co, cp, start);
+		if (css == NULL) {
+			s->done = 1;	/* nothing can match from here on */
+			return 0;
+		}
+		s->cold = s->scanned;
+	} else {
+		/* the text has moved since, so the sets' sightings mean nothing */
+		for (i = 0; i < d->nssused; i++) {
+			d->ssets[i].lastseen = NULL;
+			d->ssets[i].swept = NULL;
+		}
+		d->lastpost = NULL;
+		d->lastnopr = NULL;
+	}
+	css->lastseen = cp;
+	starter = &d->ssets[0];
+	assert(starter->flags&STARTER);
+
+	/* past lim, the longest prefix might run on into the next chunk */
+	lim = NULL;
+	if (skip && v->g->npfx > 0 && !s->last) {
+		n = 0;
+		for (i = 0; i < v->g->npfx; i++)
+			if (v->g->pfxlen[i] > n)
+				n = v->g->pfxlen[i];
+		lim = (v->stop - cp > n - 1) ? v->stop - (n - 1) : cp;
+	}
+
+	chk = SPENDAT(v, cp, v->stop);
+	while (cp < v->stop) {
+		if (cp >= chk) {	/* see SPENDAT() */
+			if (SPEND(v, 1)) {
+				s->done = 1;
+				return 0;
+			}
+			chk = SPENDAT(v, cp, v->stop);
+		}
+		if (skip && !s->found && (css->flags&NOPROGRESS) && cp >= next) {
+			/* nothing in progress, so on to next possible start */
+			next = skipscan(v, cp, v->stop);
+			if (next == NULL && ISERR()) {
+				s->done = 1;
+				return 0;
+			}
+			if (next == NULL)
+				next = v->stop;
+			if (lim != NULL && next > lim)
+				next = lim;	/* a prefix might straddle the chunks */
+			if (next > cp) {
+				cp = next;
+				co = FGETCOLOR(cm, *(cp - 1));
+				css = miss(v, d, starter, co, cp, start);
+				if (css == NULL) {
+					s->done = 1;
+					return 0;
+				}
+				css->lastseen = cp;
+				s->cold = cp - v->start;
+				if (cp == v->stop)
+					break;	/* NOTE BREAK OUT */
+			}
+			next++;
+		}
+		co = FGETCOLOR(cm, *cp);
+		ss = css->outs[co];
+		if (ss == NULL) {
+			ss = miss(v, d, css, co, cp+1, start);
+			if (ss == NULL && s->found && !ISERR()) {
+				cp++;		/* nothing at all left in progress */
+				closed = 1;
+				break;		/* NOTE BREAK OUT */
+			}
+			if (ss == NULL) {
+				s->done = 1;
+				return 0;
+			}
+		}
+		cp++;
+		ss->lastseen = cp;
+		css = ss;
+		if (css->flags&NOPROGRESS) {
+			if (s->found) {
+				closed = 1;
+				break;		/* NOTE BREAK OUT */
+			}
+			s->cold = cp - v->start;
+		} else if (css->flags&POSTSTATE)
+			s->found = 1;
+	}
+
+	s->scanned = cp - v->start;
+	s->css = css;
+	if (!closed && s->last && !s->found) {
+		co = d->cnfa->eos[(v->eflags&REG_NOTEOL) ? 0 : 1];
+		ss = miss(v, d, css, co, cp, start);
+		if (ss != NULL && (ss->flags&POSTSTATE))
+			s->found = 1;
+	}
+	if (closed || (s->last && s->found)) {	/* the match is in hand */
+		s->close = s->scanned;
+		return 1;
+	}
+	return 0;
+}
+
 /*
  - newdfa - set up a fresh DFA
  ^ static struct dfa *newdfa(struct vars *, struct cnfa *,
@@ -270,10 +1160,23 @@ struct smalldfa *small;		/* preallocated space, may be NULL */
 	size_t nss = cnfa->nstates * 2;
 	int wordsper = (cnfa->nstates + UBITS - 1) / UBITS;
 	struct smalldfa *smallwas = small;
+	int hbits;
+	int i;
 
 	assert(cnfa != NULL && cnfa->nstates != 0);
 
-	if (nss <= FEWSTATES && cnfa->ncolors <= FEWCOLORS) {
+	if (v->cbudget != 0) {		/* size to fit the budget instead */
+		nss = v->cbudget / (sizeof(struct sset) + 2*sizeof(int) +
+				wordsper*sizeof(unsigned) + cnfa->ncolors *
+				(sizeof(struct sset *) + sizeof(struct arcp)));
+		if (nss < MINSSETS)
+			nss = MINSSETS;
+		if (nss > MAXSSETS)
+			nss = MAXSSETS;
+	}
+
+	if (nss <= FEWSTATES && cnfa->nstates <= FEWSTATES &&
+					cnfa->ncolors <= FEWCOLORS) {
 		assert(wordsper == 1);
 		if (small == NULL) {
 			small = (struct smalldfa *)MALLOC(
@@ -285,6 +1188,9 @@ struct smalldfa *small;		/* preallocated space, may be NULL */
 		}
 		d = &small->dfa;
 		d->ssets = small->ssets;
+		d->hashtab = small->hashtab;
+		hbits = 6;
+		assert(FEWHASH == 1 << hbits && nss*2 <= FEWHASH);
 		d->statesarea = small->statesarea;
 		d->work = &d->statesarea[nss];
 		d->outsarea = small->outsarea;
@@ -298,6 +1204,9 @@ struct smalldfa *small;		/* preallocated space, may be NULL */
 			return NULL;
 		}
 		d->ssets = (struct sset *)MALLOC(nss * sizeof(struct sset));
+		for (hbits = 1; ((size_t)1 << hbits) < nss*2; hbits++)
+			continue;
+		d->hashtab = (int *)MALLOC(((size_t)1 << hbits) * sizeof(int));
 		d->statesarea = (unsigned *)MALLOC((nss+WORK) * wordsper *
 							sizeof(unsigned));
 		d->work = &d->statesarea[nss * wordsper];
@@ -307,8 +1216,10 @@ struct smalldfa *small;		/* preallocated space, may be NULL */
 							sizeof(struct arcp));
 		d->cptsmalloced = 1;
 		d->mallocarea = (char *)d;
-		if (d->ssets == NULL || d->statesarea == NULL ||
-				d->outsarea == NULL || d->incarea == NULL) {
+		d->lacarcs = NULL;
+		if (d->ssets == NULL || d->hashtab == NULL ||
+				d->statesarea == NULL || d->outsarea == NULL ||
+				d->incarea == NULL) {
 			freedfa(d);
 			ERR(REG_ESPACE);
 			return NULL;
@@ -325,6 +1236,28 @@ struct smalldfa *small;		/* preallocated space, may be NULL */
 	d->lastpost = NULL;
 	d->lastnopr = NULL;
 	d->search = d->ssets;
+	d->lacarcs = NULL;
+	d->lacgen = 0;
+	if (cnfa->flags&HASLACONS) {
+		d->lacarcs = (struct lacarc *)MALLOC(NLACARCS *
+							sizeof(struct lacarc));
+		if (d->lacarcs == NULL) {
+			freedfa(d);
+			ERR(REG_ESPACE);
+			return NULL;
+		}
+		for (i = 0; i < NLACARCS; i++)
+			d->lacarcs[i].from = NULL;
+	}
+	d->budget = v->cbudget;
+	d->policy = v->cpolicy;
+	d->nvacant = 0;
+	d->shared = 0;
+	d->thrashed = 0;
+	d->hashmask = (1 << hbits) - 1;
+	d->hashshift = UBITS - hbits;
+	for (i = 0; i <= d->hashmask; i++)
+		d->hashtab[i] = -1;
 
 	/* initialization of sset fields is done as needed */
 
@@ -342,6 +1275,8 @@ struct dfa *d;
 	if (d->cptsmalloced) {
 		if (d->ssets != NULL)
 			FREE(d->ssets);
+		if (d->hashtab != NULL)
+			FREE(d->hashtab);
 		if (d->statesarea != NULL)
 			FREE(d->statesarea);
 		if (d->outsarea != NULL)
@@ -349,14 +1284,93 @@ struct dfa *d;
 		if (d->incarea != NULL)
 			FREE(d->incarea);
 	}
+	if (d->lacarcs != NULL)
+		FREE(d->lacarcs);
 
 	if (d->mallocarea != NULL)
 		FREE(d->mallocarea);
 }
 
+/*
+ - getdfa - get a DFA for one of the regex's cnfas, reusing a cached one
+ * A cached DFA is taken out of its slot while in use, so a concurrent
+ * exec on the same regex just builds a fresh one of its own.  Under
+ * REG_SHARED it stays put instead, and all comers use it at once; if it
+ * has filled up, or was sized for other tuning, we go private.
+ ^ static struct dfa *getdfa(struct vars *, int, struct cnfa *,
+ ^ 	struct smalldfa *);
+ */
+static struct dfa *
+getdfa(v, slot, cnfa, small)
+struct vars *v;
+int slot;			/* which dfas[] slot belongs to cnfa */
+struct cnfa *cnfa;
+struct smalldfa *small;		/* preallocated space, may be NULL */
+{
+	struct guts *g = v->g;
+	struct dfa *d;
+
+	if (v->eflags&REG_SMALL)	/* odd-sized cache, don't mix */
+		return newdfa(v, cnfa, &g->cmap, small);
+
+	assert(slot >= 0 && slot < g->ndfas);
+	d = ATOMGET(&g->dfas[slot]);
+	if (g->cflags&REG_SHARED) {
+		if (d == NULL) {
+			d = newdfa(v, cnfa, &g->cmap, DOMALLOC);
+			if (d == NULL)
+				return NULL;
+			(VOID) initialize(v, d, v->start);  /* the starter */
+			d->shared = 1;
+			ATOMPUT(&g->dfafree, freedfa);
+			if (!CASPTR(&g->dfas[slot], (struct dfa *)NULL, d)) {
+				freedfa(d);	/* somebody beat us to it */
+				d = ATOMGET(&g->dfas[slot]);
+			}
+		}
+		assert(d->shared && d->cnfa == cnfa);
+		if (d->budget == v->cbudget && d->policy == v->cpolicy &&
+					ATOMGET(&d->nssused) < d->nssets)
+			return d;
+		return newdfa(v, cnfa, &g->cmap, small);
+	}
+	if (d != NULL && CASPTR(&g->dfas[slot], d, (struct dfa *)NULL)) {
+		assert(d->cnfa == cnfa);
+		if (d->budget == v->cbudget && d->policy == v->cpolicy) {
+			d->thrashed = 0;
+			return d;
+		}
+		freedfa(d);		/* tuned differently, start over */
+	}
+	return newdfa(v, cnfa, &g->cmap, DOMALLOC);
+}
+
+/*
+ - putdfa - done with a DFA from getdfa, keep it for next time if possible
+ ^ static VOID putdfa(struct vars *, int, struct dfa *);
+ */
+static VOID
+putdfa(v, slot, d)
+struct vars *v;
+int slot;
+struct dfa *d;
+{
+	struct guts *g = v->g;
+
+	if (d->shared)
+		return;			/* it stays where it is */
+	if (!(v->eflags&REG_SMALL) && d->mallocarea != NULL) {
+		ATOMPUT(&g->dfafree, freedfa);
+		if (CASPTR(&g->dfas[slot], (struct dfa *)NULL, d))
+			return;
+	}
+	freedfa(d);
+}
+
 /*
  - hash - construct a hash code for a bitvector
- * There are probably better ways, but they're more expensive.
+ * The rotation keeps equal bits in different words from cancelling out;
+ * HASHSLOT() does the real mixing.
  ^ static unsigned hash(unsigned *, int);
  */
 static unsigned
@@ -369,10 +1383,143 @@ int n;
 
 	h = 0;
 	for (i = 0; i < n; i++)
-		h ^= uv[i];
+		h = ((h << 7) | (h >> (UBITS - 7))) ^ uv[i];
 	return h;
 }
 
+/*
+ - findss - look up a state set in the cache index
+ ^ static struct sset *findss(struct dfa *, unsigned, unsigned *);
+ */
+static struct sset *		/* NULL if not cached */
+findss(d, h, bv)
+struct dfa *d;
+unsigned h;			/* HASH() of bv */
+unsigned *bv;
+{
+	int i;
+	int e;
+	struct sset *p;
+
+	for (i = HASHSLOT(d, h); (e = ATOMGET(&d->hashtab[i])) >= 0;
+						i = (i+1) & d->hashmask) {
+		p = &d->ssets[e];
+		if (HIT(h, bv, p, d->wordsper))
+			return p;
+	}
+	return NULL;
+}
+
+/*
+ - addss - enter a freshly filled-in state set in the cache index
+ ^ static VOID addss(struct dfa *, struct sset *);
+ */
+static VOID
+addss(d, ss)
+struct dfa *d;
+struct sset *ss;
+{
+	int i;
+
+	for (i = HASHSLOT(d, ss->hash); d->hashtab[i] >= 0;
+						i = (i+1) & d->hashmask)
+		assert(&d->ssets[d->hashtab[i]] != ss);
+	d->hashtab[i] = ss - d->ssets;
+}
+
+/*
+ - delss - remove a state set from the cache index
+ * Linear probing lets us close the gap by shifting later entries back,
+ * rather than leaving tombstones to clog up the probe sequences.
+ ^ static VOID delss(struct dfa *, struct sset *);
+ */
+static VOID
+delss(d, ss)
+struct dfa *d;
+struct sset *ss;
+{
+	int i;
+	int j;
+	int home;
+	int n = ss - d->ssets;
+
+	for (i = HASHSLOT(d, ss->hash); d->hashtab[i] != n;
+						i = (i+1) & d->hashmask)
+		assert(d->hashtab[i] >= 0);
+
+	for (j = (i+1) & d->hashmask; d->hashtab[j] >= 0;
+						j = (j+1) & d->hashmask) {
+		home = HASHSLOT(d, d->ssets[d->hashtab[j]].hash);
+		if ((i < j) ? (i < home && home <= j) : (i < home || home <= j))
+			continue;	/* already as close to home as it gets */
+		d->hashtab[i] = d->hashtab[j];
+		i = j;
+	}
+	d->hashtab[i] = -1;
+}
+
+/*
+ - claimss - find a state set in a shared DFA's cache, adding it if need be
+ * A new entry is claimed by bumping nssused atomically, filled in, and
+ * then published in the index by compare-and-swap, so other threads see
+ * it only when it's complete.  If another thread publishes the same set
+ * first, we use theirs and our entry is just wasted.  Nothing is ever
+ * evicted from a shared DFA; when it's full, we set v->dfafull instead.
+ ^ static struct sset *claimss(struct vars *, struct dfa *, unsigned *,
+ ^ 	unsigned, int);
+ */
+static struct sset *		/* NULL if no room */
+claimss(v, d, bv, h, flags)
+struct vars *v;
+struct dfa *d;
+unsigned *bv;			/* the set's bitvector */
+unsigned h;			/* HASH() of bv */
+int flags;			/* its flags */
+{
+	int n;
+	int i;
+	int e;
+	struct sset *p;
+
+	p = findss(d, h, bv);
+	if (p != NULL)
+		return p;
+
+	if (ATOMGET(&d->nssused) >= d->nssets ||
+				(n = ATOMADD(&d->nssused, 1)) >= d->nssets) {
+		v->dfafull = 1;
+		return NULL;
+	}
+	p = &d->ssets[n];
+	p->states = &d->statesarea[n * d->wordsper];
+	for (i = 0; i < d->wordsper; i++)
+		p->states[i] = bv[i];
+	p->hash = h;
+	p->flags = flags;
+	p->ins.ss = NULL;
+	p->lastseen = NULL;
+	p->swept = NULL;
+	p->outs = &d->outsarea[n * d->ncolors];
+	p->inchain = &d->incarea[n * d->ncolors];
+	for (i = 0; i < d->ncolors; i++) {
+		p->outs[i] = NULL;
+		p->inchain[i].ss = NULL;
+	}
+
+	for (i = HASHSLOT(d, h); ; i = (i+1) & d->hashmask) {
+		e = ATOMGET(&d->hashtab[i]);
+		if (e < 0) {
+			if (CASINT(&d->hashtab[i], -1, n)) {
+				FDEBUG(("new shared c%d\n", n));
+				return p;
+			}
+			e = ATOMGET(&d->hashtab[i]);	/* lost a race */
+		}
+		if (HIT(h, bv, &d->ssets[e], d->wordsper))
+			return &d->ssets[e];
+	}
+}
+
 /*
  - initialize - hand-craft a cache entry for startup, otherwise get ready
  ^ static struct sset *initialize(struct vars *, struct dfa *, chr *);
@@ -386,6 +1533,11 @@ chr *start;
 	struct sset *ss;
 	int i;
 
+	if (d->shared) {		/* starter is there, and hands off */
+		assert(d->ssets[0].flags&STARTER);
+		return &d->ssets[0];
+	}
+
 	/* is previous one still there? */
 	if (d->nssused > 0 && (d->ssets[0].flags&STARTER))
 		ss = &d->ssets[0];
@@ -393,15 +1545,24 @@ chr *start;
 		ss = getvacant(v, d, start, start);
 		for (i = 0; i < d->wordsper; i++)
 			ss->states[i] = 0;
-		BSET(ss->states, d->cnfa->pre);
+		if (d->cnfa->flags&MIDSTART) {
+			for (i = 0; i < d->nstates; i++)
+				if (i != d->cnfa->pre && i != d->cnfa->post)
+					BSET(ss->states, i);
+		} else
+			BSET(ss->states, d->cnfa->pre);
 		ss->hash = HASH(ss->states, d->wordsper);
 		assert(d->cnfa->pre != d->cnfa->post);
 		ss->flags = STARTER|LOCKED|NOPROGRESS;
+		ss->swept = NULL;
+		addss(d, ss);
 		/* lastseen dealt with below */
 	}
 
-	for (i = 0; i < d->nssused; i++)
+	for (i = 0; i < d->nssused; i++) {
 		d->ssets[i].lastseen = NULL;
+		d->ssets[i].swept = NULL;
+	}
 	ss->lastseen = start;		/* maybe untrue, but harmless */
 	d->lastpost = NULL;
 	d->lastnopr = NULL;
@@ -429,20 +1590,62 @@ chr *start;			/* where the attempt got started */
 	struct sset *p;
 	int ispost;
 	int noprogress;
+	int always;
 	int gotstate;
 	int dolacons;
 	int sawlacons;
+	int n;
+	int ok;
+	unsigned tested;
+	unsigned passed;
+	struct lacarc *la;
+	unsigned *work = d->work;
+	unsigned wbuf[FEWWORDS];
 
 	/* for convenience, we can be called even if it might not be a miss */
-	if (css->outs[co] != NULL) {
+	p = ATOMGET(&css->outs[co]);	/* might be another thread's */
+	if (p != NULL) {
 		FDEBUG(("hit\n"));
-		return css->outs[co];
+		return p;
 	}
 	FDEBUG(("miss\n"));
 
+	/* did we go this way before, with the same lookahead outcomes? */
+	la = NULL;
+	if (d->lacarcs != NULL && !d->shared) {
+		la = &d->lacarcs[LACSLOT(d, css, co)];
+		if (la->from == css && la->co == co && la->gen == d->lacgen) {
+			for (n = 0; n < UBITS; n++)
+				if ((la->tested & (1U << n)) &&
+						lacon(v, cnfa, cp,
+							cnfa->ncolors + n) !=
+						((la->passed & (1U << n)) != 0))
+					break;	/* NOTE BREAK OUT */
+			if (n == UBITS && !ISERR()) {
+				FDEBUG(("lacon hit c%d\n", la->to - d->ssets));
+				return la->to;
+			}
+		}
+	}
+
+	if (SPEND(v, 1))	/* building a state set is the real work */
+		return NULL;
+
+	/* a shared DFA's work area is no good, need our own */
+	if (d->shared) {
+		if (d->wordsper <= FEWWORDS)
+			work = wbuf;
+		else
+			work = (unsigned *)MALLOC(d->wordsper * sizeof(unsigned));
+		if (work == NULL) {
+			ERR(REG_ESPACE);
+			return NULL;
+		}
+	}
+
 	/* first, what set of states would we end up in? */
 	for (i = 0; i < d->wordsper; i++)
-		d->work[i] = 0;
+		work[i] = 0;
 	ispost = 0;
 	noprogress = 1;
 	gotstate = 0;
@@ -450,7 +1653,7 @@ chr *start;			/* where the attempt got started */
 		if (ISBSET(css->states, i))
 			for (ca = cnfa->states[i]+1; ca->co != COLORLESS; ca++)
 				if (ca->co == co) {
-					BSET(d->work, ca->to);
+					BSET(work, ca->to);
 					gotstate = 1;
 					if (ca->to == cnfa->post)
 						ispost = 1;
@@ -460,20 +1663,29 @@ chr *start;			/* where the attempt got started */
 				}
 	dolacons = (gotstate) ? (cnfa->flags&HASLACONS) : 0;
 	sawlacons = 0;
+	tested = 0;
+	passed = 0;
 	while (dolacons) {		/* transitive closure */
 		dolacons = 0;
 		for (i = 0; i < d->nstates; i++)
-			if (ISBSET(d->work, i))
+			if (ISBSET(work, i))
 				for (ca = cnfa->states[i]+1; ca->co != COLORLESS;
 									ca++) {
 					if (ca->co <= cnfa->ncolors)
 						continue; /* NOTE CONTINUE */
 					sawlacons = 1;
-					if (ISBSET(d->work, ca->to))
+					if (ISBSET(work, ca->to))
 						continue; /* NOTE CONTINUE */
-					if (!lacon(v, cnfa, cp, ca->co))
+					n = ca->co - cnfa->ncolors;
+					ok = lacon(v, cnfa, cp, ca->co);
+					if (n < UBITS) {
+						tested |= 1U << n;
+						passed |= (unsigned)ok << n;
+					} else
+						la = NULL;	/* can't say */
+					if (!ok)
 						continue; /* NOTE CONTINUE */
-					BSET(d->work, ca->to);
+					BSET(work, ca->to);
 					dolacons = 1;
 					if (ca->to == cnfa->post)
 						ispost = 1;
@@ -482,25 +1694,61 @@ chr *start;			/* where the attempt got started */
 					FDEBUG(("%d :> %d\n", i, ca->to));
 				}
 	}
-	if (!gotstate)
+	if (gotstate && (cnfa->flags&HASDEAD) &&
+					!(v->g->cflags&REG_EXPECT)) {
+		/* a set that can't reach post is as good as none */
+		for (i = 0; i < d->nstates; i++)
+			if (ISBSET(work, i) && !(cnfa->states[i]->to&CDEAD))
+				break;	/* NOTE BREAK OUT */
+		if (i == d->nstates) {
+			FDEBUG(("dead set\n"));
+			gotstate = 0;
+		}
+	}
+	if (!gotstate) {
+		if (work != d->work && work != wbuf)
+			FREE(work);
 		return NULL;
-	h = HASH(d->work, d->wordsper);
+	}
+	always = 0;
+	if (ispost && (cnfa->flags&HASALWAYS))
+		for (i = 0; i < d->nstates && !always; i++)
+			if (ISBSET(work, i) && (cnfa->states[i]->to&CALWAYS))
+				always = 1;
+	h = HASH(work, d->wordsper);
 
-	/* next, is that in the cache? */
-	for (p = d->ssets, i = d->nssused; i > 0; p++, i--)
-		if (HIT(h, d->work, p, d->wordsper)) {
-			FDEBUG(("cached c%d\n", p - d->ssets));
-			break;			/* NOTE BREAK OUT */
+	/* shared DFA:  no inarc chains, since nothing will be evicted */
+	if (d->shared) {
+		p = claimss(v, d, work, h, ((ispost) ? POSTSTATE : 0) |
+					((noprogress) ? NOPROGRESS : 0) |
+					((always) ? ALWAYS : 0));
+		if (work != wbuf)
+			FREE(work);
+		if (p != NULL && !sawlacons) {
+			FDEBUG(("c%d[%d]->c%d\n", css - d->ssets, co,
+							p - d->ssets));
+			ATOMPUT(&css->outs[co], p);
 		}
-	if (i == 0) {		/* nope, need a new cache entry */
+		return p;
+	}
+
+	/* next, is that in the cache? */
+	p = findss(d, h, work);
+	if (p != NULL) {
+		FDEBUG(("cached c%d\n", p - d->ssets));
+	} else {		/* nope, need a new cache entry */
 		p = getvacant(v, d, cp, start);
 		assert(p != css);
 		for (i = 0; i < d->wordsper; i++)
-			p->states[i] = d->work[i];
+			p->states[i] = work[i];
 		p->hash = h;
 		p->flags = (ispost) ? POSTSTATE : 0;
 		if (noprogress)
 			p->flags |= NOPROGRESS;
+		if (always)
+			p->flags |= ALWAYS;
+		p->swept = NULL;
+		addss(d, p);
 		/* lastseen to be dealt with by caller */
 	}
 
@@ -510,12 +1758,25 @@ chr *start;			/* where the attempt got started */
 		css->inchain[co] = p->ins;
 		p->ins.ss = css;
 		p->ins.co = (color)co;
+	} else if (la != NULL && !ISERR()) {
+		/* ...but can be remembered along with what they were */
+		la = &d->lacarcs[LACSLOT(d, css, co)];
+		la->from = css;
+		la->co = (color)co;
+		la->tested = tested;
+		la->passed = passed;
+		la->to = p;
+		la->gen = d->lacgen;
 	}
 	return p;
 }
 
 /*
  - lacon - lookahead-constraint checker for miss()
+ * Outcomes are remembered by position, since the search DFA and the
+ * retries all ask about the same places.  The constraint's DFA is held
+ * for the rest of the exec (or, past NLADFAS, fetched from its slot for
+ * each check), warm cache and all.
  ^ static int lacon(struct vars *, struct cnfa *, chr *, pcolor);
  */
 static int			/* predicate:  constraint satisfied? */
@@ -529,21 +1790,42 @@ pcolor co;			/* "color" of the lookahead constraint */
 	struct subre *sub;
 	struct dfa *d;
 	struct smalldfa sd;
+	struct lamemo *m;
 	chr *end;
+	int full;
 
 	n = co - pcnfa->ncolors;
 	assert(n < v->g->nlacons && v->g->lacons != NULL);
+	m = &v->lamemo[LAHASH(OFF(cp), n)];
+	if (m->cp == cp && m->n == n) {
+		FDEBUG(("=== lacon %d remembered %d\n", n, m->ok));
+		return m->ok;
+	}
 	FDEBUG(("=== testing lacon %d\n", n));
 	sub = &v->g->lacons[n];
-	d = newdfa(v, &sub->cnfa, &v->g->cmap, &sd);
+	if (n < NLADFAS && v->ladfas[n] != NULL)
+		d = v->ladfas[n];
+	else if (n < NLADFAS)
+		d = v->ladfas[n] = getdfa(v, DFALACON(v->g, n), &sub->cnfa,
+								DOMALLOC);
+	else
+		d = getdfa(v, DFALACON(v->g, n), &sub->cnfa, &sd);
 	if (d == NULL) {
 		ERR(REG_ESPACE);
 		return 0;
 	}
+	full = v->dfafull;		/* longest() tramples it */
 	end = longest(v, d, cp, v->stop, (int *)NULL);
-	freedfa(d);
+	v->dfafull = full;
+	if (n >= NLADFAS)
+		putdfa(v, DFALACON(v->g, n), d);
 	FDEBUG(("=== lacon %d match %d\n", n, (end != NULL)));
-	return (sub->subno) ? (end != NULL) : (end == NULL);
+	if (ISERR())
+		return 0;
+	m->cp = cp;
+	m->n = n;
+	m->ok = (sub->subno) ? (end != NULL) : (end == NULL);
+	return m->ok;
 }
 
 /*
@@ -566,8 +1848,11 @@ chr *start;
 	struct arcp lastap;
 	color co;
 
+	i = d->nssused;
 	ss = pickss(v, d, cp, start);
 	assert(!(ss->flags&LOCKED));
+	if (d->nssused == i)
+		d->lacgen++;		/* a reuse, lacarcs may be stale */
 
 	/* clear out its inarcs, including self-referential ones */
 	ap = ss->ins;
@@ -617,6 +1902,8 @@ chr *start;
 
 /*
  - pickss - pick the next stateset to be used
+ * How a full cache makes room depends on the DFA's policy.  The set we
+ * are coming from (the one last entered, just before cp) must survive.
  ^ static struct sset *pickss(struct vars *, struct dfa *, chr *, chr *);
  */
 static struct sset *
@@ -651,6 +1938,28 @@ chr *start;
 		return ss;
 	}
 
+	switch (d->policy) {
+	case REG_CCLOCK:
+		return clockss(v, d, cp);
+	case REG_CFLUSH:
+		if (d->nvacant == 0)
+			flushss(v, d, cp);
+		for (i = d->nssets, ss = d->search; i > 0; i--, ss++) {
+			if (ss >= &d->ssets[d->nssets])
+				ss = d->ssets;
+			if (ss->flags&VACANT) {
+				d->search = ss + 1;
+				d->nvacant--;
+				FDEBUG(("reusing c%d\n", ss - d->ssets));
+				return ss;
+			}
+		}
+		break;
+	default:
+		assert(d->policy == REG_CSCAN);
+		break;
+	}
+
 	/* look for oldest, or old enough anyway */
 	if (cp - start > d->nssets*2/3)		/* oldest 33% are expendable */
 		ancient = cp - d->nssets*2/3;
@@ -661,6 +1970,8 @@ chr *start;
 							!(ss->flags&LOCKED)) {
 			d->search = ss + 1;
 			FDEBUG(("replacing c%d\n", ss - d->ssets));
+			delss(d, ss);
+			v->nevictions++;
 			return ss;
 		}
 	for (ss = d->ssets, end = d->search; ss < end; ss++)
@@ -668,6 +1979,8 @@ chr *start;
 							!(ss->flags&LOCKED)) {
 			d->search = ss + 1;
 			FDEBUG(("replacing c%d\n", ss - d->ssets));
+			delss(d, ss);
+			v->nevictions++;
 			return ss;
 		}
 
@@ -677,3 +1990,90 @@ chr *start;
 	ERR(REG_ASSERT);
 	return d->ssets;
 }
+
+/*
+ - clockss - pick a stateset to replace, clock style, for REG_CCLOCK
+ * A set entered since the hand last went by gets a second chance; the
+ * hand notes its lastseen in swept, and moves on.
+ ^ static struct sset *clockss(struct vars *, struct dfa *, chr *);
+ */
+static struct sset *
+clockss(v, d, cp)
+struct vars *v;
+struct dfa *d;
+chr *cp;
+{
+	int i;
+	struct sset *ss;
+
+	for (i = 2*d->nssets, ss = d->search; i > 0; i--, ss++) {
+		if (ss >= &d->ssets[d->nssets])
+			ss = d->ssets;
+		if ((ss->flags&LOCKED) || SSINUSE(ss, cp))
+			continue;		/* NOTE CONTINUE */
+		if (ss->lastseen != NULL && ss->lastseen != ss->swept) {
+			ss->swept = ss->lastseen;
+			continue;		/* NOTE CONTINUE */
+		}
+		d->search = ss + 1;
+		FDEBUG(("replacing c%d\n", ss - d->ssets));
+		delss(d, ss);
+		v->nevictions++;
+		return ss;
+	}
+
+	/* two turns of the clock and nothing?!? */
+	FDEBUG(("can't find victim to replace!\n"));
+	assert(NOTREACHED);
+	ERR(REG_ASSERT);
+	return d->ssets;
+}
+
+/*
+ - flushss - throw out all statesets not in use, for REG_CFLUSH
+ * Everything but the starter and the set we are coming from becomes
+ * VACANT, and the survivors lose their arcs; cheaper than taking the
+ * sets apart one at a time.
+ ^ static VOID flushss(struct vars *, struct dfa *, chr *);
+ */
+static VOID
+flushss(v, d, cp)
+struct vars *v;
+struct dfa *d;
+chr *cp;
+{
+	int i;
+	int j;
+	struct sset *ss;
+
+	FDEBUG(("flushing cache\n"));
+	for (i = 0; i <= d->hashmask; i++)
+		d->hashtab[i] = -1;
+	for (i = d->nssused, ss = d->ssets; i > 0; i--, ss++) {
+		ss->ins.ss = NULL;
+		for (j = 0; j < d->ncolors; j++) {
+			ss->outs[j] = NULL;
+			ss->inchain[j].ss = NULL;
+		}
+		if (ss->flags&VACANT)
+			continue;		/* NOTE CONTINUE */
+		if ((ss->flags&LOCKED) || SSINUSE(ss, cp)) {
+			addss(d, ss);
+			continue;		/* NOTE CONTINUE */
+		}
+
+		/* as in getvacant(), success and no-progress locations */
+		if ((ss->flags&POSTSTATE) && ss->lastseen != d->lastpost &&
+			(d->lastpost == NULL || d->lastpost < ss->lastseen))
+			d->lastpost = ss->lastseen;
+		if ((ss->flags&NOPROGRESS) && ss->lastseen != d->lastnopr &&
+			(d->lastnopr == NULL || d->lastnopr < ss->lastseen))
+			d->lastnopr = ss->lastseen;
+
+		ss->flags = VACANT;
+		ss->lastseen = NULL;
+		d->nvacant++;
+		v->nevictions++;
+	}
+	v->nflushes++;
+}
@@ -0,0 +1,243 @@
+/* ---:mferris: This file contains NO external definitions. */
+
+/*
+ * Required-literal scanning.
+ * This file is #included by regexec.c.
+ *
+ * See regc_lit.c for where the literals come from.  Exec uses the
+ * required literal to reject strings without ever starting the search DFA,
+ * which for typical inputs (mostly lines that don't match) is nearly all
+ * of them, and the prefixes (or, lacking those, the colors a match can
+ * start with) to let the search DFA skip dull stretches.
+ */
+
+#if defined(__SSE2__) && CHRBITS == 16 && !defined(REG_NOSIMD)
+#define	REG_SSE2
+#include <emmintrin.h>
+#endif
+
+/*
+ * The scans go a window at a time, paying at the end of each (see
+ * SPENDAT()).  A window is looked through for anything starting before
+ * its end, so it has to reach MAXLIT chrs further to see all of those.
+ */
+#define	WINDOW(lim, stop)	(((stop) - (lim) > MAXLIT) ? \
+					(lim) + MAXLIT : (stop))
+
+
+
+/*
+ - litscan - find the first place where the required literal occurs
+ ^ static chr *litscan(struct vars *, chr *, chr *);
+ */
+static chr *			/* start of the literal, or NULL */
+litscan(v, start, stop)
+struct vars *v;
+chr *start;
+chr *stop;			/* literal must end at or before here */
+{
+	chr *cp;
+	chr *lim;
+
+	assert(v->g->nlit > 0);
+	for (;;) {
+		lim = SPENDAT(v, start, stop);
+		cp = strscan(start, WINDOW(lim, stop), v->g->lit, v->g->nlit,
+								v->g->litrare);
+		if (lim == stop || (cp != NULL && cp < lim))
+			return cp;
+		if (SPEND(v, 1))
+			return NULL;
+		start = lim;
+	}
+}
+
+/*
+ - skipscan - find the next place where a match might start
+ * That's where one of the prefixes occurs, if there are any; otherwise
+ * it's wherever a chr turns up whose color can start a match.
+ ^ static chr *skipscan(struct vars *, chr *, chr *);
+ */
+static chr *			/* NULL if nowhere */
+skipscan(v, start, stop)
+struct vars *v;
+chr *start;
+chr *stop;			/* match must end at or before here */
+{
+	struct guts *g = v->g;
+	struct colormap *cm = &g->cmap;
+	chr *cp;
+	chr *lim;
+
+	assert(g->npfx > 0 || g->startco != NULL);
+	for (;;) {
+		lim = SPENDAT(v, start, stop);
+		if (g->npfx > 0)
+			cp = pfxscan(v, start, WINDOW(lim, stop));
+		else {
+			for (cp = start; cp < lim; cp++)
+				if (g->startco[FGETCOLOR(cm, *cp)])
+					break;	/* NOTE BREAK OUT */
+			if (cp == lim)
+				cp = NULL;
+		}
+		if (lim == stop || (cp != NULL && cp < lim))
+			return cp;
+		if (SPEND(v, 1))
+			return NULL;
+		start = lim;
+	}
+}
+
+/*
+ - pfxscan - find the first place where one of the prefixes occurs
+ * A lone prefix is scanned for like the required literal.  Otherwise we
+ * look for any of the prefixes' first chrs, eight chrs at a time with SSE2
+ * if there aren't too many of them, and check the prefixes there.
+ ^ static chr *pfxscan(struct vars *, chr *, chr *);
+ */
+static chr *			/* start of the prefix, or NULL */
+pfxscan(v, start, stop)
+struct vars *v;
+chr *start;
+chr *stop;			/* prefix must end at or before here */
+{
+	struct guts *g = v->g;
+	chr *cp = start;
+#ifdef REG_SSE2
+	__m128i firsts[8];
+	__m128i x;
+	__m128i m;
+	int bits;
+	int i;
+#endif
+
+	assert(g->npfx > 0);
+	if (g->npfx == 1)
+		return strscan(start, stop, g->pfx[0], g->pfxlen[0],
+								g->pfxrare);
+
+#ifdef REG_SSE2
+	if (g->nfirst <= 8) {
+		for (i = 0; i < g->nfirst; i++)
+			firsts[i] = _mm_set1_epi16((short)g->pfxfirst[i]);
+		for (; stop - cp >= 8; cp += 8) {
+			x = _mm_loadu_si128((__m128i *)cp);
+			m = _mm_cmpeq_epi16(x, firsts[0]);
+			for (i = 1; i < g->nfirst; i++)
+				m = _mm_or_si128(m, _mm_cmpeq_epi16(x, firsts[i]));
+			bits = _mm_movemask_epi8(m);
+			if (bits == 0)
+				continue;	/* NOTE CONTINUE */
+			for (i = 0; i < 8; i++)
+				if ((bits & (1 << (2*i))) && pfxat(v, cp + i, stop))
+					return cp + i;
+		}
+	}
+#endif
+
+	for (; cp < stop; cp++)
+		if (g->pfxmap[*cp & BYTMASK] && pfxat(v, cp, stop))
+			return cp;
+	return NULL;
+}
+
+/*
+ - pfxat - does one of the prefixes occur here?
+ ^ static int pfxat(struct vars *, chr *, chr *);
+ */
+static int			/* predicate */
+pfxat(v, cp, stop)
+struct vars *v;
+chr *cp;
+chr *stop;			/* prefix must end at or before here */
+{
+	struct guts *g = v->g;
+	int i;
+
+	for (i = 0; i < g->npfx; i++)
+		if (g->pfx[i][0] == *cp && g->pfxlen[i] <= stop - cp &&
+				memcmp(VS(cp), VS(g->pfx[i]),
+					g->pfxlen[i]*sizeof(chr)) == 0)
+			return 1;
+	return 0;
+}
+
+/*
+ - strscan - find the first place where a string occurs
+ * The scan is for the string's least common chr, with the rest checked
+ * only where that turns up.
+ ^ static chr *strscan(chr *, chr *, chr *, int, int);
+ */
+static chr *			/* start of the string, or NULL */
+strscan(start, stop, str, n, r)
+chr *start;
+chr *stop;			/* string must end at or before here */
+chr *str;
+int n;				/* length of str */
+int r;				/* index of its least common chr */
+{
+	chr *cp;
+	chr *end;
+
+	assert(n > 0);
+	if (stop - start < n)
+		return NULL;
+	cp = start + r;
+	end = stop - (n - r - 1);	/* where the rare chr may lie */
+	for (;;) {
+		cp = chrscan(cp, end, str[r]);
+		if (cp == NULL)
+			return NULL;
+		if (memcmp(VS(cp - r), VS(str), n*sizeof(chr)) == 0)
+			return cp - r;
+		cp++;
+	}
+}
+
+/*
+ - chrscan - find the first instance of a chr in a range
+ * For 16-bit chrs this does a word at a time:  XORing with the chr
+ * repeated across a word leaves a zero chr wherever it matched, and
+ * the usual borrow trick detects a zero chr anywhere in the word.
+ ^ static chr *chrscan(chr *, chr *, pchr);
+ */
+static chr *			/* NULL if not there */
+chrscan(cp, stop, c)
+chr *cp;
+chr *stop;
+pchr c;
+{
+#if CHRBITS == 16
+#	define	WCHRS	(sizeof(unsigned long) / sizeof(chr))
+	unsigned long ones = ~0UL / CHR_MAX;	/* 1 in each chr */
+	unsigned long highs = ones << (CHRBITS - 1);
+	unsigned long pat = ones * (uchr)c;
+	unsigned long w;
+	unsigned long w2;
+
+	/* up to a word boundary the slow way */
+	while (cp < stop && ((unsigned long)cp % sizeof(unsigned long)) != 0) {
+		if (*cp == (chr)c)
+			return cp;
+		cp++;
+	}
+
+	/* then two words at a time, until one holds c */
+	while ((size_t)(stop - cp) >= 2*WCHRS) {
+		memcpy(VS(&w), VS(cp), sizeof(w));
+		memcpy(VS(&w2), VS(cp + WCHRS), sizeof(w2));
+		w ^= pat;
+		w2 ^= pat;
+		if ((((w - ones) & ~w) | ((w2 - ones) & ~w2)) & highs)
+			break;		/* NOTE BREAK OUT */
+		cp += 2*WCHRS;
+	}
+#	undef	WCHRS
+#endif
+
+	for (; cp < stop; cp++)
+		if (*cp == (chr)c)
+			return cp;
+	return NULL;
+}
@@ -0,0 +1,266 @@
+/* ---:mferris: This file contains NO external definitions. */
+
+/*
+ * NFA simulation, for when the DFA cache is thrashing.
+ * This file is #included by regexec.c.
+ *
+ * Some REs have far more state sets than any reasonable cache holds, and
+ * on the wrong text nearly every chr builds a new one, throwing out one
+ * that will be wanted again shortly.  The cache is then pure overhead on
+ * top of the one honest piece of work in miss(), which is computing the
+ * next set of states.  These routines just do that, a chr at a time, in
+ * the DFA's work area, with no hashing and nothing to evict; the time
+ * per chr is bounded by the size of the NFA, whatever the text.  They
+ * answer exactly what longest() and shortest() would.
+ */
+
+
+
+/*
+ - nlongest - longest() by NFA simulation
+ ^ static chr *nlongest(struct vars *, struct dfa *, chr *, chr *, int *);
+ */
+static chr *			/* endpoint, or NULL */
+nlongest(v, d, start, stop, hitstopp)
+struct vars *v;
+struct dfa *d;
+chr *start;			/* where the match should start */
+chr *stop;			/* match must end at or before here */
+int *hitstopp;			/* record whether hit v->stop, if non-NULL */
+{
+	chr *cp;
+	chr *realstop = (stop == v->stop) ? stop : stop + 1;
+	color co;
+	unsigned *cur = d->work;
+	unsigned *nxt = d->work + d->wordsper;
+	unsigned *t;
+	int flags;
+	chr *post;
+	struct colormap *cm = d->cm;
+
+	FDEBUG(("+++ nfa startup +++\n"));
+	nstart(d, cur);
+	cp = start;
+	if (hitstopp != NULL)
+		*hitstopp = 0;
+
+	/* startup */
+	if (cp == v->start)
+		co = d->cnfa->bos[(v->eflags&REG_NOTBOL) ? 0 : 1];
+	else
+		co = FGETCOLOR(cm, *(cp - 1));
+	flags = nstep(v, d, cur, nxt, co, cp);
+	if (flags < 0)
+		return NULL;
+	post = (flags&POSTSTATE) ? cp : NULL;
+	t = cur, cur = nxt, nxt = t;
+
+	/* main loop */
+	while (cp < realstop) {
+		co = FGETCOLOR(cm, *cp);
+		flags = nstep(v, d, cur, nxt, co, cp+1);
+		if (flags < 0)
+			break;		/* NOTE BREAK OUT */
+		cp++;
+		if (flags&POSTSTATE)
+			post = cp;
+		t = cur, cur = nxt, nxt = t;
+	}
+
+	/* shutdown */
+	if (cp == v->stop && stop == v->stop) {
+		if (hitstopp != NULL)
+			*hitstopp = 1;
+		co = d->cnfa->eos[(v->eflags&REG_NOTEOL) ? 0 : 1];
+		flags = nstep(v, d, cur, nxt, co, cp);
+		/* special case:  match ended at eol? */
+		if (flags >= 0 && (flags&POSTSTATE))
+			return cp;
+	}
+
+	if (post != NULL)
+		return post - 1;
+	return NULL;
+}
+
+/*
+ - nshortest - shortest() by NFA simulation
+ * There's no skipping ahead to prefixes here; a text that thrashes the
+ * cache is rarely one where the prefix is scarce.
+ ^ static chr *nshortest(struct vars *, struct dfa *, chr *, chr *, chr *,
+ ^ 	chr **, int *);
+ */
+static chr *			/* endpoint, or NULL */
+nshortest(v, d, start, min, max, coldp, hitstopp)
+struct vars *v;
+struct dfa *d;
+chr *start;			/* where the match should start */
+chr *min;			/* match must end at or after here */
+chr *max;			/* match must end at or before here */
+chr **coldp;			/* store coldstart pointer here, if nonNULL */
+int *hitstopp;			/* record whether hit v->stop, if non-NULL */
+{
+	chr *cp;
+	chr *realmin = (min == v->stop) ? min : min + 1;
+	chr *realmax = (max == v->stop) ? max : max + 1;
+	color co;
+	unsigned *cur = d->work;
+	unsigned *nxt = d->work + d->wordsper;
+	unsigned *t;
+	int flags;
+	chr *nopr;		/* last place nothing was in progress */
+	struct colormap *cm = d->cm;
+
+	FDEBUG(("--- nfa startup ---\n"));
+	nstart(d, cur);
+	nopr = start;
+	cp = start;
+	if (hitstopp != NULL)
+		*hitstopp = 0;
+
+	/* startup */
+	if (cp == v->start)
+		co = d->cnfa->bos[(v->eflags&REG_NOTBOL) ? 0 : 1];
+	else
+		co = FGETCOLOR(cm, *(cp - 1));
+	flags = nstep(v, d, cur, nxt, co, cp);
+	if (flags < 0)
+		return NULL;
+	t = cur, cur = nxt, nxt = t;
+
+	/* main loop */
+	while (cp < realmax) {
+		co = FGETCOLOR(cm, *cp);
+		flags = nstep(v, d, cur, nxt, co, cp+1);
+		if (flags < 0)
+			return NULL;
+		cp++;
+		if (flags&NOPROGRESS)
+			nopr = cp;
+		t = cur, cur = nxt, nxt = t;
+		if ((flags&POSTSTATE) && cp >= realmin)
+			break;		/* NOTE BREAK OUT */
+	}
+
+	if (coldp != NULL)	/* report last no-progress state set */
+		*coldp = nopr;
+
+	if ((flags&POSTSTATE) && cp > min) {
+		assert(cp >= realmin);
+		cp--;
+	} else if (cp == v->stop && max == v->stop) {
+		co = d->cnfa->eos[(v->eflags&REG_NOTEOL) ? 0 : 1];
+		flags = nstep(v, d, cur, nxt, co, cp);
+		/* match might have ended at eol */
+		if ((flags < 0 || !(flags&POSTSTATE)) && hitstopp != NULL)
+			*hitstopp = 1;
+	}
+
+	if (flags < 0 || !(flags&POSTSTATE))
+		return NULL;
+	return cp;
+}
+
+/*
+ - nstart - set up the starting set of states
+ ^ static VOID nstart(struct dfa *, unsigned *);
+ */
+static VOID
+nstart(d, states)
+struct dfa *d;
+unsigned *states;
+{
+	int i;
+
+	for (i = 0; i < d->wordsper; i++)
+		states[i] = 0;
+	if (d->cnfa->flags&MIDSTART) {
+		for (i = 0; i < d->nstates; i++)
+			if (i != d->cnfa->pre && i != d->cnfa->post)
+				BSET(states, i);
+	} else
+		BSET(states, d->cnfa->pre);
+}
+
+/*
+ - nstep - compute the states reached from a set of states on one color
+ * This is the first half of miss(), lookahead constraints and all.
+ ^ static int nstep(struct vars *, struct dfa *, unsigned *, unsigned *,
+ ^ 	pcolor, chr *);
+ */
+static int			/* POSTSTATE|NOPROGRESS flags, -1 if none */
+nstep(v, d, from, to, co, cp)
+struct vars *v;
+struct dfa *d;
+unsigned *from;
+unsigned *to;
+pcolor co;
+chr *cp;			/* next chr */
+{
+	struct cnfa *cnfa = d->cnfa;
+	struct carc *ca;
+	int ispost;
+	int noprogress;
+	int gotstate;
+	int dolacons;
+	int i;
+	int w;
+	unsigned bits;
+
+	if (SPEND(v, 1))
+		return -1;
+	for (w = 0; w < d->wordsper; w++)
+		to[w] = 0;
+	ispost = 0;
+	noprogress = 1;
+	gotstate = 0;
+	for (w = 0; w < d->wordsper; w++) {
+		if (from[w] == 0)
+			continue;	/* NOTE CONTINUE */
+		for (i = w*UBITS, bits = from[w]; bits != 0; i++, bits >>= 1) {
+			if (!(bits&1))
+				continue;	/* NOTE CONTINUE */
+			for (ca = cnfa->states[i]+1; ca->co != COLORLESS; ca++)
+				if (ca->co == co) {
+					BSET(to, ca->to);
+					gotstate = 1;
+					if (ca->to == cnfa->post)
+						ispost = 1;
+					if (!cnfa->states[ca->to]->co)
+						noprogress = 0;
+				}
+		}
+	}
+	dolacons = (gotstate) ? (cnfa->flags&HASLACONS) : 0;
+	while (dolacons) {		/* transitive closure */
+		dolacons = 0;
+		for (i = 0; i < d->nstates; i++)
+			if (ISBSET(to, i))
+				for (ca = cnfa->states[i]+1; ca->co != COLORLESS;
+									ca++) {
+					if (ca->co <= cnfa->ncolors)
+						continue; /* NOTE CONTINUE */
+					if (ISBSET(to, ca->to))
+						continue; /* NOTE CONTINUE */
+					if (!lacon(v, cnfa, cp, ca->co))
+						continue; /* NOTE CONTINUE */
+					BSET(to, ca->to);
+					dolacons = 1;
+					if (ca->to == cnfa->post)
+						ispost = 1;
+					if (!cnfa->states[ca->to]->co)
+						noprogress = 0;
+				}
+	}
+	if (gotstate && (cnfa->flags&HASDEAD) &&
+					!(v->g->cflags&REG_EXPECT)) {
+		for (i = 0; i < d->nstates; i++)
+			if (ISBSET(to, i) && !(cnfa->states[i]->to&CDEAD))
+				break;	/* NOTE BREAK OUT */
+		if (i == d->nstates)
+			gotstate = 0;	/* as miss() has it */
+	}
+	if (!gotstate)
+		return -1;
+	return ((ispost) ? POSTSTATE : 0) | ((noprogress) ? NOPROGRESS : 0);
+}
@@ -0,0 +1,102 @@
+/* ---:mferris: This file contains NO external definitions. */
+
+/*
+ * One-pass matching.
+ * This file is #included by regexec.c.
+ *
+ * See regc_one.c for which REs get a one-pass program and what it says.
+ * Exec walks the program along a match that find() has pinned down,
+ * noting capture boundaries as it goes, in place of dissect().  If the
+ * RE is anchored, the walk from the start of the string finds the match
+ * as well, and takes the place of the whole search.
+ */
+
+
+
+/*
+ - onewalk - find subexpressions, and maybe the match, with the program
+ * Given the end, the walk just goes there.  Without it, each time the
+ * match could end, what's been noted so far is copied out, so the last
+ * such time gives the longest match, as find() would; if the RE prefers
+ * shorter, the first time does.  A subexpression whose end was passed
+ * but not its start was bypassed, and didn't match.
+ ^ static int onewalk(struct vars *, chr *, chr *);
+ */
+static int
+onewalk(v, begin, end)
+struct vars *v;
+chr *begin;			/* where the match starts */
+chr *end;			/* where it ends, or NULL to find out */
+{
+	struct onepass *op = v->g->one;
+	struct colormap *cm = &v->g->cmap;
+	struct oarc *oa;
+	chr *cp;
+	chr *chk;		/* where to pay for the chrs so far */
+	int ss;
+	int e = (v->eflags&REG_NOTEOL) ? 0 : 1;
+	int shorter = (v->g->tree->flags&SHORTER) ? 1 : 0;
+	int matched = 0;
+	int n;
+	int i;
+	regoff_t off;
+	regoff_t so[OMAXSUB+1];
+	regoff_t eo[OMAXSUB+1];
+
+	assert(op != NULL && v->nmatch > 1);
+	n = (v->nmatch < v->g->nsub + 1) ? (int)v->nmatch : (int)v->g->nsub + 1;
+	for (i = 1; i < n; i++)
+		so[i] = eo[i] = -1;
+	MDEBUG(("\none-pass at %ld\n", LOFF(begin)));
+
+	if (begin == v->start)
+		ss = op->start[(v->eflags&REG_NOTBOL) ? 0 : 1];
+	else
+		ss = op->start[OSTARTMID];
+	cp = begin;
+	chk = SPENDAT(v, cp, v->stop);
+	for (;;) {
+		off = OFF(cp);
+		oa = &op->ends[ss*3 + ((cp == v->stop) ? OEND(e) : OMID)];
+		if ((end == NULL || cp == end) && oa->to != ONONE) {
+			MDEBUG(("one-pass match ends at %ld\n", (long)off));
+			zapsubs(v->pmatch, v->nmatch);
+			v->pmatch[0].rm_so = OFF(begin);
+			v->pmatch[0].rm_eo = off;
+			for (i = 1; i < n; i++) {
+				if (oa->tags&OTAG(i, 0))
+					v->pmatch[i].rm_so = off;
+				else if (so[i] == -1)
+					continue;	/* NOTE CONTINUE */
+				else
+					v->pmatch[i].rm_so = so[i];
+				v->pmatch[i].rm_eo = (oa->tags&OTAG(i, 1)) ?
+								off : eo[i];
+			}
+			matched = 1;
+			if (shorter)
+				break;		/* NOTE BREAK OUT */
+		}
+		if (cp == v->stop || cp == end)
+			break;		/* NOTE BREAK OUT */
+		if (cp >= chk) {	/* see SPENDAT() */
+			if (SPEND(v, 1))
+				return v->err;
+			chk = SPENDAT(v, cp, v->stop);
+		}
+		oa = &op->arcs[ss*op->ncolors + GETCOLOR(cm, *cp)];
+		if (oa->to == ONONE)
+			break;		/* NOTE BREAK OUT */
+		if (oa->tags != 0)
+			for (i = 1; i < n; i++) {
+				if (oa->tags&OTAG(i, 0))
+					so[i] = off;
+				if (oa->tags&OTAG(i, 1))
+					eo[i] = off;
+			}
+		ss = oa->to;
+		cp++;
+	}
+
+	return (matched) ? REG_OKAY : REG_NOMATCH;
+}
@@ -0,0 +1,222 @@
+/* ---:mferris: This file contains NO external definitions. */
+
+/*
+ * Searches split among threads (REG_PARALLEL).
+ * This file is #included by regexec.c.
+ *
+ * The string is cut into pieces, and each piece gets an ordinary find()
+ * of its own, starting at the piece with the chr before it as context.
+ * That finds the leftmost match starting in or after the piece, which is
+ * the answer if no earlier piece has a match starting in it.  A piece's
+ * search need look no further than farthest() says a match under way at
+ * the end of the piece could go, so most pieces are read little past
+ * their ends.  A piece whose search has to run to the end of the string
+ * anyway decides the rest of it by itself.  Threads take the pieces in
+ * order, and once some piece settles the answer, the ones after it are
+ * given up.
+ */
+
+/*
+ - parfind - dofind() with the string cut into pieces for threads
+ ^ static int parfind(struct vars *, size_t, regmatch_t []);
+ */
+static int
+parfind(v, nmatch, pmatch)
+struct vars *v;
+size_t nmatch;
+regmatch_t pmatch[];
+{
+	struct par par;
+	struct par *p = &par;
+	struct worker *workers;
+	rm_par_t *rp = &v->details->rm_par;
+	size_t n = v->stop - v->from;
+	size_t len;
+	int nthreads;
+	int started;
+	int st;
+	int i;
+	int k;
+
+	nthreads = (rp->rp_threads > 0) ? rp->rp_threads : NCPUS();
+	len = rp->rp_piece;
+	if (len == 0 && nthreads > 1) {
+		len = n / ((size_t)nthreads * PARSPLIT);
+		if (len < PARPIECE)
+			len = PARPIECE;
+	}
+	if (len == 0 || n / len >= PARMOST)
+		len = n / PARMOST + 1;
+	if (nthreads < 2 || n <= len)
+		return dofind(v, nmatch, pmatch);	/* not worth it */
+
+	/* setup */
+	p->v = v;
+	p->nmatch = nmatch;
+	p->len = len;
+	p->npieces = (int)((n + len - 1) / len);
+	p->next = 0;
+	p->settled = p->npieces;
+	if (nthreads > p->npieces)
+		nthreads = p->npieces;
+	p->pieces = (struct piece *)MALLOC(p->npieces * sizeof(struct piece));
+	p->pmatch = NULL;
+	if (nmatch > 0)
+		p->pmatch = (regmatch_t *)MALLOC(p->npieces * nmatch *
+							sizeof(regmatch_t));
+	workers = (struct worker *)MALLOC(nthreads * sizeof(struct worker));
+	if (p->pieces == NULL || (nmatch > 0 && p->pmatch == NULL) ||
+							workers == NULL) {
+		if (p->pieces != NULL)
+			FREE(p->pieces);
+		if (p->pmatch != NULL)
+			FREE(p->pmatch);
+		if (workers != NULL)
+			FREE(workers);
+		return REG_ESPACE;
+	}
+	for (k = 0; k < p->npieces; k++) {
+		p->pieces[k].st = -1;
+		p->pieces[k].quit = 0;
+		p->pieces[k].nflushes = 0;
+		p->pieces[k].nevictions = 0;
+	}
+	for (i = 0; i < nthreads; i++)
+		workers[i].par = p;
+
+	/* do it, with this thread as one of the workers */
+	MDEBUG(("\n%d pieces of %ld, %d threads\n", p->npieces, (long)len,
+								nthreads));
+	for (started = 1; started < nthreads; started++)
+		if (THREADSTART(&workers[started].tid, parwork,
+						VS(&workers[started])) != 0)
+			break;		/* NOTE BREAK OUT */
+	(DISCARD)parwork(VS(&workers[0]));
+	for (i = 1; i < started; i++)
+		(DISCARD)THREADJOIN(workers[i].tid);
+
+	/* the first piece that decides it */
+	st = REG_NOMATCH;
+	v->npieces = 0;
+	for (k = 0; k < p->npieces; k++) {
+		if (p->pieces[k].st < 0)
+			continue;	/* NOTE CONTINUE */
+		v->npieces++;
+		v->nflushes += p->pieces[k].nflushes;
+		v->nevictions += p->pieces[k].nevictions;
+		if (k <= p->settled && p->pieces[k].st != REG_NOMATCH &&
+							st == REG_NOMATCH) {
+			st = p->pieces[k].st;
+			if (st == REG_OKAY && nmatch > 0)
+				memcpy(VS(pmatch), VS(&p->pmatch[k * nmatch]),
+						nmatch * sizeof(regmatch_t));
+		}
+	}
+
+	FREE(workers);
+	if (p->pmatch != NULL)
+		FREE(p->pmatch);
+	FREE(p->pieces);
+	return st;
+}
+
+/*
+ - parwork - a worker thread, doing pieces until none are left that matter
+ ^ static PVOID parwork(PVOID);
+ */
+static PVOID
+parwork(arg)
+PVOID arg;
+{
+	struct worker *wk = (struct worker *)arg;
+	struct par *p = wk->par;
+	int k;
+
+	for (;;) {
+		k = ATOMADD(&p->next, 1);
+		if (k >= p->npieces || k > ATOMGET(&p->settled))
+			break;		/* NOTE BREAK OUT */
+		parpiece(p, &wk->var, k);
+	}
+	return NULL;
+}
+
+/*
+ - parpiece - find the leftmost match starting in one piece, if any
+ * A match found that starts in a later piece is left for that piece.
+ ^ static VOID parpiece(struct par *, struct vars *, int);
+ */
+static VOID
+parpiece(p, v, k)
+struct par *p;
+struct vars *v;			/* scratch, the worker's own */
+int k;
+{
+	struct piece *pc = &p->pieces[k];
+	chr *begin = p->v->from + k * p->len;
+	chr *end = (k == p->npieces - 1) ? p->v->stop : begin + p->len;
+	regmatch_t *pm = NULL;
+	int st = REG_OKAY;
+	chr *look;			/* how far to look for the bound */
+	int rest;			/* does it decide the rest of the string? */
+
+	*v = *p->v;			/* a fresh start */
+	v->from = begin;
+	v->details = NULL;
+	v->cancel = &pc->quit;	/* seen within SPENDCHRS chrs, see SPEND() */
+	if (end < v->stop) {
+		/* looking far ahead would cost as much as searching there */
+		look = v->stop;
+		if (v->g->maxlen < 0 && (size_t)(v->stop - end) > p->len)
+			look = end + p->len;
+		v->stop = look;
+		v->bound = farthest(v, end);
+		v->stop = p->v->stop;
+		if (v->bound == NULL)
+			st = (ISERR()) ? v->err : REG_ESPACE;
+		else if (v->bound >= look)
+			v->bound = NULL;	/* no telling, take it all */
+	}
+	rest = (st == REG_OKAY && v->bound == NULL);
+	if (rest)
+		parsettle(p, k);	/* the pieces after it have nothing to add */
+	if (p->nmatch > 0)
+		pm = &p->pmatch[k * p->nmatch];
+	if (st == REG_OKAY) {
+		MDEBUG(("\npiece %d, %ld to %ld, ends by %ld\n", k, LOFF(begin),
+			LOFF(end), LOFF((v->bound != NULL) ? v->bound : v->stop)));
+		st = dofind(v, p->nmatch, pm);
+	}
+	if (st == REG_OKAY && !rest && pm != NULL && pm[0].rm_so >= OFF(end))
+		st = REG_NOMATCH;	/* it's a later piece's */
+
+	pc->nflushes = v->nflushes;
+	pc->nevictions = v->nevictions;
+	v->nflushes = 0;		/* parfind() counts them */
+	v->nevictions = 0;
+	finish(v);
+	pc->st = st;
+	if (st != REG_NOMATCH && !rest)
+		parsettle(p, k);
+}
+
+/*
+ - parsettle - note that a piece decides the search, give up later ones
+ ^ static VOID parsettle(struct par *, int);
+ */
+static VOID
+parsettle(p, k)
+struct par *p;
+int k;
+{
+	int s;
+	int i;
+
+	do {
+		s = ATOMGET(&p->settled);
+		if (s <= k)
+			return;		/* an earlier piece already does */
+	} while (!CASINT(&p->settled, s, k));
+	for (i = k + 1; i < p->npieces; i++)
+		ATOMPUT(&p->pieces[i].quit, 1);
+}
@@ -0,0 +1,238 @@
+/* ---:mferris: This file contains NO external definitions. */
+
+/*
+ * Sets of REs, matched all at once (see regsetcomp() and regsetexec()).
+ * This file is #included by regexec.c.
+ *
+ * A set's search NFA has an accept state for each RE, entered just as
+ * post is, on the chr after a match of that RE ends (or on the end of
+ * the string), so one pass of its DFA over the string shows every RE
+ * that matches.  Only a state set that includes post can hold accept
+ * states, and each one is looked at only the first time the scan comes
+ * to it, so the pass costs little more than a search for any one RE.
+ */
+
+/*
+ - setscan - scan the string with a set's search DFA, noting what matches
+ * Stops as soon as the answer is settled, or nothing more can match.
+ ^ static VOID setscan(struct vars *, struct dfa *, char *, size_t);
+ */
+static VOID
+setscan(v, d, found, nhits)
+struct vars *v;
+struct dfa *d;
+char *found;			/* [RE] 1 matches, -1 doesn't, 0 not known */
+size_t nhits;			/* how many of the lowest matches wanted */
+{
+	chr *cp;
+	color co;
+	struct sset *css;
+	struct sset *ss;
+	chr *chk;		/* where to pay for the chrs so far */
+	int i;
+	long ev0;		/* evictions before we started */
+	struct colormap *cm = d->cm;
+
+	if (SPEND(v, 1))
+		return;
+
+	/* initialize; what an earlier exec noted is no use to this one */
+	css = initialize(v, d, v->start);
+	for (ss = d->ssets, i = d->nssused; i > 0; ss++, i--)
+		ss->flags &= ~SETSEEN;
+	ev0 = v->nevictions;
+	cp = v->start;
+
+	/* startup */
+	FDEBUG(("+++ set startup +++\n"));
+	co = d->cnfa->bos[(v->eflags&REG_NOTBOL) ? 0 : 1];
+	css = miss(v, d, css, co, cp, v->start);
+	if (css == NULL)
+		return;
+	css->lastseen = cp;
+
+	/* main loop */
+	chk = SPENDAT(v, cp, v->stop);
+	for (;;) {
+		if ((css->flags&(POSTSTATE|SETSEEN)) == POSTSTATE) {
+			css->flags |= SETSEEN;
+			if (setnote(v, css->states, d->wordsper, found, nhits))
+				return;		/* settled, or error */
+		}
+		if (cp == v->stop)
+			break;		/* NOTE BREAK OUT */
+		if (cp >= chk) {	/* see SPENDAT() */
+			if (SPEND(v, 1))
+				return;
+			chk = SPENDAT(v, cp, v->stop);
+		}
+		co = FGETCOLOR(cm, *cp);
+		ss = css->outs[co];
+		if (ss == NULL) {
+			ss = miss(v, d, css, co, cp+1, v->start);
+			if (ss == NULL)
+				return;		/* nothing more can match */
+			if (THRASHING(v, d, ev0, cp - v->start)) {
+				/* cache can't keep up, go on without it */
+				FDEBUG(("DFA thrashing, going to NFA\n"));
+				d->thrashed = 1;
+				memcpy(VS(d->work), VS(ss->states),
+					d->wordsper * sizeof(unsigned));
+				nsetscan(v, d, cp+1, (ss->flags&POSTSTATE),
+								found, nhits);
+				return;
+			}
+		}
+		cp++;
+		ss->lastseen = cp;
+		css = ss;
+	}
+
+	/* shutdown */
+	FDEBUG(("+++ set shutdown at c%d +++\n", css - d->ssets));
+	co = d->cnfa->eos[(v->eflags&REG_NOTEOL) ? 0 : 1];
+	ss = miss(v, d, css, co, cp, v->start);
+	if (ss != NULL) {
+		ss->lastseen = cp;
+		if (ss->flags&POSTSTATE)
+			(DISCARD)setnote(v, ss->states, d->wordsper, found,
+									nhits);
+	}
+}
+
+/*
+ - nsetscan - setscan() by NFA simulation, from where the DFA gave up
+ * d->work holds the states the DFA had got to at cp.
+ ^ static VOID nsetscan(struct vars *, struct dfa *, chr *, int, char *,
+ ^ 	size_t);
+ */
+static VOID
+nsetscan(v, d, cp, post, found, nhits)
+struct vars *v;
+struct dfa *d;
+chr *cp;
+int post;			/* do those states include post? */
+char *found;
+size_t nhits;
+{
+	unsigned *cur = d->work;
+	unsigned *nxt = d->work + d->wordsper;
+	unsigned *t;
+	color co;
+	int flags;
+	struct colormap *cm = d->cm;
+
+	if (post && setnote(v, cur, d->wordsper, found, nhits))
+		return;
+
+	/* main loop */
+	while (cp < v->stop) {
+		co = FGETCOLOR(cm, *cp);
+		flags = nstep(v, d, cur, nxt, co, cp+1);
+		if (flags < 0)
+			return;		/* nothing more can match, or error */
+		cp++;
+		t = cur, cur = nxt, nxt = t;
+		if ((flags&POSTSTATE) &&
+				setnote(v, cur, d->wordsper, found, nhits))
+			return;		/* settled, or error */
+	}
+
+	/* shutdown */
+	co = d->cnfa->eos[(v->eflags&REG_NOTEOL) ? 0 : 1];
+	flags = nstep(v, d, cur, nxt, co, cp);
+	if (flags >= 0 && (flags&POSTSTATE))
+		(DISCARD)setnote(v, nxt, d->wordsper, found, nhits);
+}
+
+/*
+ - setnote - note the REs whose accept states a state set holds
+ * An RE that needs confirming is matched alone, there and then.  The
+ * answer is settled once the nhits lowest-numbered matches are known,
+ * or with nhits 0, once any is.
+ ^ static int setnote(struct vars *, unsigned *, int, char *, size_t);
+ */
+static int			/* nonzero if settled, or on error */
+setnote(v, states, wordsper, found, nhits)
+struct vars *v;
+unsigned *states;		/* bitvector */
+int wordsper;
+char *found;
+size_t nhits;
+{
+	struct guts *g = v->g;
+	unsigned bits;
+	int any = 0;
+	size_t n;
+	int w;
+	int i;
+	int k;
+
+	for (w = 0; w < wordsper; w++) {
+		bits = states[w] & g->setmask[w];
+		for (i = w*UBITS; bits != 0; i++, bits >>= 1) {
+			if (!(bits&1))
+				continue;	/* NOTE CONTINUE */
+			k = g->setpat[i];
+			assert(k >= 0 && k < g->nset);
+			if (found[k] != 0)
+				continue;	/* NOTE CONTINUE */
+			if (g->setre[k].re_magic == 0)
+				found[k] = 1;
+			else {
+				found[k] = setcheck(v, k);
+				if (ISERR())
+					return 1;
+			}
+			if (found[k] > 0)
+				any = 1;
+		}
+	}
+	if (!any)
+		return 0;
+	if (nhits == 0)
+		return 1;
+
+	/* settled if the REs before the first unknown one have enough */
+	n = 0;
+	for (k = 0; k < g->nset && found[k] != 0; k++)
+		if (found[k] > 0 && ++n == nhits)
+			return 1;
+	return (k == g->nset);
+}
+
+/*
+ - setcheck - match one RE of a set alone, to confirm what the NFA claims
+ * Its work counts against the exec's limit, if there is one.  It runs in
+ * this thread even under REG_PARALLEL, whose details are the set's.
+ ^ static int setcheck(struct vars *, int);
+ */
+static int			/* 1 matches, -1 doesn't, 0 error */
+setcheck(v, k)
+struct vars *v;
+int k;
+{
+	rm_detail_t det;
+	int flags = v->eflags & ~(REG_CACHE|REG_LIMIT|REG_PARALLEL);
+	int st;
+
+	if (v->eflags&REG_LIMIT) {
+		if (v->steps >= v->maxsteps) {
+			ERR(REG_ELIMIT);
+			return 0;
+		}
+		det.rm_limit.rl_steps = v->maxsteps - v->steps;
+		det.rm_limit.rl_cancel = v->cancel;
+		flags |= REG_LIMIT;
+	}
+	st = exec(&v->g->setre[k], v->start, (size_t)(v->stop - v->start),
+					&det, (size_t)0, (regmatch_t *)NULL, flags);
+	if (v->eflags&REG_LIMIT)
+		v->steps += det.rm_limit.rl_used;
+	if (st == REG_OKAY)
+		return 1;
+	if (st == REG_NOMATCH)
+		return -1;
+	ERR(st);
+	return 0;
+}
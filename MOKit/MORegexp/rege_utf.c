@@ -0,0 +1,141 @@
+/* ---:mferris: This file contains NO external definitions. */
+
+/*
+ * UTF-8 input, decoded a chunk at a time.
+ * This file is #included by regexec.c.
+ *
+ * A stream fed UTF-8 decodes each chunk into its window of chrs as it
+ * comes, noting the byte offset each chr came from, so that matches can
+ * be reported in bytes and the text is never transcoded all at once.
+ * Malformed bytes become U+FFFD, one apiece.  Anything past the BMP
+ * becomes a surrogate pair, both halves at the offset of its sequence.
+ */
+
+
+
+/* length of the sequence a byte leads, 1 if it doesn't lead one */
+#define	UTFLEN(b)	(((b) >= 0xc2 && (b) <= 0xdf) ? 2 : \
+			((b) >= 0xe0 && (b) <= 0xef) ? 3 : \
+			((b) >= 0xf0 && (b) <= 0xf4) ? 4 : 1)
+
+
+
+/*
+ - utffeed - decode a chunk of UTF-8 onto the end of a stream's text
+ * There must be room for a chr per byte, pending ones included.  A
+ * sequence cut off at the end of the chunk waits for the next one,
+ * unless this is the last.
+ ^ static VOID utffeed(struct stream *, CONST unsigned char *, size_t, int);
+ */
+static VOID
+utffeed(s, in, len, last)
+struct stream *s;
+CONST unsigned char *in;
+size_t len;
+int last;			/* no more after this */
+{
+	unsigned char tmp[8];
+	size_t k;
+	size_t used;
+	int need;
+
+	if (s->npend > 0) {
+		/* finish the sequence left over last time */
+		need = UTFLEN(s->pend[0]);
+		k = (size_t)(need - s->npend);
+		if (k > len)
+			k = len;
+		memcpy(VS(tmp), VS(s->pend), (size_t)s->npend);
+		memcpy(VS(tmp + s->npend), VS(in), k);
+		if (s->npend + k < (size_t)need && !last) {
+			memcpy(VS(s->pend + s->npend), VS(in), k);
+			s->npend += (int)k;
+			return;
+		}
+		s->nbuf += utfdecode(tmp, s->npend + k, last && k == len,
+				s->buf + s->nbuf, s->boff + s->nbuf,
+				(regoff_t)s->bnext, &used);
+		assert(used >= (size_t)s->npend);
+		in += used - s->npend;
+		len -= used - s->npend;
+		s->bnext += used;
+		s->npend = 0;
+	}
+	s->nbuf += utfdecode(in, len, last, s->buf + s->nbuf,
+				s->boff + s->nbuf, (regoff_t)s->bnext, &used);
+	s->bnext += used;
+	assert(len - used < sizeof(s->pend));
+	memcpy(VS(s->pend), VS(in + used), len - used);
+	s->npend = (int)(len - used);
+}
+
+/*
+ - utfdecode - decode UTF-8 into chrs, noting where each came from
+ ^ static size_t utfdecode(CONST unsigned char *, size_t, int, chr *,
+ ^ 	regoff_t *, regoff_t, size_t *);
+ */
+static size_t			/* chrs produced */
+utfdecode(in, len, last, out, offs, off, usedp)
+CONST unsigned char *in;
+size_t len;
+int last;			/* a sequence cut off here is malformed */
+chr *out;
+regoff_t *offs;			/* byte offset of each chr out */
+regoff_t off;			/* byte offset of in[0] */
+size_t *usedp;			/* bytes decoded; the rest wait */
+{
+	size_t i = 0;
+	size_t n = 0;
+	unsigned b;
+	unsigned t;
+	unsigned lo;
+	unsigned hi;
+	unsigned long c;
+	int need;
+	int k;
+
+	while (i < len) {
+		b = in[i];
+		if (b < 0x80) {		/* the common case, quickly */
+			out[n] = (chr)b;
+			offs[n++] = off + (regoff_t)i++;
+			continue;	/* NOTE CONTINUE */
+		}
+		need = UTFLEN(b);
+		k = 1;
+		if (need == 1)
+			c = 0xfffd;		/* stray or impossible byte */
+		else {
+			for (; k < need && i + k < len; k++) {
+				t = in[i + k];
+				lo = (k == 1 && b == 0xe0) ? 0xa0 :
+					(k == 1 && b == 0xf0) ? 0x90 : 0x80;
+				hi = (k == 1 && b == 0xed) ? 0x9f :
+					(k == 1 && b == 0xf4) ? 0x8f : 0xbf;
+				if (t < lo || t > hi)
+					break;	/* NOTE BREAK OUT */
+			}
+			if (k < need && i + k == len && !last)
+				break;		/* NOTE BREAK OUT */
+			if (k < need) {
+				c = 0xfffd;	/* malformed, skip the lead */
+				k = 1;
+			} else {
+				c = b & (0x7f >> need);
+				for (k = 1; k < need; k++)
+					c = (c << 6) | (in[i + k] & 0x3f);
+			}
+		}
+		if (c > 0xffff) {	/* a surrogate pair */
+			c -= 0x10000;
+			out[n] = (chr)(0xd800 + (c >> 10));
+			offs[n++] = off + (regoff_t)i;
+			c = 0xdc00 + (c & 0x3ff);
+		}
+		out[n] = (chr)c;
+		offs[n++] = off + (regoff_t)i;
+		i += k;
+	}
+	*usedp = i;
+	return n;
+}
@@ -108,17 +108,63 @@ extern "C" {
 #undef __REG_NOCHAR
 #endif
 /* interface types */
+#ifdef REG_CHR8
+#define	__REG_WIDE_T	unsigned char	/* the 8-bit build, see below */
+#else
 #define	__REG_WIDE_T	MO_unichar
+#endif
 #define	__REG_REGOFF_T	long	/* not really right, but good enough... */
 #define	__REG_VOID_T	VOID
 #define	__REG_CONST	CONST
 /* names and declarations */
-#define	__REG_WIDE_COMPILE	MO_ReComp
-#define	__REG_WIDE_EXEC		MO_ReExec
 #define	__REG_NOFRONT		/* don't want regcomp() and regexec() */
-#define	__REG_NOCHAR		/* or the char versions */
 #define	regfree		MO_ReFree
 #define	regerror	MO_ReError
+#ifdef REG_CHR8
+#define	__REG_WIDE_COMPILE	MO_ReComp8
+#define	__REG_WIDE_EXEC		MO_ReExec8
+#define	__REG_NOCHAR		/* the char versions are these */
+#define	regtune		MO_ReTune8
+#define	regstats	MO_ReStats8
+#define	regbegin	MO_ReIterBegin8
+#define	regnext		MO_ReIterNext8
+#define	regend		MO_ReIterEnd8
+#define	regsbegin	MO_ReStreamBegin8
+#define	regsfeed	MO_ReStreamFeed8
+#define	regsnext	MO_ReStreamNext8
+#define	regsend		MO_ReStreamEnd8
+#define	regsetcomp	MO_ReSetComp8
+#define	regsetexec	MO_ReSetExec8
+#else
+#define	__REG_WIDE_COMPILE	MO_ReComp
+#define	__REG_WIDE_EXEC		MO_ReExec
+#define	re_comp		MO_ReComp8	/* char versions are the 8-bit build */
+#define	re_exec		MO_ReExec8
+#define	re_tune		MO_ReTune8
+#define	re_stats	MO_ReStats8
+#define	re_begin	MO_ReIterBegin8
+#define	re_next		MO_ReIterNext8
+#define	re_end		MO_ReIterEnd8
+#define	re_sbegin	MO_ReStreamBegin8
+#define	re_sfeed	MO_ReStreamFeed8
+#define	re_snext	MO_ReStreamNext8
+#define	re_send		MO_ReStreamEnd8
+#define	re_setcomp	MO_ReSetComp8
+#define	re_setexec	MO_ReSetExec8
+#define	regtune		MO_ReTune
+#define	regstats	MO_ReStats
+#define	regbegin	MO_ReIterBegin
+#define	regnext		MO_ReIterNext
+#define	regend		MO_ReIterEnd
+#define	regsbegin	MO_ReStreamBegin
+#define	regsfeed	MO_ReStreamFeed
+#define	regsnext	MO_ReStreamNext
+#define	regsend		MO_ReStreamEnd
+#define	regsetcomp	MO_ReSetComp
+#define	regsetexec	MO_ReSetExec
+#define	regsfeedu	MO_ReStreamFeedUTF8
+#define	regexecu	MO_ReExecUTF8
+#endif
 /* --- end --- */
 
 
@@ -148,12 +194,15 @@ typedef void re_void;
 #endif
 
 /*
- * Also for benefit of old compilers, <sys/types.h> can supply a macro
- * which expands to a substitute for `const'.
+ * Also for benefit of old compilers, <sys/types.h> can supply macros
+ * which expand to substitutes for `const' and `volatile'.
  */
 #ifndef __REG_CONST
 #define	__REG_CONST	const
 #endif
+#ifndef __REG_VOLATILE
+#define	__REG_VOLATILE	volatile
+#endif
 
 
 
@@ -193,11 +242,51 @@ typedef struct {
 	regoff_t rm_eo;		/* end of substring */
 } regmatch_t;
 
+/* tuning and statistics for the matcher's state-set caches */
+typedef struct {
+	size_t rc_budget;	/* bytes of cache per DFA, 0 for default */
+	int rc_policy;		/* replacement policy, 0 for default */
+#		define	REG_CSCAN	1	/* any set not used lately */
+#		define	REG_CCLOCK	2	/* clock, i.e. second chance */
+#		define	REG_CFLUSH	3	/* flush everything when full */
+	long rc_flushes;	/* times a cache was flushed wholesale */
+	long rc_evictions;	/* state sets thrown out to make room */
+} rm_cache_t;
+
+/* bounds on the work one exec may do */
+typedef struct {
+	long rl_steps;		/* most steps allowed, 0 for no limit */
+	__REG_CONST __REG_VOLATILE int *rl_cancel;	/* quit when nonzero */
+	long rl_used;		/* steps taken, reported back */
+} rm_limit_t;
+
+/* splitting one search among threads */
+typedef struct {
+	int rp_threads;		/* most threads to use, 0 for one per CPU */
+	size_t rp_piece;	/* chrs per piece of the string, 0 for default */
+	int rp_pieces;		/* pieces searched, reported back */
+} rm_par_t;
+
 /* supplementary control and reporting */
 typedef struct {
 	regmatch_t rm_extend;	/* see REG_EXPECT */
+	rm_cache_t rm_cache;	/* see REG_CACHE */
+	rm_limit_t rm_limit;	/* see REG_LIMIT */
+	rm_par_t rm_par;	/* see REG_PARALLEL */
 } rm_detail_t;
 
+/* the matches in one string, one after another (see regbegin()) */
+typedef struct {
+	int ri_magic;		/* magic number */
+	char *ri_guts;		/* opaque pointer to hidden innards */
+} regiter_t;
+
+/* matches in text that comes a chunk at a time (see regsbegin()) */
+typedef struct {
+	int rs_magic;		/* magic number */
+	char *rs_guts;		/* opaque pointer to hidden innards */
+} regstream_t;
+
 
 
 /*
@@ -210,6 +299,12 @@ typedef struct {
  ^ #endif
  ^ #ifdef __REG_WIDE_T
  ^ int __REG_WIDE_COMPILE(regex_t *, __REG_CONST __REG_WIDE_T *, size_t, int);
+ ^ int regsetcomp(regex_t *, int, __REG_CONST __REG_WIDE_T *__REG_CONST [],
+ ^				__REG_CONST size_t [], __REG_CONST int []);
+ ^ #endif
+ ^ #ifndef __REG_NOCHAR
+ ^ int re_setcomp(regex_t *, int, __REG_CONST char *__REG_CONST [],
+ ^				__REG_CONST size_t [], __REG_CONST int []);
  ^ #endif
  */
 #define	REG_BASIC	000000	/* BREs (convenience) */
@@ -230,6 +325,8 @@ typedef struct {
 #define	REG_DUMP	004000	/* none of your business :-) */
 #define	REG_FAKE	010000	/* none of your business :-) */
 #define	REG_PROGRESS	020000	/* none of your business :-) */
+#define	REG_SHARED	040000	/* execs in many threads share DFAs */
+#define	REG_FULLDFA	0100000	/* build full DFAs at compile time */
 
 
 
@@ -245,7 +342,38 @@ typedef struct {
  ^ #ifdef __REG_WIDE_T
  ^ int __REG_WIDE_EXEC(regex_t *, __REG_CONST __REG_WIDE_T *, size_t,
  ^				rm_detail_t *, size_t, regmatch_t [], int);
+ ^ int regbegin(regiter_t *, regex_t *, __REG_CONST __REG_WIDE_T *, size_t,
+ ^				rm_detail_t *, int);
+ ^ int regnext(regiter_t *, size_t, regmatch_t []);
+ ^ int regsfeed(regstream_t *, __REG_CONST __REG_WIDE_T *, size_t, int);
+ ^ int regsfeedu(regstream_t *, __REG_CONST char *, size_t, int);
+ ^ int regexecu(regex_t *, __REG_CONST char *, size_t,
+ ^				rm_detail_t *, size_t, regmatch_t [], int);
+ ^ int regsetexec(regex_t *, __REG_CONST __REG_WIDE_T *, size_t,
+ ^				rm_detail_t *, size_t, int [], int);
+ ^ #endif
+ ^ re_void regend(regiter_t *);
+ ^ int regsbegin(regstream_t *, regex_t *, size_t, rm_detail_t *, int);
+ ^ int regsnext(regstream_t *, size_t, regmatch_t []);
+ ^ re_void regsend(regstream_t *);
+ ^ #ifndef __REG_NOCHAR
+ ^ int re_begin(regiter_t *, regex_t *, __REG_CONST char *, size_t,
+ ^				rm_detail_t *, int);
+ ^ int re_next(regiter_t *, size_t, regmatch_t []);
+ ^ re_void re_end(regiter_t *);
+ ^ int re_sbegin(regstream_t *, regex_t *, size_t, rm_detail_t *, int);
+ ^ int re_sfeed(regstream_t *, __REG_CONST char *, size_t, int);
+ ^ int re_snext(regstream_t *, size_t, regmatch_t []);
+ ^ re_void re_send(regstream_t *);
+ ^ int re_setexec(regex_t *, __REG_CONST char *, size_t,
+ ^				rm_detail_t *, size_t, int [], int);
  ^ #endif
+ *
+ * regexecu() and regsfeedu() take UTF-8, with offsets in bytes.  An RE
+ * with lookahead constraints, or compiled with REG_EXPECT, can't go
+ * through a stream, so regexecu() decodes all of its text at once for
+ * it, keeping a chr and a regoff_t for each:  up to 2+sizeof(regoff_t)
+ * bytes of memory per byte of text.
  */
 #define	REG_NOTBOL	0001	/* BOS is not BOL */
 #define	REG_NOTEOL	0002	/* EOS is not EOL */
@@ -253,12 +381,22 @@ typedef struct {
 #define	REG_FTRACE	0010	/* none of your business */
 #define	REG_MTRACE	0020	/* none of your business */
 #define	REG_SMALL	0040	/* none of your business */
+#define	REG_CACHE	0100	/* cache tuning and counts via rm_cache */
+#define	REG_LIMIT	0200	/* work limit and cancellation via rm_limit */
+#define	REG_PARALLEL	0400	/* search split among threads via rm_par */
+#define	REG_NOMEMO	01000	/* none of your business */
 
 
 
 /*
  * misc generics (may be more functions here eventually)
  ^ re_void regfree(regex_t *);
+ ^ int regtune(regex_t *, __REG_CONST rm_cache_t *);
+ ^ int regstats(__REG_CONST regex_t *, rm_cache_t *);
+ ^ #ifndef __REG_NOCHAR
+ ^ int re_tune(regex_t *, __REG_CONST rm_cache_t *);
+ ^ int re_stats(__REG_CONST regex_t *, rm_cache_t *);
+ ^ #endif
  */
 
 
@@ -292,6 +430,7 @@ typedef struct {
 #define	REG_INVARG	16	/* invalid argument to regex function */
 #define	REG_MIXED	17	/* character widths of regex and string differ */
 #define	REG_BADOPT	18	/* invalid embedded option */
+#define	REG_ELIMIT	19	/* work limit reached, or cancelled */
 /* two specials for debugging and testing */
 #define	REG_ATOI	101	/* convert error-code name to number */
 #define	REG_ITOA	102	/* convert error-code number to name */
@@ -312,6 +451,10 @@ int regcomp _ANSI_ARGS_((regex_t *, __REG_CONST char *, int));
 #endif
 #ifdef __REG_WIDE_T
 int __REG_WIDE_COMPILE _ANSI_ARGS_((regex_t *, __REG_CONST __REG_WIDE_T *, size_t, int));
+int regsetcomp _ANSI_ARGS_((regex_t *, int, __REG_CONST __REG_WIDE_T *__REG_CONST [], __REG_CONST size_t [], __REG_CONST int []));
+#endif
+#ifndef __REG_NOCHAR
+int re_setcomp _ANSI_ARGS_((regex_t *, int, __REG_CONST char *__REG_CONST [], __REG_CONST size_t [], __REG_CONST int []));
 #endif
 #ifndef __REG_NOCHAR
 int re_exec _ANSI_ARGS_((regex_t *, __REG_CONST char *, size_t, rm_detail_t *, size_t, regmatch_t [], int));
@@ -321,8 +464,34 @@ int regexec _ANSI_ARGS_((regex_t *, __REG_CONST char *, size_t, regmatch_t [], i
 #endif
 #ifdef __REG_WIDE_T
 int __REG_WIDE_EXEC _ANSI_ARGS_((regex_t *, __REG_CONST __REG_WIDE_T *, size_t, rm_detail_t *, size_t, regmatch_t [], int));
+int regbegin _ANSI_ARGS_((regiter_t *, regex_t *, __REG_CONST __REG_WIDE_T *, size_t, rm_detail_t *, int));
+int regnext _ANSI_ARGS_((regiter_t *, size_t, regmatch_t []));
+int regsfeed _ANSI_ARGS_((regstream_t *, __REG_CONST __REG_WIDE_T *, size_t, int));
+int regsfeedu _ANSI_ARGS_((regstream_t *, __REG_CONST char *, size_t, int));
+int regexecu _ANSI_ARGS_((regex_t *, __REG_CONST char *, size_t, rm_detail_t *, size_t, regmatch_t [], int));
+int regsetexec _ANSI_ARGS_((regex_t *, __REG_CONST __REG_WIDE_T *, size_t, rm_detail_t *, size_t, int [], int));
+#endif
+re_void regend _ANSI_ARGS_((regiter_t *));
+int regsbegin _ANSI_ARGS_((regstream_t *, regex_t *, size_t, rm_detail_t *, int));
+int regsnext _ANSI_ARGS_((regstream_t *, size_t, regmatch_t []));
+re_void regsend _ANSI_ARGS_((regstream_t *));
+#ifndef __REG_NOCHAR
+int re_begin _ANSI_ARGS_((regiter_t *, regex_t *, __REG_CONST char *, size_t, rm_detail_t *, int));
+int re_next _ANSI_ARGS_((regiter_t *, size_t, regmatch_t []));
+re_void re_end _ANSI_ARGS_((regiter_t *));
+int re_sbegin _ANSI_ARGS_((regstream_t *, regex_t *, size_t, rm_detail_t *, int));
+int re_sfeed _ANSI_ARGS_((regstream_t *, __REG_CONST char *, size_t, int));
+int re_snext _ANSI_ARGS_((regstream_t *, size_t, regmatch_t []));
+re_void re_send _ANSI_ARGS_((regstream_t *));
+int re_setexec _ANSI_ARGS_((regex_t *, __REG_CONST char *, size_t, rm_detail_t *, size_t, int [], int));
 #endif
 re_void regfree _ANSI_ARGS_((regex_t *));
+int regtune _ANSI_ARGS_((regex_t *, __REG_CONST rm_cache_t *));
+int regstats _ANSI_ARGS_((__REG_CONST regex_t *, rm_cache_t *));
+#ifndef __REG_NOCHAR
+int re_tune _ANSI_ARGS_((regex_t *, __REG_CONST rm_cache_t *));
+int re_stats _ANSI_ARGS_((__REG_CONST regex_t *, rm_cache_t *));
+#endif
 extern size_t regerror _ANSI_ARGS_((int, __REG_CONST regex_t *, char *, size_t));
 /* automatically gathered by fwd; do not hand-edit */
 /* =====^!^===== end forwards =====^!^===== */
@@ -1,6 +1,9 @@
 /* ---:mferris: This file contains ONLY the following external definitions:
  *
  * function exec() which is #defined to MO_ReExec()
+ * function regtune() which is #defined to MO_ReTune()
+ * function regstats() which is #defined to MO_ReStats()
+ * function regsetexec() which is #defined to MO_ReSetExec()
  */
 
 /*
@@ -56,12 +59,29 @@ struct sset {			/* state set */
 #		define	POSTSTATE	02	/* includes the goal state */
 #		define	LOCKED		04	/* locked in cache */
 #		define	NOPROGRESS	010	/* zero-progress state set */
+#		define	VACANT		020	/* flushed, free for reuse */
+#		define	ALWAYS		040	/* matches end everywhere from here */
+#		define	SETSEEN		0100	/* its REs noted, see setscan() */
 	struct arcp ins;	/* chain of inarcs pointing here */
 	chr *lastseen;		/* last entered on arrival here */
+	chr *swept;		/* lastseen when the clock hand passed */
+#	define	SSINUSE(ss, cp)	((ss)->lastseen != NULL && (ss)->lastseen+1 >= (cp))
 	struct sset **outs;	/* outarc vector indexed by color */
 	struct arcp *inchain;	/* chain-pointer vector for outarcs */
 };
 
+struct lacarc {			/* transition that hinged on lookahead */
+	struct sset *from;
+	color co;
+	unsigned tested;	/* constraints it depended on, by number */
+	unsigned passed;	/* and which of those were satisfied */
+	struct sset *to;
+	unsigned gen;		/* lacgen when recorded */
+};
+#define	NLACARCS	64	/* power of 2 */
+#define	LACSLOT(d, ss, co)	((int)(((ss) - (d)->ssets) * 31 + (co)) & \
+							(NLACARCS-1))
+
 struct dfa {
 	int nssets;		/* size of cache */
 	int nssused;		/* how many entries occupied yet */
@@ -69,6 +89,11 @@ struct dfa {
 	int ncolors;		/* length of outarc and inchain vectors */
 	int wordsper;		/* length of state-set bitvectors */
 	struct sset *ssets;	/* state-set cache */
+	int *hashtab;		/* open-addressed index into ssets, -1 empty */
+	int hashshift;		/* hash bits to discard, giving a table index */
+	int hashmask;		/* table size - 1 */
+#	define	HASHSLOT(d, h)	((int)(((unsigned)(h) * 0x9e3779b1U) >> \
+							(d)->hashshift))
 	unsigned *statesarea;	/* bitvector storage */
 	unsigned *work;		/* pointer to work area within statesarea */
 	struct sset **outsarea;	/* outarc-vector storage */
@@ -78,24 +103,59 @@ struct dfa {
 	chr *lastpost;		/* location of last cache-flushed success */
 	chr *lastnopr;		/* location of last cache-flushed NOPROGRESS */
 	struct sset *search;	/* replacement-search-pointer memory */
+	struct lacarc *lacarcs;	/* NLACARCS of them, if cnfa has lacons */
+	unsigned lacgen;	/* bumped whenever an sset is reused */
+	size_t budget;		/* rc_budget it was sized for, 0 default */
+	int policy;		/* replacement policy, REG_CSCAN etc. */
+	int nvacant;		/* how many entries VACANT (REG_CFLUSH) */
+	int shared;		/* append-only, in use by many threads */
+	int thrashed;		/* cache gave up on, for this exec */
 	int cptsmalloced;	/* were the areas individually malloced? */
 	char *mallocarea;	/* self, or master malloced area, or NULL */
 };
 
-#define	WORK	1		/* number of work bitvectors needed */
+#define	WORK	2		/* number of work bitvectors needed */
+
+/* cache is more trouble than it's worth:  evicting for 3 chrs in 4 */
+#define	THRASHING(v, d, ev0, n)	((v)->nevictions - (ev0) > (d)->nssets && \
+			((v)->nevictions - (ev0)) * 4 > (long)(n) * 3)
 
 /* setup for non-malloc allocation for small cases */
 #define	FEWSTATES	20	/* must be less than UBITS */
 #define	FEWCOLORS	15
+#define	FEWHASH		64	/* power of 2, at least 2*FEWSTATES */
 struct smalldfa {
 	struct dfa dfa;
 	struct sset ssets[FEWSTATES*2];
+	int hashtab[FEWHASH];
 	unsigned statesarea[FEWSTATES*2 + WORK];
 	struct sset *outsarea[FEWSTATES*2 * FEWCOLORS];
 	struct arcp incarea[FEWSTATES*2 * FEWCOLORS];
 };
 #define	DOMALLOC	((struct smalldfa *)NULL)	/* force malloc */
 
+/* limits on a cache sized by rc_budget */
+#define	MINSSETS	7	/* as for REG_SMALL */
+#define	MAXSSETS	(1<<24)
+
+/* miss() work bitvector that fits on the stack, for shared DFAs */
+#define	FEWWORDS	8
+#define	FAILREFS	2	/* most groups a remembered failure may see */
+#define	NLADFAS		8	/* lookahead DFAs held for a whole exec */
+#define	LAMEMO		128	/* lookahead outcomes remembered, power of 2 */
+#define	LAHASH(off, n)	((((unsigned)(off) * 5) + (unsigned)(n)) & (LAMEMO-1))
+
+
+
+/* a dissection attempt known to fail, by what its outcome depends on */
+struct fail {
+	struct subre *t;	/* NULL if unused */
+	regoff_t begin;
+	regoff_t end;
+	regoff_t refs[2*FAILREFS];	/* its groups, so and eo */
+};
+#define	NFAILS		256	/* failures remembered, power of 2 */
+
 
 
 /* internal variables, bundled for easy passing around */
@@ -108,21 +168,145 @@ struct vars {
 	rm_detail_t *details;
 	chr *start;		/* start of string */
 	chr *stop;		/* just past end of string */
+	chr *from;		/* where the search starts */
+	chr *bound;		/* search finds no ends past here, NULL stop */
+	int npieces;		/* pieces the string was searched in */
 	int err;		/* error code if any (0 none) */
 	regoff_t *mem;		/* memory vector for backtracking */
+	struct fail *fails;	/* NFAILS known failures, NULL until needed */
+	size_t cbudget;		/* cache tuning in effect */
+	int cpolicy;
+	long nflushes;		/* cache counts, for details and guts */
+	long nevictions;
+	int dfafull;		/* a shared DFA ran out of room */
+	long steps;		/* work done so far, see SPEND() */
+	long maxsteps;		/* and how much is allowed */
+	CONST volatile int *cancel;	/* client's say-so to quit, or NULL */
 	struct smalldfa dfa1;
 	struct smalldfa dfa2;
+	struct dfa *ladfas[NLADFAS];	/* lookahead DFAs in hand, by number */
+	struct lamemo {		/* lookahead-constraint outcomes so far */
+		chr *cp;
+		int n;
+		int ok;
+	} lamemo[LAMEMO];
 };
 #define	VISERR(vv)	((vv)->err != 0)	/* have we seen an error yet? */
 #define	ISERR()	VISERR(v)
 #define	VERR(vv,e)	(((vv)->err) ? (vv)->err : ((vv)->err = (e)))
 #define	ERR(e)	VERR(v, e)		/* record an error */
 #define	NOERR()	{if (ISERR()) return v->err;}	/* if error seen, return it */
+/* charge for a step of work; nonzero, with the error noted, if it's over */
+#define	SPEND(vv, n)	((((vv)->steps += (n)) > (vv)->maxsteps || \
+			((vv)->cancel != NULL && ATOMGET((vv)->cancel))) ? \
+			VERR(vv, REG_ELIMIT) : 0)
+/*
+ * A scan through chrs on a warm cache or a table does no other work, so
+ * it charges a step every SPENDCHRS chrs, seeing the cancel flag then
+ * too.  SPENDAT() is where a scan from cp toward lim next stops to pay;
+ * that's lim itself when nobody is counting, so it costs nothing then.
+ */
+#define	SPENDCHRS	4096
+#define	SPENDING(vv)	((vv)->maxsteps != LONG_MAX || (vv)->cancel != NULL)
+#define	SPENDAT(vv, cp, lim)	((SPENDING(vv) && (lim) - (cp) > SPENDCHRS) ? \
+					(cp) + SPENDCHRS : (lim))
+#define	SPENDBACK(vv, cp, lim)	((SPENDING(vv) && (cp) - (lim) > SPENDCHRS) ? \
+					(cp) - SPENDCHRS : (lim))
 #define	OFF(p)	((p) - v->start)
 #define	LOFF(p)	((long)OFF(p))
 
 
 
+/* an iteration under way, what a regiter_t's ri_guts points to */
+struct iter {
+	struct vars var;	/* kept from one match to the next */
+	regmatch_t *pmatch;	/* work areas, if backreferences need them */
+	regoff_t *mem;
+	int done;		/* no more matches to be had */
+};
+#define	ITMAGIC	0x1fe7
+
+
+
+/* a match under way across chunks, what a regstream_t's rs_guts points to */
+struct stream {
+	struct vars var;	/* kept from chunk to chunk */
+	struct dfa *d;		/* the search DFA, ours alone */
+	struct sset *css;	/* where it had got to, NULL to start afresh */
+	chr *buf;		/* the text still wanted */
+	size_t nbuf;
+	size_t abuf;		/* room in buf */
+	size_t max;		/* most text to hold */
+	size_t base;		/* stream offset of buf[0] */
+	size_t scanned;		/* buf index the search has reached */
+	size_t cold;		/* no match starts before this index */
+	size_t close;		/* no match in hand goes past this index */
+	int found;		/* the search has seen a match end */
+	int last;		/* the last chunk is in */
+	int done;		/* no more matches to be had */
+	regmatch_t *pmatch;	/* work areas, if backreferences need them */
+	regoff_t *mem;
+	int utf8;		/* fed UTF-8 (1), or chrs (-1), or not yet */
+	regoff_t *boff;		/* UTF-8:  byte offset of each chr in buf */
+	size_t bnext;		/* and of the first byte not yet decoded */
+	unsigned char pend[4];	/* a sequence the chunks split */
+	int npend;
+};
+#define	STMAGIC	0x1fe8
+#define	STREAMBUF	1024	/* chrs of room to start with */
+#define	STREAMMAX	(1024*1024)	/* default most chrs held */
+#define	UTFCHUNK	4096	/* bytes regexecu() decodes at a time */
+
+
+
+/* a search split into pieces for threads to share out (see parfind()) */
+struct par {
+	struct vars *v;		/* the exec's own, the pattern for the rest */
+	size_t nmatch;
+	size_t len;		/* chrs in each piece but the last */
+	int npieces;
+	int next;		/* the next piece to be taken */
+	int settled;		/* lowest piece known to decide it all */
+	struct piece {
+		int st;		/* its outcome, -1 if never tried */
+		volatile int quit;	/* nonzero to give it up */
+		long nflushes;	/* its cache counts */
+		long nevictions;
+	} *pieces;
+	regmatch_t *pmatch;	/* nmatch for each piece */
+};
+struct worker {			/* one of the threads doing the pieces */
+	struct par *par;
+	struct vars var;	/* its own, filled in afresh for each piece */
+	THREAD tid;
+};
+#define	PARPIECE	65536	/* fewest chrs in a piece, by default */
+#define	PARSPLIT	4	/* pieces for each thread, by default */
+#define	PARMOST		4096	/* most pieces */
+/* can we skip about with the literals?  REG_EXPECT wants more */
+#define	USELIT(vv)	((vv)->g->nlit > 0 && !((vv)->g->cflags&REG_EXPECT))
+/* failing prefixes, the colors a match can start with are some help */
+#define	USESKIP(vv)	(((vv)->g->npfx > 0 || (vv)->g->startco != NULL) && \
+					!((vv)->g->cflags&REG_EXPECT))
+/* can we skip retries with the reverse NFA?  REG_EXPECT wants them all */
+#define	USEREV(vv)	(!NULLCNFA((vv)->g->reverse) && \
+					!((vv)->g->cflags&REG_EXPECT))
+/* can a match start only at the beginning, and we need to know where? */
+#define	ONLYHERE(vv)	((vv)->g->anchored && (vv)->nmatch > 0 && \
+					!((vv)->g->cflags&REG_EXPECT))
+/* can the search be split among threads?  see parfind() */
+#define	USEPAR(vv)	(((vv)->eflags&REG_PARALLEL) && !(vv)->g->anchored && \
+			!((vv)->g->one != NULL && (vv)->g->one->anchored) && \
+			!((vv)->g->info&REG_UBACKREF) && \
+			!((vv)->eflags&REG_LIMIT) && \
+			!((vv)->g->cflags&REG_EXPECT) && ((vv)->g->maxlen >= 0 || \
+			!NULLCNFA((vv)->g->ahead)))
+/* can one walk do it all?  not if REG_EXPECT, nor if only a yes is wanted */
+#define	USEONE(vv)	((vv)->g->one != NULL && (vv)->g->one->anchored && \
+			(vv)->nmatch > 1 && !((vv)->g->cflags&REG_EXPECT))
+
+
+
 /*
  * forward declarations
  */
@@ -130,9 +314,28 @@ struct vars {
 /* automatically gathered by fwd; do not hand-edit */
 /* === regexec.c === */
 int exec _ANSI_ARGS_((regex_t *, CONST chr *, size_t, rm_detail_t *, size_t, regmatch_t [], int));
+static int setup _ANSI_ARGS_((struct vars *, regex_t *, CONST chr *, size_t, rm_detail_t *, int));
+static int dofind _ANSI_ARGS_((struct vars *, size_t, regmatch_t []));
+static VOID report _ANSI_ARGS_((struct vars *));
+static VOID finish _ANSI_ARGS_((struct vars *));
+int regbegin _ANSI_ARGS_((regiter_t *, regex_t *, CONST chr *, size_t, rm_detail_t *, int));
+int regnext _ANSI_ARGS_((regiter_t *, size_t, regmatch_t []));
+VOID regend _ANSI_ARGS_((regiter_t *));
+int regsbegin _ANSI_ARGS_((regstream_t *, regex_t *, size_t, rm_detail_t *, int));
+int regsfeed _ANSI_ARGS_((regstream_t *, CONST chr *, size_t, int));
+int regsfeedu _ANSI_ARGS_((regstream_t *, CONST char *, size_t, int));
+static int room _ANSI_ARGS_((struct stream *, size_t));
+int regsnext _ANSI_ARGS_((regstream_t *, size_t, regmatch_t []));
+VOID regsend _ANSI_ARGS_((regstream_t *));
+static regoff_t soff _ANSI_ARGS_((struct stream *, regoff_t));
+int regexecu _ANSI_ARGS_((regex_t *, CONST char *, size_t, rm_detail_t *, size_t, regmatch_t [], int));
+int regsetexec _ANSI_ARGS_((regex_t *, CONST chr *, size_t, rm_detail_t *, size_t, int [], int));
+int regtune _ANSI_ARGS_((regex_t *, CONST rm_cache_t *));
+int regstats _ANSI_ARGS_((CONST regex_t *, rm_cache_t *));
 static int find _ANSI_ARGS_((struct vars *, struct cnfa *, struct colormap *));
 static int cfind _ANSI_ARGS_((struct vars *, struct cnfa *, struct colormap *));
-static int cfindloop _ANSI_ARGS_((struct vars *, struct cnfa *, struct colormap *, struct dfa *, struct dfa *, chr **));
+static int cfindloop _ANSI_ARGS_((struct vars *, struct cnfa *, struct colormap *, struct dfa *, struct dfa *, struct dfa *, chr **));
+static chr *farthest _ANSI_ARGS_((struct vars *, chr *));
 static VOID zapsubs _ANSI_ARGS_((regmatch_t *, size_t));
 static VOID zapmem _ANSI_ARGS_((struct vars *, struct subre *));
 static VOID subset _ANSI_ARGS_((struct vars *, struct subre *, chr *, chr *));
@@ -140,6 +343,10 @@ static int dissect _ANSI_ARGS_((struct vars *, struct subre *, chr *, chr *));
 static int condissect _ANSI_ARGS_((struct vars *, struct subre *, chr *, chr *));
 static int altdissect _ANSI_ARGS_((struct vars *, struct subre *, chr *, chr *));
 static int cdissect _ANSI_ARGS_((struct vars *, struct subre *, chr *, chr *));
+static int failkey _ANSI_ARGS_((struct vars *, struct subre *, chr *, chr *, struct fail *));
+static int failed _ANSI_ARGS_((struct vars *, struct fail *));
+static VOID notefail _ANSI_ARGS_((struct vars *, struct fail *));
+static int failhash _ANSI_ARGS_((struct fail *));
 static int ccondissect _ANSI_ARGS_((struct vars *, struct subre *, chr *, chr *));
 static int crevdissect _ANSI_ARGS_((struct vars *, struct subre *, chr *, chr *));
 static int cbrdissect _ANSI_ARGS_((struct vars *, struct subre *, chr *, chr *));
@@ -147,15 +354,65 @@ static int caltdissect _ANSI_ARGS_((struct vars *, struct subre *, chr *, chr *)
 /* === rege_dfa.c === */
 static chr *longest _ANSI_ARGS_((struct vars *, struct dfa *, chr *, chr *, int *));
 static chr *shortest _ANSI_ARGS_((struct vars *, struct dfa *, chr *, chr *, chr *, chr **, int *));
+static chr *slongest _ANSI_ARGS_((struct vars *, struct dfa *, chr *, chr *, int *));
+static chr *sshortest _ANSI_ARGS_((struct vars *, struct dfa *, chr *, chr *, chr *, chr **, int *));
+static chr *tlongest _ANSI_ARGS_((struct vars *, struct dfa *, chr *, chr *, int *));
+static chr *tshortest _ANSI_ARGS_((struct vars *, struct dfa *, chr *, chr *, chr *, chr **, int *));
+static chr *reach _ANSI_ARGS_((struct vars *, struct dfa *, chr *));
+static chr *treach _ANSI_ARGS_((struct vars *, struct dfa *, chr *));
+static chr *backward _ANSI_ARGS_((struct vars *, struct dfa *, chr *, chr *));
+static chr *tbackward _ANSI_ARGS_((struct vars *, struct dfa *, chr *, chr *));
 static chr *lastcold _ANSI_ARGS_((struct vars *, struct dfa *));
+static int resume _ANSI_ARGS_((struct vars *, struct stream *));
 static struct dfa *newdfa _ANSI_ARGS_((struct vars *, struct cnfa *, struct colormap *, struct smalldfa *));
 static VOID freedfa _ANSI_ARGS_((struct dfa *));
+static struct dfa *getdfa _ANSI_ARGS_((struct vars *, int, struct cnfa *, struct smalldfa *));
+static VOID putdfa _ANSI_ARGS_((struct vars *, int, struct dfa *));
 static unsigned hash _ANSI_ARGS_((unsigned *, int));
+static struct sset *findss _ANSI_ARGS_((struct dfa *, unsigned, unsigned *));
+static VOID addss _ANSI_ARGS_((struct dfa *, struct sset *));
+static VOID delss _ANSI_ARGS_((struct dfa *, struct sset *));
+static struct sset *claimss _ANSI_ARGS_((struct vars *, struct dfa *, unsigned *, unsigned, int));
 static struct sset *initialize _ANSI_ARGS_((struct vars *, struct dfa *, chr *));
 static struct sset *miss _ANSI_ARGS_((struct vars *, struct dfa *, struct sset *, pcolor, chr *, chr *));
 static int lacon _ANSI_ARGS_((struct vars *, struct cnfa *, chr *, pcolor));
 static struct sset *getvacant _ANSI_ARGS_((struct vars *, struct dfa *, chr *, chr *));
 static struct sset *pickss _ANSI_ARGS_((struct vars *, struct dfa *, chr *, chr *));
+static struct sset *clockss _ANSI_ARGS_((struct vars *, struct dfa *, chr *));
+static VOID flushss _ANSI_ARGS_((struct vars *, struct dfa *, chr *));
+/* === rege_lit.c === */
+static chr *litscan _ANSI_ARGS_((struct vars *, chr *, chr *));
+static chr *skipscan _ANSI_ARGS_((struct vars *, chr *, chr *));
+static chr *pfxscan _ANSI_ARGS_((struct vars *, chr *, chr *));
+static int pfxat _ANSI_ARGS_((struct vars *, chr *, chr *));
+static chr *strscan _ANSI_ARGS_((chr *, chr *, chr *, int, int));
+static chr *chrscan _ANSI_ARGS_((chr *, chr *, pchr));
+/* === rege_one.c === */
+static int onewalk _ANSI_ARGS_((struct vars *, chr *, chr *));
+/* === rege_nfa.c === */
+static chr *nlongest _ANSI_ARGS_((struct vars *, struct dfa *, chr *, chr *, int *));
+static chr *nshortest _ANSI_ARGS_((struct vars *, struct dfa *, chr *, chr *, chr *, chr **, int *));
+static VOID nstart _ANSI_ARGS_((struct dfa *, unsigned *));
+static int nstep _ANSI_ARGS_((struct vars *, struct dfa *, unsigned *, unsigned *, pcolor, chr *));
+/* === rege_bit.c === */
+static chr *blongest _ANSI_ARGS_((struct vars *, struct dfa *, chr *, chr *, int *));
+static chr *bshortest _ANSI_ARGS_((struct vars *, struct dfa *, chr *, chr *, chr *, chr **, int *));
+static bpword bfollow _ANSI_ARGS_((struct bpnfa *, bpword));
+/* === rege_set.c === */
+static VOID setscan _ANSI_ARGS_((struct vars *, struct dfa *, char *, size_t));
+static VOID nsetscan _ANSI_ARGS_((struct vars *, struct dfa *, chr *, int, char *, size_t));
+static int setnote _ANSI_ARGS_((struct vars *, unsigned *, int, char *, size_t));
+static int setcheck _ANSI_ARGS_((struct vars *, int));
+/* === rege_par.c === */
+static int parfind _ANSI_ARGS_((struct vars *, size_t, regmatch_t []));
+static PVOID parwork _ANSI_ARGS_((PVOID));
+static VOID parpiece _ANSI_ARGS_((struct par *, struct vars *, int));
+static VOID parsettle _ANSI_ARGS_((struct par *, int));
+#ifndef REG_CHR8
+/* === rege_utf.c === */
+static VOID utffeed _ANSI_ARGS_((struct stream *, CONST unsigned char *, size_t, int));
+static size_t utfdecode _ANSI_ARGS_((CONST unsigned char *, size_t, int, chr *, regoff_t *, regoff_t, size_t *));
+#endif
 /* automatically gathered by fwd; do not hand-edit */
 /* =====^!^===== end forwards =====^!^===== */
 
@@ -186,24 +443,19 @@ int flags;
 #	define	LOCALMEM	40
 	regoff_t mem[LOCALMEM];
 
-	/* sanity checks */
-	if (re == NULL || string == NULL || re->re_magic != REMAGIC)
-		return REG_INVARG;
-	if (re->re_csize != sizeof(chr))
-		return REG_MIXED;
-
 	/* setup */
-	v->re = re;
-	v->g = (struct guts *)re->re_guts;
-	if ((v->g->cflags&REG_EXPECT) && details == NULL)
-		return REG_INVARG;
+	st = setup(v, re, string, len, details, flags);
+	if (st != REG_OKAY)
+		return st;
+	if (v->g->nset > 0)
+		return REG_INVARG;	/* a set, see regsetexec() */
 	if (v->g->info&REG_UIMPOSSIBLE)
 		return REG_NOMATCH;
+	if (len < (size_t)v->g->minlen && !(v->g->cflags&REG_EXPECT))
+		return REG_NOMATCH;	/* too short to hold a match */
 	backref = (v->g->info&REG_UBACKREF) ? 1 : 0;
-	v->eflags = flags;
 	if (v->g->cflags&REG_NOSUB)
 		nmatch = 0;		/* override client */
-	v->nmatch = nmatch;
 	if (backref) {
 		/* need work area */
 		if (v->g->nsub + 1 <= LOCALMAT)
@@ -213,14 +465,6 @@ int flags;
 							sizeof(regmatch_t));
 		if (v->pmatch == NULL)
 			return REG_ESPACE;
-		v->nmatch = v->g->nsub + 1;
-	} else
-		v->pmatch = pmatch;
-	v->details = details;
-	v->start = (chr *)string;
-	v->stop = (chr *)string + len;
-	v->err = 0;
-	if (backref) {
 		/* need retry memory */
 		assert(v->g->ntree >= 0);
 		n = (size_t)v->g->ntree;
@@ -229,35 +473,911 @@ int flags;
 		else
 			v->mem = (regoff_t *)MALLOC(n*sizeof(regoff_t));
 		if (v->mem == NULL) {
-			if (v->pmatch != pmatch && v->pmatch != mat)
+			if (v->pmatch != mat)
 				FREE(v->pmatch);
 			return REG_ESPACE;
 		}
-	} else
-		v->mem = NULL;
+	}
 
 	/* do it */
+	if (USEPAR(v))
+		st = parfind(v, nmatch, pmatch);
+	else
+		st = dofind(v, nmatch, pmatch);
+
+	/* report, and clean up */
+	report(v);
+	finish(v);
+	if (backref && v->pmatch != mat)
+		FREE(v->pmatch);
+	if (v->mem != NULL && v->mem != mem)
+		FREE(v->mem);
+	return st;
+}
+
+/*
+ - setup - check exec's arguments and fill in the vars for them
+ * Everything but the match vector and the backtracking memory, which
+ * are up to the caller.
+ ^ static int setup(struct vars *, regex_t *, CONST chr *, size_t,
+ ^ 	rm_detail_t *, int);
+ */
+static int
+setup(v, re, string, len, details, flags)
+struct vars *v;
+regex_t *re;
+CONST chr *string;
+size_t len;
+rm_detail_t *details;
+int flags;
+{
+	int i;
+
+	/* sanity checks */
+	if (re == NULL || string == NULL || re->re_magic != REMAGIC)
+		return REG_INVARG;
+	if (re->re_csize != sizeof(chr))
+		return REG_MIXED;
+
+	v->re = re;
+	v->g = (struct guts *)re->re_guts;
+	if ((v->g->cflags&REG_EXPECT) && details == NULL)
+		return REG_INVARG;
+	v->cbudget = v->g->cache.rc_budget;
+	v->cpolicy = v->g->cache.rc_policy;
+	if (flags&REG_CACHE) {
+		if (details == NULL)
+			return REG_INVARG;
+		if (details->rm_cache.rc_budget != 0)
+			v->cbudget = details->rm_cache.rc_budget;
+		if (details->rm_cache.rc_policy != 0)
+			v->cpolicy = details->rm_cache.rc_policy;
+		details->rm_cache.rc_flushes = 0;
+		details->rm_cache.rc_evictions = 0;
+	}
+	if (v->cpolicy == 0)
+		v->cpolicy = REG_CSCAN;
+	if (v->cpolicy < REG_CSCAN || v->cpolicy > REG_CFLUSH)
+		return REG_INVARG;
+	v->nflushes = 0;
+	v->nevictions = 0;
+	v->dfafull = 0;
+	v->steps = 0;
+	v->maxsteps = LONG_MAX;
+	v->cancel = NULL;
+	if (flags&REG_LIMIT) {
+		if (details == NULL || details->rm_limit.rl_steps < 0)
+			return REG_INVARG;
+		if (details->rm_limit.rl_steps > 0)
+			v->maxsteps = details->rm_limit.rl_steps;
+		v->cancel = details->rm_limit.rl_cancel;
+		details->rm_limit.rl_used = 0;
+	}
+	if (flags&REG_PARALLEL) {
+		if (details == NULL || details->rm_par.rp_threads < 0)
+			return REG_INVARG;
+		details->rm_par.rp_pieces = 0;
+	}
+	if (v->g->nlacons > 0) {
+		for (i = 0; i < NLADFAS; i++)
+			v->ladfas[i] = NULL;
+		for (i = 0; i < LAMEMO; i++)
+			v->lamemo[i].cp = NULL;
+	}
+	v->eflags = flags;
+	v->nmatch = 0;
+	v->pmatch = NULL;
+	v->details = details;
+	v->start = (chr *)string;
+	v->stop = (chr *)string + len;
+	v->from = v->start;
+	v->bound = NULL;
+	v->npieces = 1;
+	v->err = 0;
+	v->mem = NULL;
+	v->fails = NULL;
+	return REG_OKAY;
+}
+
+/*
+ - dofind - find the first match at or after v->from
+ * With backreferences, v->pmatch and v->mem must already be work areas.
+ ^ static int dofind(struct vars *, size_t, regmatch_t []);
+ */
+static int
+dofind(v, nmatch, pmatch)
+struct vars *v;
+size_t nmatch;
+regmatch_t pmatch[];
+{
+	int st;
+	size_t n;
+	int backref = (v->g->info&REG_UBACKREF) ? 1 : 0;
+
+	if (backref) {
+		assert(v->pmatch != NULL && v->pmatch != pmatch);
+		assert(v->mem != NULL);
+		v->nmatch = v->g->nsub + 1;
+	} else {
+		v->pmatch = pmatch;
+		v->nmatch = nmatch;
+	}
+
 	assert(v->g->tree != NULL);
 	if (backref)
 		st = cfind(v, &v->g->tree->cnfa, &v->g->cmap);
+	else if (USEONE(v))
+		st = (v->from == v->start) ? onewalk(v, v->start, (chr *)NULL) :
+								REG_NOMATCH;
 	else
 		st = find(v, &v->g->tree->cnfa, &v->g->cmap);
 
+	if (ISERR())		/* e.g. over the limit, which can look like a miss */
+		st = v->err;
+
 	/* copy (portion of) match vector over if necessary */
 	if (st == REG_OKAY && v->pmatch != pmatch && nmatch > 0) {
 		zapsubs(pmatch, nmatch);
 		n = (nmatch < v->nmatch) ? nmatch : v->nmatch;
 		memcpy(VS(pmatch), VS(v->pmatch), n*sizeof(regmatch_t));
 	}
+	return st;
+}
 
-	/* clean up */
-	if (v->pmatch != pmatch && v->pmatch != mat)
-		FREE(v->pmatch);
-	if (v->mem != NULL && v->mem != mem)
-		FREE(v->mem);
+/*
+ - report - fill in the counts the client asked for in details
+ ^ static VOID report(struct vars *);
+ */
+static VOID
+report(v)
+struct vars *v;
+{
+	if (v->eflags&REG_CACHE) {
+		v->details->rm_cache.rc_flushes = v->nflushes;
+		v->details->rm_cache.rc_evictions = v->nevictions;
+	}
+	if (v->eflags&REG_LIMIT)
+		v->details->rm_limit.rl_used = v->steps;
+	if (v->eflags&REG_PARALLEL)
+		v->details->rm_par.rp_pieces = v->npieces;
+}
+
+/*
+ - finish - add up cache churn and let go of what setup() and the match took
+ ^ static VOID finish(struct vars *);
+ */
+static VOID
+finish(v)
+struct vars *v;
+{
+	int i;
+
+	if (v->nflushes != 0)
+		ATOMADD(&v->g->cache.rc_flushes, v->nflushes);
+	if (v->nevictions != 0)
+		ATOMADD(&v->g->cache.rc_evictions, v->nevictions);
+	for (i = 1; i < v->g->nlacons && i < NLADFAS; i++)
+		if (v->ladfas[i] != NULL)
+			putdfa(v, DFALACON(v->g, i), v->ladfas[i]);
+	if (v->fails != NULL)
+		FREE(v->fails);
+}
+
+/*
+ - regbegin - start going through the matches of an RE in one string
+ * The DFAs, the lookahead and failure memos, and the work limit last
+ * from one regnext() to the next, rather than being rebuilt for each
+ * match.  The regex must not be freed or retuned until regend().
+ ^ int regbegin(regiter_t *, regex_t *, CONST chr *, size_t,
+ ^ 					rm_detail_t *, int);
+ */
+int
+regbegin(it, re, string, len, details, flags)
+regiter_t *it;
+regex_t *re;
+CONST chr *string;
+size_t len;
+rm_detail_t *details;
+int flags;
+{
+	struct iter *i;
+	struct vars *v;
+	int st;
+	size_t n;
+
+	if (it == NULL)
+		return REG_INVARG;
+	it->ri_magic = 0;
+	i = (struct iter *)MALLOC(sizeof(struct iter));
+	if (i == NULL)
+		return REG_ESPACE;
+	v = &i->var;
+	st = setup(v, re, string, len, details, flags);
+	if (st == REG_OKAY && v->g->nset > 0)
+		st = REG_INVARG;
+	if (st != REG_OKAY) {
+		FREE(i);
+		return st;
+	}
+	i->pmatch = NULL;
+	i->mem = NULL;
+	if (v->g->info&REG_UBACKREF) {
+		/* work area and retry memory, once for all the matches */
+		i->pmatch = (regmatch_t *)MALLOC((v->g->nsub + 1) *
+							sizeof(regmatch_t));
+		assert(v->g->ntree >= 0);
+		n = (v->g->ntree > 0) ? (size_t)v->g->ntree : 1;
+		i->mem = (regoff_t *)MALLOC(n*sizeof(regoff_t));
+		if (i->pmatch == NULL || i->mem == NULL) {
+			if (i->pmatch != NULL)
+				FREE(i->pmatch);
+			if (i->mem != NULL)
+				FREE(i->mem);
+			FREE(i);
+			return REG_ESPACE;
+		}
+		v->pmatch = i->pmatch;
+		v->mem = i->mem;
+	}
+	i->done = (v->g->info&REG_UIMPOSSIBLE) ? 1 : 0;
+	it->ri_magic = ITMAGIC;
+	it->ri_guts = (char *)i;
+	return REG_OKAY;
+}
+
+/*
+ - regnext - find the next match in an iteration
+ * The search picks up where the last match ended, with the chrs before
+ * it still there for ^, \m, \y and the like to look at.  An empty match
+ * moves the next search on by a chr, so every position gets its turn
+ * and none is reported twice.  Even with nmatch 0 (or REG_NOSUB) the
+ * match is pinned down, since the next search starts from its end.
+ ^ int regnext(regiter_t *, size_t, regmatch_t []);
+ */
+int
+regnext(it, nmatch, pmatch)
+regiter_t *it;
+size_t nmatch;
+regmatch_t pmatch[];
+{
+	struct iter *i;
+	struct vars *v;
+	regmatch_t whole;
+	regmatch_t *pm = pmatch;
+	size_t n = nmatch;
+	int st;
+
+	if (it == NULL || it->ri_magic != ITMAGIC)
+		return REG_INVARG;
+	i = (struct iter *)it->ri_guts;
+	v = &i->var;
+	if (i->done)
+		return REG_NOMATCH;
+	if (nmatch > 0 && pmatch == NULL)
+		return REG_INVARG;
+	if (v->stop - v->from < v->g->minlen && !(v->g->cflags&REG_EXPECT)) {
+		i->done = 1;
+		return REG_NOMATCH;	/* too little left to hold a match */
+	}
+	if (n > 1 && (v->g->cflags&REG_NOSUB)) {
+		zapsubs(pmatch, nmatch);
+		n = 1;			/* override client, but for the match */
+	} else if (n == 0) {
+		pm = &whole;
+		n = 1;
+	}
+
+	st = dofind(v, n, pm);
+	report(v);
+	if (st != REG_OKAY) {
+		i->done = 1;
+		return st;
+	}
+
+	/* and on to the next */
+	assert(pm[0].rm_so >= 0 && pm[0].rm_eo >= pm[0].rm_so);
+	v->from = v->start + pm[0].rm_eo;
+	if (pm[0].rm_eo == pm[0].rm_so) {	/* empty, don't stay put */
+		if (v->from == v->stop)
+			i->done = 1;
+		else
+			v->from++;
+	}
+	return REG_OKAY;
+}
+
+/*
+ - regend - finish an iteration, whether or not it has run out
+ * Ignoring invocation with NULL, or twice, is a convenience.
+ ^ VOID regend(regiter_t *);
+ */
+VOID
+regend(it)
+regiter_t *it;
+{
+	struct iter *i;
+
+	if (it == NULL || it->ri_magic != ITMAGIC)
+		return;
+	i = (struct iter *)it->ri_guts;
+	finish(&i->var);
+	if (i->pmatch != NULL)
+		FREE(i->pmatch);
+	if (i->mem != NULL)
+		FREE(i->mem);
+	FREE(i);
+	it->ri_magic = 0;
+	it->ri_guts = NULL;
+}
+
+/*
+ - regsbegin - start matching an RE against text that comes in chunks
+ * Matches are found as soon as the text seen settles them, and are
+ * reported with offsets from the start of the whole stream.  Only the
+ * text a match might still start in is held on to, at most max chrs of
+ * it (0 for a default); a stretch that could still turn into a match,
+ * and is longer than that, is REG_ESPACE.  The search state is carried
+ * from chunk to chunk, so each chr is searched once however it arrives.
+ * REs with lookahead constraints, which may look past any chunk, and
+ * REG_EXPECT, whose report is what the stream does for itself, aren't
+ * handled.
+ ^ int regsbegin(regstream_t *, regex_t *, size_t, rm_detail_t *, int);
+ */
+int
+regsbegin(rs, re, max, details, flags)
+regstream_t *rs;
+regex_t *re;
+size_t max;			/* most chrs held at once, 0 for default */
+rm_detail_t *details;
+int flags;
+{
+	struct stream *s;
+	struct vars *v;
+	chr none = 0;		/* no text yet, see below */
+	int st;
+
+	if (rs == NULL)
+		return REG_INVARG;
+	rs->rs_magic = 0;
+	s = (struct stream *)MALLOC(sizeof(struct stream));
+	if (s == NULL)
+		return REG_ESPACE;
+	s->max = (max != 0) ? max : STREAMMAX;
+	s->nbuf = 0;
+	s->abuf = (s->max < STREAMBUF) ? s->max : STREAMBUF;
+	s->buf = (chr *)MALLOC(s->abuf * sizeof(chr));
+	if (s->buf == NULL) {
+		FREE(s);
+		return REG_ESPACE;
+	}
+	v = &s->var;
+	st = setup(v, re, &none, (size_t)0, details, flags);
+	if (st == REG_OKAY && v->g->nset > 0)
+		st = REG_INVARG;
+	if (st == REG_OKAY && (re->re_info&REG_ULOOKAHEAD))
+		st = REG_INVARG;
+	if (st == REG_OKAY && (v->g->cflags&REG_EXPECT))
+		st = REG_INVARG;
+	if (st != REG_OKAY) {
+		FREE(s->buf);
+		FREE(s);
+		return st;
+	}
+	v->start = v->stop = v->from = s->buf;	/* regsnext() redoes these */
+	s->pmatch = NULL;
+	s->mem = NULL;
+	s->utf8 = 0;
+	s->boff = NULL;
+	s->bnext = 0;
+	s->npend = 0;
+	s->d = newdfa(v, &v->g->search, &v->g->cmap, DOMALLOC);
+	if (s->d != NULL && (v->g->info&REG_UBACKREF)) {
+		/* work area and retry memory, as for an iteration */
+		s->pmatch = (regmatch_t *)MALLOC((v->g->nsub + 1) *
+							sizeof(regmatch_t));
+		s->mem = (regoff_t *)MALLOC(((v->g->ntree > 0) ?
+				(size_t)v->g->ntree : 1) * sizeof(regoff_t));
+		if (s->pmatch == NULL || s->mem == NULL)
+			ERR(REG_ESPACE);
+		v->pmatch = s->pmatch;
+		v->mem = s->mem;
+	}
+	if (ISERR()) {
+		st = v->err;
+		finish(v);
+		if (s->d != NULL)
+			freedfa(s->d);
+		if (s->pmatch != NULL)
+			FREE(s->pmatch);
+		if (s->mem != NULL)
+			FREE(s->mem);
+		FREE(s->buf);
+		FREE(s);
+		return st;
+	}
+	s->css = NULL;
+	s->base = 0;
+	s->scanned = 0;
+	s->cold = 0;
+	s->close = 0;
+	s->found = 0;
+	s->last = 0;
+	s->done = (v->g->info&REG_UIMPOSSIBLE) ? 1 : 0;
+	rs->rs_magic = STMAGIC;
+	rs->rs_guts = (char *)s;
+	return REG_OKAY;
+}
+
+/*
+ - regsfeed - hand a stream its next chunk of text
+ * The text is copied; last says it's the end of the stream.  Call
+ * regsnext() until REG_NOMATCH before feeding more, or the text not yet
+ * looked at piles up.
+ ^ int regsfeed(regstream_t *, CONST chr *, size_t, int);
+ */
+int
+regsfeed(rs, chunk, len, last)
+regstream_t *rs;
+CONST chr *chunk;
+size_t len;
+int last;			/* no more text after this */
+{
+	struct stream *s;
+	int st;
+
+	if (rs == NULL || rs->rs_magic != STMAGIC || (chunk == NULL && len > 0))
+		return REG_INVARG;
+	s = (struct stream *)rs->rs_guts;
+	if (s->last || s->utf8 > 0)
+		return REG_INVARG;
+	s->utf8 = -1;
+	if (s->done) {			/* nothing more to look at */
+		s->base += s->nbuf + len;
+		s->nbuf = 0;
+		s->last = last;
+		return REG_OKAY;
+	}
+
+	st = room(s, len);
+	if (st != REG_OKAY)
+		return st;
+	if (len > 0)
+		memcpy(VS(s->buf + s->nbuf), VS(chunk), len * sizeof(chr));
+	s->nbuf += len;
+	s->last = last;
+	return REG_OKAY;
+}
+
+#ifndef REG_CHR8
+/*
+ - regsfeedu - hand a stream its next chunk of text, in UTF-8
+ * As regsfeed(), but the stream's offsets are then in bytes.  Chunks
+ * may split a UTF-8 sequence; a stream can't take both kinds.
+ ^ int regsfeedu(regstream_t *, CONST char *, size_t, int);
+ */
+int
+regsfeedu(rs, chunk, len, last)
+regstream_t *rs;
+CONST char *chunk;
+size_t len;
+int last;			/* no more text after this */
+{
+	struct stream *s;
+	int st;
+
+	if (rs == NULL || rs->rs_magic != STMAGIC || (chunk == NULL && len > 0))
+		return REG_INVARG;
+	s = (struct stream *)rs->rs_guts;
+	if (s->last || s->utf8 < 0)
+		return REG_INVARG;
+	if (s->utf8 == 0) {
+		s->boff = (regoff_t *)MALLOC(s->abuf * sizeof(regoff_t));
+		if (s->boff == NULL)
+			return REG_ESPACE;
+		s->utf8 = 1;
+	}
+	if (s->done) {
+		s->nbuf = 0;
+		s->last = last;
+		return REG_OKAY;
+	}
+
+	st = room(s, len + s->npend);	/* never more chrs than bytes */
+	if (st != REG_OKAY)
+		return st;
+	utffeed(s, (CONST unsigned char *)chunk, len, last);
+	s->last = last;
+	return REG_OKAY;
+}
+
+#endif
+
+/*
+ - room - make room at the end of a stream's text for len more chrs
+ * First let go of what no match can start in, but for a chr of context.
+ ^ static int room(struct stream *, size_t);
+ */
+static int
+room(s, len)
+struct stream *s;
+size_t len;
+{
+	size_t keep;
+	size_t n;
+	chr *p;
+	regoff_t *o;
+
+	keep = (s->cold > 0) ? s->cold - 1 : 0;
+	if (keep > 0) {
+		memmove(VS(s->buf), VS(s->buf + keep),
+					(s->nbuf - keep) * sizeof(chr));
+		if (s->boff != NULL)
+			memmove(VS(s->boff), VS(s->boff + keep),
+					(s->nbuf - keep) * sizeof(regoff_t));
+		s->nbuf -= keep;
+		s->base += keep;
+		s->scanned -= keep;
+		s->cold -= keep;
+	}
+
+	if (len > s->max - s->nbuf)
+		return REG_ESPACE;
+	if (s->nbuf + len <= s->abuf)
+		return REG_OKAY;
+	for (n = s->abuf; n < s->nbuf + len; n *= 2)
+		continue;
+	if (n > s->max)
+		n = s->max;
+	p = (chr *)REALLOC(s->buf, n * sizeof(chr));
+	if (p == NULL)
+		return REG_ESPACE;
+	s->buf = p;
+	if (s->boff != NULL) {
+		o = (regoff_t *)REALLOC(s->boff, n * sizeof(regoff_t));
+		if (o == NULL)
+			return REG_ESPACE;	/* buf is merely roomier */
+		s->boff = o;
+	}
+	s->abuf = n;
+	return REG_OKAY;
+}
+
+/*
+ - regsnext - report the next match settled by the text fed so far
+ * REG_NOMATCH means none yet, or none ever once the last chunk is in.
+ * Offsets are from the start of the stream; the next search starts
+ * where the match ended, a chr later if it was empty, as in regnext().
+ ^ int regsnext(regstream_t *, size_t, regmatch_t []);
+ */
+int
+regsnext(rs, nmatch, pmatch)
+regstream_t *rs;
+size_t nmatch;
+regmatch_t pmatch[];
+{
+	struct stream *s;
+	struct vars *v;
+	regmatch_t whole;
+	regmatch_t *pm = pmatch;
+	size_t n = nmatch;
+	size_t i;
+	int st;
+
+	if (rs == NULL || rs->rs_magic != STMAGIC)
+		return REG_INVARG;
+	s = (struct stream *)rs->rs_guts;
+	v = &s->var;
+	if (nmatch > 0 && pmatch == NULL)
+		return REG_INVARG;
+	if (n > 1 && (v->g->cflags&REG_NOSUB)) {
+		zapsubs(pmatch, nmatch);
+		n = 1;			/* override client, but for the match */
+	} else if (n == 0) {
+		pm = &whole;
+		n = 1;
+	}
+
+	for (;;) {
+		if (s->done)
+			return REG_NOMATCH;
+		v->start = s->buf;
+		v->stop = s->buf + s->nbuf;
+		v->from = v->start + s->scanned;
+		if (!resume(v, s)) {
+			report(v);
+			if (ISERR()) {
+				s->done = 1;
+				return v->err;
+			}
+			if (s->last)
+				s->done = 1;
+			return REG_NOMATCH;
+		}
+
+		/* a match lies in [cold, close), and that's all it needs */
+		v->from = v->start + s->cold;
+		v->stop = v->start + s->close;
+		st = dofind(v, n, pm);
+		if (v->fails != NULL) {		/* its offsets won't hold */
+			FREE(v->fails);
+			v->fails = NULL;
+		}
+		report(v);
+		s->css = NULL;
+		s->found = 0;
+		if (st == REG_NOMATCH) {	/* backreferences said no */
+			s->scanned = s->close;
+			continue;	/* NOTE CONTINUE */
+		}
+		if (st != REG_OKAY) {
+			s->done = 1;
+			return st;
+		}
+
+		/* on past it, and make it the stream's */
+		s->scanned = (size_t)pm[0].rm_eo;
+		if (pm[0].rm_eo == pm[0].rm_so) {	/* empty, don't stay put */
+			if (s->scanned < s->nbuf)
+				s->scanned++;
+			else {
+				assert(s->last);	/* else it wasn't settled */
+				s->done = 1;
+			}
+		}
+		s->cold = s->scanned;
+		for (i = 0; i < n; i++)
+			if (pm[i].rm_so >= 0) {
+				pm[i].rm_so = soff(s, pm[i].rm_so);
+				pm[i].rm_eo = soff(s, pm[i].rm_eo);
+			}
+		return REG_OKAY;
+	}
+}
+
+/*
+ - regsend - finish with a stream
+ * Ignoring invocation with NULL, or twice, is a convenience.
+ ^ VOID regsend(regstream_t *);
+ */
+VOID
+regsend(rs)
+regstream_t *rs;
+{
+	struct stream *s;
+
+	if (rs == NULL || rs->rs_magic != STMAGIC)
+		return;
+	s = (struct stream *)rs->rs_guts;
+	finish(&s->var);
+	freedfa(s->d);
+	if (s->pmatch != NULL)
+		FREE(s->pmatch);
+	if (s->mem != NULL)
+		FREE(s->mem);
+	if (s->boff != NULL)
+		FREE(s->boff);
+	FREE(s->buf);
+	FREE(s);
+	rs->rs_magic = 0;
+	rs->rs_guts = NULL;
+}
+
+/*
+ - soff - turn an index in a stream's text into an offset in the stream
+ ^ static regoff_t soff(struct stream *, regoff_t);
+ */
+static regoff_t
+soff(s, i)
+struct stream *s;
+regoff_t i;
+{
+	if (s->utf8 <= 0)
+		return (regoff_t)s->base + i;
+	return ((size_t)i < s->nbuf) ? s->boff[i] : (regoff_t)s->bnext;
+}
+
+#ifndef REG_CHR8
+/*
+ - regexecu - match regular expression against UTF-8 text
+ * Offsets are in bytes.  The text goes through a stream a chunk at a
+ * time, so only what a match might still start in is held decoded.
+ * REs a stream won't take (lookahead constraints, REG_EXPECT) get the
+ * whole of it decoded for exec(), a chr and a regoff_t for each byte of
+ * ASCII:  10 bytes of memory per byte of text with 64-bit offsets.
+ ^ int regexecu(regex_t *, CONST char *, size_t, rm_detail_t *,
+ ^					size_t, regmatch_t [], int);
+ */
+int
+regexecu(re, string, len, details, nmatch, pmatch, flags)
+regex_t *re;
+CONST char *string;
+size_t len;
+rm_detail_t *details;
+size_t nmatch;
+regmatch_t pmatch[];
+int flags;
+{
+	regstream_t rs;
+	chr *buf;
+	regoff_t *offs;
+	size_t n;
+	size_t i;
+	size_t k;
+	int st;
+
+	/* sanity checks */
+	if (re == NULL || string == NULL || re->re_magic != REMAGIC)
+		return REG_INVARG;
+	if (re->re_csize != sizeof(chr))
+		return REG_MIXED;
+
+	st = regsbegin(&rs, re, len + 1, details, flags);
+	if (st == REG_OKAY) {
+		for (i = 0; ; i += k) {
+			k = (len - i < UTFCHUNK) ? len - i : UTFCHUNK;
+			st = regsfeedu(&rs, string + i, k, i + k == len);
+			if (st == REG_OKAY)
+				st = regsnext(&rs, nmatch, pmatch);
+			if (st != REG_NOMATCH || i + k == len)
+				break;		/* NOTE BREAK OUT */
+		}
+		regsend(&rs);
+		return st;
+	}
+	if (!(re->re_info&REG_ULOOKAHEAD) &&
+			!(((struct guts *)re->re_guts)->cflags&REG_EXPECT))
+		return st;
+
+	/* the hard way */
+	buf = (chr *)MALLOC((len + 1) * sizeof(chr));
+	offs = (regoff_t *)MALLOC((len + 1) * sizeof(regoff_t));
+	if (buf == NULL || offs == NULL) {
+		if (buf != NULL)
+			FREE(buf);
+		if (offs != NULL)
+			FREE(offs);
+		return REG_ESPACE;
+	}
+	n = utfdecode((CONST unsigned char *)string, len, 1, buf, offs,
+							(regoff_t)0, &k);
+	assert(k == len);
+	offs[n] = (regoff_t)len;
+	if (details != NULL) {		/* so we know if exec() set it */
+		details->rm_extend.rm_so = -1;
+		details->rm_extend.rm_eo = -1;
+	}
+	st = exec(re, buf, n, details, nmatch, pmatch, flags);
+	if (st == REG_OKAY && !(((struct guts *)re->re_guts)->cflags&REG_NOSUB))
+		for (i = 0; i < nmatch; i++)
+			if (pmatch[i].rm_so >= 0) {
+				pmatch[i].rm_so = offs[pmatch[i].rm_so];
+				pmatch[i].rm_eo = offs[pmatch[i].rm_eo];
+			}
+	if (details != NULL && details->rm_extend.rm_so >= 0) {
+		details->rm_extend.rm_so = offs[details->rm_extend.rm_so];
+		details->rm_extend.rm_eo = offs[details->rm_extend.rm_eo];
+	}
+	FREE(buf);
+	FREE(offs);
 	return st;
 }
 
+#endif
+
+/*
+ - regsetexec - find which REs of a set (see regsetcomp()) match a string
+ * The numbers of the REs that match go into hits[] in increasing order,
+ * as many as there is room for, and -1 fills the rest.  The string is
+ * scanned once, and only as far as it takes to settle those:  with
+ * nhits 1 the scan can stop once the lowest-numbered match is known, and
+ * with nhits 0, when only whether any RE matches is wanted, at the first.
+ ^ int regsetexec(regex_t *, CONST chr *, size_t, rm_detail_t *,
+ ^					size_t, int [], int);
+ */
+int
+regsetexec(re, string, len, details, nhits, hits, flags)
+regex_t *re;
+CONST chr *string;
+size_t len;
+rm_detail_t *details;
+size_t nhits;
+int hits[];
+int flags;
+{
+	struct vars var;
+	register struct vars *v = &var;
+	struct dfa *d;
+	char *found;
+	int st;
+	int i;
+	size_t n;
+
+	/* setup */
+	if (nhits > 0 && hits == NULL)
+		return REG_INVARG;
+	st = setup(v, re, string, len, details, flags);
+	if (st != REG_OKAY)
+		return st;
+	if (v->g->nset == 0)
+		return REG_INVARG;	/* not a set */
+	for (n = 0; n < nhits; n++)
+		hits[n] = -1;
+	found = (char *)MALLOC(v->g->nset);
+	if (found == NULL)
+		return REG_ESPACE;
+	for (i = 0; i < v->g->nset; i++)
+		found[i] = 0;
+
+	/* do it */
+	d = getdfa(v, DFASEARCH, &v->g->search, &v->dfa1);
+	if (d == NULL)
+		ERR(REG_ESPACE);
+	else {
+		setscan(v, d, found, nhits);
+		putdfa(v, DFASEARCH, d);
+	}
+	if (ISERR())
+		st = v->err;
+	else {
+		st = REG_NOMATCH;
+		for (i = 0, n = 0; i < v->g->nset; i++)
+			if (found[i] > 0) {
+				st = REG_OKAY;
+				if (n < nhits)
+					hits[n++] = i;
+			}
+	}
+
+	/* report, and clean up */
+	report(v);
+	finish(v);
+	FREE(found);
+	return st;
+}
+
+/*
+ - regtune - set a regex's default state-set cache budget and policy
+ * Only rc_budget and rc_policy are looked at.  DFAs already cached for
+ * the regex are replaced as they come into use.  Don't call this while
+ * other threads are matching with the regex.
+ ^ int regtune(regex_t *, CONST rm_cache_t *);
+ */
+int
+regtune(re, rc)
+regex_t *re;
+CONST rm_cache_t *rc;
+{
+	struct guts *g;
+
+	if (re == NULL || rc == NULL || re->re_magic != REMAGIC)
+		return REG_INVARG;
+	if (re->re_csize != sizeof(chr))
+		return REG_MIXED;
+	if (rc->rc_policy < 0 || rc->rc_policy > REG_CFLUSH)
+		return REG_INVARG;
+	g = (struct guts *)re->re_guts;
+	g->cache.rc_budget = rc->rc_budget;
+	g->cache.rc_policy = rc->rc_policy;
+	return REG_OKAY;
+}
+
+/*
+ - regstats - report a regex's cache tuning and its counts so far
+ ^ int regstats(CONST regex_t *, rm_cache_t *);
+ */
+int
+regstats(re, rc)
+CONST regex_t *re;
+rm_cache_t *rc;
+{
+	if (re == NULL || rc == NULL || re->re_magic != REMAGIC)
+		return REG_INVARG;
+	if (re->re_csize != sizeof(chr))
+		return REG_MIXED;
+	*rc = ((struct guts *)re->re_guts)->cache;
+	return REG_OKAY;
+}
+
 /*
  - find - find a match for the main NFA (no-complications case)
  ^ static int find(struct vars *, struct cnfa *, struct colormap *);
@@ -270,59 +1390,104 @@ struct colormap *cm;
 {
 	struct dfa *s;
 	struct dfa *d;
+	struct dfa *r;
 	chr *begin;
 	chr *end = NULL;
 	chr *cold;
 	chr *open;		/* open and close of range of possible starts */
 	chr *close;
+	chr *far = NULL;	/* no match starting in the range ends past here */
+	chr *bound = (v->bound != NULL) ? v->bound : v->stop;
+	chr *p;
 	int hitend;
 	int shorter = (v->g->tree->flags&SHORTER) ? 1 : 0;
 
-	/* first, a shot with the search RE */
-	s = newdfa(v, &v->g->search, cm, &v->dfa1);
-	assert(!(ISERR() && s != NULL));
-	NOERR();
-	MDEBUG(("\nsearch at %ld\n", LOFF(v->start)));
-	cold = NULL;
-	close = shortest(v, s, v->start, v->start, v->stop, &cold, (int *)NULL);
-	freedfa(s);
-	NOERR();
-	if (v->g->cflags&REG_EXPECT) {
-		assert(v->details != NULL);
-		if (cold != NULL)
-			v->details->rm_extend.rm_so = OFF(cold);
-		else
-			v->details->rm_extend.rm_so = OFF(v->stop);
-		v->details->rm_extend.rm_eo = OFF(v->stop);	/* unknown */
-	}
-	if (close == NULL)		/* not found */
+	/* no match is possible without the required literal */
+	if (USELIT(v) && litscan(v, v->from, bound) == NULL)
 		return REG_NOMATCH;
-	if (v->nmatch == 0)		/* found, don't need exact location */
-		return REG_OKAY;
+
+	/* first, a shot with the search RE, unless it can only start here */
+	assert(cm == &v->g->cmap);
+	if (ONLYHERE(v)) {
+		MDEBUG(("\nanchored, no search\n"));
+		if (v->from != v->start)
+			return REG_NOMATCH;	/* too late for one */
+		open = v->start;
+		close = v->start;
+	} else {
+		s = getdfa(v, DFASEARCH, &v->g->search, &v->dfa1);
+		assert(!(ISERR() && s != NULL));
+		NOERR();
+		MDEBUG(("\nsearch at %ld\n", LOFF(v->from)));
+		cold = NULL;
+		close = shortest(v, s, v->from, v->from, bound, &cold,
+								(int *)NULL);
+		putdfa(v, DFASEARCH, s);
+		NOERR();
+		if (v->g->cflags&REG_EXPECT) {
+			assert(v->details != NULL);
+			if (cold != NULL)
+				v->details->rm_extend.rm_so = OFF(cold);
+			else
+				v->details->rm_extend.rm_so = OFF(v->stop);
+			v->details->rm_extend.rm_eo = OFF(v->stop);
+		}
+		if (close == NULL)		/* not found */
+			return REG_NOMATCH;
+		if (v->nmatch == 0)	/* found, don't need exact location */
+			return REG_OKAY;
+		assert(cold != NULL);
+		open = cold;
+	}
 
 	/* find starting point and match */
-	assert(cold != NULL);
-	open = cold;
 	cold = NULL;
 	MDEBUG(("between %ld and %ld\n", LOFF(open), LOFF(close)));
-	d = newdfa(v, cnfa, cm, &v->dfa1);
+	d = getdfa(v, v->g->tree->retry, cnfa, &v->dfa1);
 	assert(!(ISERR() && d != NULL));
 	NOERR();
+	r = NULL;
+	end = NULL;
 	for (begin = open; begin <= close; begin++) {
+		if (begin > open && USEREV(v)) {
+			/* rather than trying each in turn, go back for it */
+			if (r == NULL) {
+				far = farthest(v, close);
+				if (far != NULL)
+					r = getdfa(v, DFAREVERSE(v->g),
+						&v->g->reverse, &v->dfa2);
+				if (r == NULL)
+					break;	/* NOTE BREAK OUT */
+			}
+			p = backward(v, r, begin, far);
+			if (ISERR())
+				break;		/* NOTE BREAK OUT */
+			assert(p != NULL);	/* search RE succeeded */
+			if (p != NULL)
+				begin = p;
+		}
 		MDEBUG(("\nfind trying at %ld\n", LOFF(begin)));
 		if (shorter)
 			end = shortest(v, d, begin, begin, v->stop,
 							(chr **)NULL, &hitend);
 		else
 			end = longest(v, d, begin, v->stop, &hitend);
-		NOERR();
+		if (ISERR())
+			break;		/* NOTE BREAK OUT */
 		if (hitend && cold == NULL)
 			cold = begin;
 		if (end != NULL)
 			break;		/* NOTE BREAK OUT */
 	}
-	assert(end != NULL);		/* search RE succeeded so loop should */
-	freedfa(d);
+	/* the DFAs go back even if something went wrong */
+	putdfa(v, v->g->tree->retry, d);
+	if (r != NULL)
+		putdfa(v, DFAREVERSE(v->g), r);
+	NOERR();
+	if (end == NULL) {		/* no search RE to say there was one */
+		assert(ONLYHERE(v));
+		return REG_NOMATCH;
+	}
 
 	/* and pin down details */
 	assert(v->nmatch > 0);
@@ -340,6 +1505,10 @@ struct colormap *cm;
 
 	/* submatches */
 	zapsubs(v->pmatch, v->nmatch);
+	if (v->g->one != NULL && onewalk(v, begin, end) == REG_OKAY)
+		return REG_OKAY;
+	NOERR();
+	assert(v->g->one == NULL);	/* the walk can't miss a real match */
 	return dissect(v, v->g->tree, begin, end);
 }
 
@@ -355,22 +1524,35 @@ struct colormap *cm;
 {
 	struct dfa *s;
 	struct dfa *d;
+	struct dfa *r = NULL;
 	chr *cold;
 	int ret;
 
-	s = newdfa(v, &v->g->search, cm, &v->dfa1);
+	assert(cm == &v->g->cmap);
+	s = getdfa(v, DFASEARCH, &v->g->search, &v->dfa1);
 	NOERR();
-	d = newdfa(v, cnfa, cm, &v->dfa2);
+	d = getdfa(v, v->g->tree->retry, cnfa, &v->dfa2);
 	if (ISERR()) {
 		assert(d == NULL);
-		freedfa(s);
+		putdfa(v, DFASEARCH, s);
 		return v->err;
 	}
+	if (USEREV(v)) {
+		r = getdfa(v, DFAREVERSE(v->g), &v->g->reverse, DOMALLOC);
+		if (ISERR()) {
+			assert(r == NULL);
+			putdfa(v, v->g->tree->retry, d);
+			putdfa(v, DFASEARCH, s);
+			return v->err;
+		}
+	}
 
-	ret = cfindloop(v, cnfa, cm, d, s, &cold);
+	ret = cfindloop(v, cnfa, cm, d, s, r, &cold);
 
-	freedfa(d);
-	freedfa(s);
+	if (r != NULL)
+		putdfa(v, DFAREVERSE(v->g), r);
+	putdfa(v, v->g->tree->retry, d);
+	putdfa(v, DFASEARCH, s);
 	NOERR();
 	if (v->g->cflags&REG_EXPECT) {
 		assert(v->details != NULL);
@@ -385,16 +1567,18 @@ struct colormap *cm;
 
 /*
  - cfindloop - the heart of cfind
+ * If r is non-NULL, it is the reverse NFA's DFA, for skipping starts.
  ^ static int cfindloop(struct vars *, struct cnfa *, struct colormap *,
- ^	struct dfa *, struct dfa *, chr **);
+ ^	struct dfa *, struct dfa *, struct dfa *, chr **);
  */
 static int
-cfindloop(v, cnfa, cm, d, s, coldp)
+cfindloop(v, cnfa, cm, d, s, r, coldp)
 struct vars *v;
 struct cnfa *cnfa;
 struct colormap *cm;
 struct dfa *d;
 struct dfa *s;
+struct dfa *r;
 chr **coldp;			/* where to put coldstart pointer */
 {
 	chr *begin;
@@ -404,13 +1588,18 @@ chr **coldp;			/* where to put coldstart pointer */
 	chr *close;
 	chr *estart;
 	chr *estop;
+	chr *far;		/* no match starting in the range ends past here */
 	int er;
 	int shorter = v->g->tree->flags&SHORTER;
 	int hitend;
 
 	assert(d != NULL && s != NULL);
 	cold = NULL;
-	close = v->start;
+	close = v->from;
+	if (USELIT(v) && litscan(v, close, v->stop) == NULL) {
+		*coldp = cold;
+		return REG_NOMATCH;
+	}
 	do {
 		MDEBUG(("\ncsearch at %ld\n", LOFF(close)));
 		close = shortest(v, s, close, close, v->stop, &cold, (int *)NULL);
@@ -420,7 +1609,21 @@ chr **coldp;			/* where to put coldstart pointer */
 		open = cold;
 		cold = NULL;
 		MDEBUG(("cbetween %ld and %ld\n", LOFF(open), LOFF(close)));
+		far = NULL;
 		for (begin = open; begin <= close; begin++) {
+			if (begin > open && r != NULL) {
+				/* go back for the next possible start */
+				if (far == NULL)
+					far = farthest(v, close);
+				if (ISERR())
+					return v->err;
+				begin = backward(v, r, begin, far);
+				if (ISERR())
+					return v->err;
+				/* past close, leave it to the next search */
+				if (begin == NULL || begin > close)
+					break;		/* NOTE BREAK OUT */
+			}
 			MDEBUG(("\ncfind trying at %ld\n", LOFF(begin)));
 			estart = begin;
 			estop = v->stop;
@@ -431,6 +1634,8 @@ chr **coldp;			/* where to put coldstart pointer */
 				else
 					end = longest(v, d, begin, estop,
 								&hitend);
+				if (ISERR())
+					return v->err;
 				if (hitend && cold == NULL)
 					cold = begin;
 				if (end == NULL)
@@ -469,6 +1674,33 @@ chr **coldp;			/* where to put coldstart pointer */
 	return REG_NOMATCH;
 }
 
+/*
+ - farthest - find how far a match under way at some point could go
+ * Matches starting between the search's open and close all end at or
+ * after close, so a walk of the reverse NFA back from here finds the
+ * leftmost of them in one pass.
+ ^ static chr *farthest(struct vars *, chr *);
+ */
+static chr *			/* NULL on error */
+farthest(v, close)
+struct vars *v;
+chr *close;
+{
+	struct dfa *a;
+	chr *far;
+
+	if (v->g->maxlen >= 0)		/* no match is longer than that */
+		return (v->stop - close > v->g->maxlen) ?
+					close + v->g->maxlen : v->stop;
+	assert(!NULLCNFA(v->g->ahead));
+	a = getdfa(v, DFAAHEAD(v->g), &v->g->ahead, DOMALLOC);
+	if (a == NULL)
+		return NULL;
+	far = reach(v, a, close);
+	putdfa(v, DFAAHEAD(v->g), a);
+	return far;
+}
+
 /*
  - zapsubs - initialize the subexpression matches to "no match"
  ^ static VOID zapsubs(regmatch_t *, size_t);
@@ -598,12 +1830,12 @@ chr *end;			/* end of same */
 	assert(t->left != NULL && t->left->cnfa.nstates > 0);
 	assert(t->right != NULL && t->right->cnfa.nstates > 0);
 
-	d = newdfa(v, &t->left->cnfa, &v->g->cmap, &v->dfa1);
+	d = getdfa(v, t->left->retry, &t->left->cnfa, &v->dfa1);
 	NOERR();
-	d2 = newdfa(v, &t->right->cnfa, &v->g->cmap, &v->dfa2);
+	d2 = getdfa(v, t->right->retry, &t->right->cnfa, &v->dfa2);
 	if (ISERR()) {
 		assert(d2 == NULL);
-		freedfa(d);
+		putdfa(v, t->left->retry, d);
 		return v->err;
 	}
 
@@ -614,8 +1846,8 @@ chr *end;			/* end of same */
 	else
 		mid = longest(v, d, begin, end, (int *)NULL);
 	if (mid == NULL) {
-		freedfa(d);
-		freedfa(d2);
+		putdfa(v, t->left->retry, d);
+		putdfa(v, t->right->retry, d2);
 		return REG_ASSERT;
 	}
 	MDEBUG(("tentative midpoint %ld\n", LOFF(mid)));
@@ -626,8 +1858,8 @@ chr *end;			/* end of same */
 		if (mid == stop) {
 			/* all possibilities exhausted! */
 			MDEBUG(("no midpoint!\n"));
-			freedfa(d);
-			freedfa(d2);
+			putdfa(v, t->left->retry, d);
+			putdfa(v, t->right->retry, d2);
 			return REG_ASSERT;
 		}
 		if (shorter)
@@ -638,8 +1870,8 @@ chr *end;			/* end of same */
 		if (mid == NULL) {
 			/* failed to find a new one! */
 			MDEBUG(("failed midpoint!\n"));
-			freedfa(d);
-			freedfa(d2);
+			putdfa(v, t->left->retry, d);
+			putdfa(v, t->right->retry, d2);
 			return REG_ASSERT;
 		}
 		MDEBUG(("new midpoint %ld\n", LOFF(mid)));
@@ -647,8 +1879,8 @@ chr *end;			/* end of same */
 
 	/* satisfaction */
 	MDEBUG(("successful\n"));
-	freedfa(d);
-	freedfa(d2);
+	putdfa(v, t->left->retry, d);
+	putdfa(v, t->right->retry, d2);
 	i = dissect(v, t->left, begin, mid);
 	if (i != REG_OKAY)
 		return i;
@@ -675,15 +1907,15 @@ chr *end;			/* end of same */
 	for (i = 0; t != NULL; t = t->right, i++) {
 		MDEBUG(("trying %dth\n", i));
 		assert(t->left != NULL && t->left->cnfa.nstates > 0);
-		d = newdfa(v, &t->left->cnfa, &v->g->cmap, &v->dfa1);
+		d = getdfa(v, t->left->retry, &t->left->cnfa, &v->dfa1);
 		if (ISERR())
 			return v->err;
 		if (longest(v, d, begin, end, (int *)NULL) == end) {
 			MDEBUG(("success\n"));
-			freedfa(d);
+			putdfa(v, t->left->retry, d);
 			return dissect(v, t->left, begin, end);
 		}
-		freedfa(d);
+		putdfa(v, t->left->retry, d);
 	}
 	return REG_ASSERT;	/* none of them matched?!? */
 }
@@ -702,9 +1934,29 @@ chr *begin;			/* beginning of relevant substring */
 chr *end;			/* end of same */
 {
 	int er;
+	int fresh;
+	struct fail key;
 
 	assert(t != NULL);
 	MDEBUG(("cdissect %ld-%ld %c\n", LOFF(begin), LOFF(end), t->op));
+	if (SPEND(v, 1))
+		return v->err;
+
+	/*
+	 * A fresh try at a split that failed before would fail again.  Not
+	 * if it captures, though:  a failed try can leave captures set, and
+	 * backrefs elsewhere can see them.
+	 */
+	fresh = 0;
+	if ((t->op == '.' || t->op == '|') && !(t->flags&CAP) &&
+			!(v->eflags&REG_NOMEMO) && v->mem[t->retry] == 0 &&
+			failkey(v, t, begin, end, &key)) {
+		if (failed(v, &key)) {
+			MDEBUG(("%d known failure\n", t->retry));
+			return REG_NOMATCH;
+		}
+		fresh = 1;
+	}
 
 	switch (t->op) {
 	case '=':		/* terminal node */
@@ -713,7 +1965,7 @@ chr *end;			/* end of same */
 		break;
 	case '|':		/* alternation */
 		assert(t->left != NULL);
-		return caltdissect(v, t, begin, end);
+		er = caltdissect(v, t, begin, end);
 		break;
 	case 'b':		/* back ref -- shouldn't be calling us! */
 		assert(t->left == NULL && t->right == NULL);
@@ -721,7 +1973,7 @@ chr *end;			/* end of same */
 		break;
 	case '.':		/* concatenation */
 		assert(t->left != NULL && t->right != NULL);
-		return ccondissect(v, t, begin, end);
+		er = ccondissect(v, t, begin, end);
 		break;
 	case '(':		/* capturing */
 		assert(t->left != NULL && t->right == NULL);
@@ -735,6 +1987,113 @@ chr *end;			/* end of same */
 		return REG_ASSERT;
 		break;
 	}
+
+	if (er == REG_NOMATCH && fresh)
+		notefail(v, &key);
+	return er;
+}
+
+/*
+ - failkey - gather what a fresh dissection attempt's outcome depends on
+ * That's the substring, plus the groups its backrefs refer to; returns 0
+ * if there are too many of those.
+ ^ static int failkey(struct vars *, struct subre *, chr *, chr *,
+ ^ 	struct fail *);
+ */
+static int			/* predicate:  can it be remembered? */
+failkey(v, t, begin, end, key)
+struct vars *v;
+struct subre *t;
+chr *begin;
+chr *end;
+struct fail *key;		/* filled in */
+{
+	unsigned refs = t->refs;
+	int i;
+	int n;
+
+	if (refs&MANYREFS)
+		return 0;
+	key->t = t;
+	key->begin = OFF(begin);
+	key->end = OFF(end);
+	n = 0;
+	for (i = 1, refs >>= 1; refs != 0; i++, refs >>= 1)
+		if (refs&1) {
+			if (n == FAILREFS)
+				return 0;
+			assert((size_t)i < v->nmatch);
+			key->refs[2*n] = v->pmatch[i].rm_so;
+			key->refs[2*n + 1] = v->pmatch[i].rm_eo;
+			n++;
+		}
+	for (; n < FAILREFS; n++)
+		key->refs[2*n] = key->refs[2*n + 1] = -1;
+	return 1;
+}
+
+/*
+ - failed - is this a remembered failure?
+ ^ static int failed(struct vars *, struct fail *);
+ */
+static int			/* predicate */
+failed(v, key)
+struct vars *v;
+struct fail *key;
+{
+	struct fail *f;
+	int i;
+
+	if (v->fails == NULL)
+		return 0;
+	f = &v->fails[failhash(key)];
+	if (f->t != key->t || f->begin != key->begin || f->end != key->end)
+		return 0;
+	for (i = 0; i < 2*FAILREFS; i++)
+		if (f->refs[i] != key->refs[i])
+			return 0;
+	return 1;
+}
+
+/*
+ - notefail - remember a failure, displacing whatever shared its slot
+ * Forgetting is harmless, so running out of memory here is no error.
+ ^ static VOID notefail(struct vars *, struct fail *);
+ */
+static VOID
+notefail(v, key)
+struct vars *v;
+struct fail *key;
+{
+	int i;
+
+	if (v->fails == NULL) {
+		v->fails = (struct fail *)MALLOC(NFAILS * sizeof(struct fail));
+		if (v->fails == NULL)
+			return;
+		for (i = 0; i < NFAILS; i++)
+			v->fails[i].t = NULL;
+	}
+	v->fails[failhash(key)] = *key;
+}
+
+/*
+ - failhash - pick the slot for a failure
+ ^ static int failhash(struct fail *);
+ */
+static int
+failhash(key)
+struct fail *key;
+{
+	unsigned h;
+	int i;
+
+	h = (unsigned)key->t->retry;
+	h = h*31 + (unsigned)key->begin;
+	h = h*31 + (unsigned)key->end;
+	for (i = 0; i < 2*FAILREFS; i++)
+		h = h*31 + (unsigned)key->refs[i];
+	return (int)(((h * 0x9e3779b1U) >> 16) & (NFAILS-1));
 }
 
 /*
@@ -762,12 +2121,12 @@ chr *end;			/* end of same */
 	if (t->left->flags&SHORTER)		/* reverse scan */
 		return crevdissect(v, t, begin, end);
 
-	d = newdfa(v, &t->left->cnfa, &v->g->cmap, DOMALLOC);
+	d = getdfa(v, t->left->retry, &t->left->cnfa, DOMALLOC);
 	if (ISERR())
 		return v->err;
-	d2 = newdfa(v, &t->right->cnfa, &v->g->cmap, DOMALLOC);
+	d2 = getdfa(v, t->right->retry, &t->right->cnfa, DOMALLOC);
 	if (ISERR()) {
-		freedfa(d);
+		putdfa(v, t->left->retry, d);
 		return v->err;
 	}
 	MDEBUG(("cconcat %d\n", t->retry));
@@ -776,8 +2135,8 @@ chr *end;			/* end of same */
 	if (v->mem[t->retry] == 0) {
 		mid = longest(v, d, begin, end, (int *)NULL);
 		if (mid == NULL) {
-			freedfa(d);
-			freedfa(d2);
+			putdfa(v, t->left->retry, d);
+			putdfa(v, t->right->retry, d2);
 			return REG_NOMATCH;
 		}
 		MDEBUG(("tentative midpoint %ld\n", LOFF(mid)));
@@ -797,8 +2156,8 @@ chr *end;			/* end of same */
 								REG_OKAY)
 			break;			/* NOTE BREAK OUT */
 		if (er != REG_OKAY && er != REG_NOMATCH) {
-			freedfa(d);
-			freedfa(d2);
+			putdfa(v, t->left->retry, d);
+			putdfa(v, t->right->retry, d2);
 			return er;
 		}
 
@@ -806,16 +2165,16 @@ chr *end;			/* end of same */
 		if (mid == begin) {
 			/* all possibilities exhausted */
 			MDEBUG(("%d no midpoint\n", t->retry));
-			freedfa(d);
-			freedfa(d2);
+			putdfa(v, t->left->retry, d);
+			putdfa(v, t->right->retry, d2);
 			return REG_NOMATCH;
 		}
 		mid = longest(v, d, begin, mid-1, (int *)NULL);
 		if (mid == NULL) {
 			/* failed to find a new one */
 			MDEBUG(("%d failed midpoint\n", t->retry));
-			freedfa(d);
-			freedfa(d2);
+			putdfa(v, t->left->retry, d);
+			putdfa(v, t->right->retry, d2);
 			return REG_NOMATCH;
 		}
 		MDEBUG(("%d: new midpoint %ld\n", t->retry, LOFF(mid)));
@@ -826,8 +2185,8 @@ chr *end;			/* end of same */
 
 	/* satisfaction */
 	MDEBUG(("successful\n"));
-	freedfa(d);
-	freedfa(d2);
+	putdfa(v, t->left->retry, d);
+	putdfa(v, t->right->retry, d2);
 	return REG_OKAY;
 }
 
@@ -855,12 +2214,12 @@ chr *end;			/* end of same */
 	assert(t->left->flags&SHORTER);
 
 	/* concatenation -- need to split the substring between parts */
-	d = newdfa(v, &t->left->cnfa, &v->g->cmap, DOMALLOC);
+	d = getdfa(v, t->left->retry, &t->left->cnfa, DOMALLOC);
 	if (ISERR())
 		return v->err;
-	d2 = newdfa(v, &t->right->cnfa, &v->g->cmap, DOMALLOC);
+	d2 = getdfa(v, t->right->retry, &t->right->cnfa, DOMALLOC);
 	if (ISERR()) {
-		freedfa(d);
+		putdfa(v, t->left->retry, d);
 		return v->err;
 	}
 	MDEBUG(("crev %d\n", t->retry));
@@ -869,8 +2228,8 @@ chr *end;			/* end of same */
 	if (v->mem[t->retry] == 0) {
 		mid = shortest(v, d, begin, begin, end, (chr **)NULL, (int *)NULL);
 		if (mid == NULL) {
-			freedfa(d);
-			freedfa(d2);
+			putdfa(v, t->left->retry, d);
+			putdfa(v, t->right->retry, d2);
 			return REG_NOMATCH;
 		}
 		MDEBUG(("tentative midpoint %ld\n", LOFF(mid)));
@@ -890,8 +2249,8 @@ chr *end;			/* end of same */
 								REG_OKAY)
 			break;			/* NOTE BREAK OUT */
 		if (er != REG_OKAY && er != REG_NOMATCH) {
-			freedfa(d);
-			freedfa(d2);
+			putdfa(v, t->left->retry, d);
+			putdfa(v, t->right->retry, d2);
 			return er;
 		}
 
@@ -899,16 +2258,16 @@ chr *end;			/* end of same */
 		if (mid == end) {
 			/* all possibilities exhausted */
 			MDEBUG(("%d no midpoint\n", t->retry));
-			freedfa(d);
-			freedfa(d2);
+			putdfa(v, t->left->retry, d);
+			putdfa(v, t->right->retry, d2);
 			return REG_NOMATCH;
 		}
 		mid = shortest(v, d, begin, mid+1, end, (chr **)NULL, (int *)NULL);
 		if (mid == NULL) {
 			/* failed to find a new one */
 			MDEBUG(("%d failed midpoint\n", t->retry));
-			freedfa(d);
-			freedfa(d2);
+			putdfa(v, t->left->retry, d);
+			putdfa(v, t->right->retry, d2);
 			return REG_NOMATCH;
 		}
 		MDEBUG(("%d: new midpoint %ld\n", t->retry, LOFF(mid)));
@@ -919,8 +2278,8 @@ chr *end;			/* end of same */
 
 	/* satisfaction */
 	MDEBUG(("successful\n"));
-	freedfa(d);
-	freedfa(d2);
+	putdfa(v, t->left->retry, d);
+	putdfa(v, t->right->retry, d2);
 	return REG_OKAY;
 }
 
@@ -1018,15 +2377,15 @@ chr *end;			/* end of same */
 	assert(t->left != NULL);
 
 	if (v->mem[t->retry] == UNTRIED) {
-		d = newdfa(v, &t->left->cnfa, &v->g->cmap, DOMALLOC);
+		d = getdfa(v, t->left->retry, &t->left->cnfa, DOMALLOC);
 		if (ISERR())
 			return v->err;
 		if (longest(v, d, begin, end, (int *)NULL) != end) {
-			freedfa(d);
+			putdfa(v, t->left->retry, d);
 			v->mem[t->retry] = TRIED;
 			return caltdissect(v, t->right, begin, end);
 		}
-		freedfa(d);
+		putdfa(v, t->left->retry, d);
 		MDEBUG(("calt matched\n"));
 		v->mem[t->retry] = TRYING;
 	}
@@ -1042,3 +2401,12 @@ chr *end;			/* end of same */
 
 
 #include "rege_dfa.c"
+#include "rege_lit.c"
+#include "rege_one.c"
+#include "rege_nfa.c"
+#include "rege_bit.c"
+#include "rege_set.c"
+#include "rege_par.c"
+#ifndef REG_CHR8		/* UTF-8 text is not Latin-1 text */
+#include "rege_utf.c"
+#endif
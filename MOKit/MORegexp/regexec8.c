@@ -0,0 +1,19 @@
+/* ---:mferris: This file contains ONLY the following external definitions:
+ *
+ * function exec() which is #defined to MO_ReExec8()
+ * function regtune() which is #defined to MO_ReTune8()
+ * function regstats() which is #defined to MO_ReStats8()
+ * functions regbegin(), regnext(), regend(), #defined to MO_ReIter*8()
+ * functions regsbegin(), regsfeed(), regsnext(), regsend(), #defined
+ *	to MO_ReStream*8()
+ * function regsetexec() which is #defined to MO_ReSetExec8()
+ */
+
+/*
+ * The RE matcher again, this time with 8-bit chrs (see regcustom.h),
+ * for REs from regcomp8.c.  There are no UTF-8 functions here; text
+ * that needs them is not Latin-1.
+ */
+
+#define	REG_CHR8	/* chr is unsigned char */
+#include "regexec.c"
@@ -102,6 +102,34 @@
 #define	FREE(p)		free(VS(p))
 #endif
 
+/* atomic operations, for exec-time caches shared between threads */
+#ifndef CASPTR
+#define	CASPTR(p, old, new)	__sync_bool_compare_and_swap((p), (old), (new))
+#endif
+#ifndef CASINT
+#define	CASINT(p, old, new)	__sync_bool_compare_and_swap((p), (old), (new))
+#endif
+#ifndef ATOMADD
+#define	ATOMADD(p, n)	__sync_fetch_and_add((p), (n))	/* yields old */
+#endif
+#ifndef ATOMGET
+#define	ATOMGET(p)	__atomic_load_n((p), __ATOMIC_ACQUIRE)
+#endif
+#ifndef ATOMPUT
+#define	ATOMPUT(p, x)	__atomic_store_n((p), (x), __ATOMIC_RELEASE)
+#endif
+
+/* threads, for execs that split a search among them (REG_PARALLEL) */
+#ifndef THREADSTART
+#include <pthread.h>
+#include <unistd.h>
+#define	THREAD		pthread_t
+#define	THREADSTART(t, fn, arg)	pthread_create((t), (pthread_attr_t *)NULL, \
+								(fn), (arg))
+#define	THREADJOIN(t)	pthread_join((t), (void **)NULL)
+#define	NCPUS()		((int)sysconf(_SC_NPROCESSORS_ONLN))
+#endif
+
 /* want size of a char in bits, and max value in bounded quantifiers */
 #ifndef CHAR_BIT
 #include <limits.h>
@@ -148,6 +176,13 @@
 #define	BSET(uv, sn)	((uv)[(sn)/UBITS] |= (unsigned)1 << ((sn)%UBITS))
 #define	ISBSET(uv, sn)	((uv)[(sn)/UBITS] & ((unsigned)1 << ((sn)%UBITS)))
 
+/* one-word state sets, for the bit-parallel NFA */
+#ifndef BPWORD
+#define	BPWORD	unsigned long long	/* at least 64 bits */
+#endif
+typedef BPWORD bpword;
+#define	BPBITS	(CHAR_BIT * sizeof(bpword))
+
 
 
 /*
@@ -224,9 +259,15 @@ struct colormap {
 	color free;			/* beginning of free chain (if non-0) */
 	struct colordesc *cd;
 #	define	CDEND(cm)	(&(cm)->cd[(cm)->max + 1])
+#	define	REALCOLOR(cm, co)	(!UNUSEDCOLOR(&(cm)->cd[co]) && \
+					!((cm)->cd[co].flags&PSEUDO))
 #		define	NINLINECDS	((size_t)10)
 	struct colordesc cdspace[NINLINECDS];
 	union tree tree[NBYTS];		/* tree top, plus fill blocks */
+#if NBYTS == 2
+	unsigned char blkidx[BYTTAB];	/* block number by high byt */
+	color *blocks;			/* flattened blocks, end to end */
+#endif
 };
 
 /* optimization magic to do fast chr->color mapping */
@@ -245,6 +286,13 @@ struct colormap {
 #define	GETCOLOR(cm, c)	((cm)->tree->tptr[B3(c)]->tptr[B2(c)]->tptr[B1(c)]->tcolor[B0(c)])
 #endif
 
+/* same, via the flat copy that flattencm() makes of a finished colormap */
+#if NBYTS == 2
+#define	FGETCOLOR(cm, c)	((cm)->blocks[((cm)->blkidx[B1(c)] << BYTBITS) | B0(c)])
+#else
+#define	FGETCOLOR(cm, c)	GETCOLOR(cm, c)
+#endif
+
 
 
 /*
@@ -288,6 +336,7 @@ struct arc {
 #	define	freechain	outchain
 	struct arc *inchain;	/* *to's ins chain */
 	struct arc *colorchain;	/* color's arc chain */
+	struct arc *colorchainRev;	/* back-link in color's arc chain */
 };
 
 struct arcbatch {		/* for bulk allocation of arcs */
@@ -337,22 +386,89 @@ struct carc {
 	color co;		/* COLORLESS is list terminator */
 	int to;			/* state number */
 };
+/* each state's list starts with a flags "arc":  co nonzero if no-progress, */
+/* and to holds these */
+#define	CDEAD	01		/* can't reach post from here */
+#define	CALWAYS	02		/* a match ends at every point from here on */
 
 struct cnfa {
 	int nstates;		/* number of states */
 	int ncolors;		/* number of colors */
 	int flags;
 #		define	HASLACONS	01	/* uses lookahead constraints */
+#		define	MIDSTART	02	/* starts in all states but pre, post */
+#		define	HASDEAD		04	/* some state is CDEAD */
+#		define	HASALWAYS	010	/* some state is CALWAYS */
 	int pre;		/* setup state number */
 	int post;		/* teardown state number */
 	color bos[2];		/* colors, if any, assigned to BOS and BOL */
 	color eos[2];		/* colors, if any, assigned to EOS and EOL */
 	struct carc **states;	/* vector of pointers to outarc lists */
 	struct carc *arcs;	/* the area for the lists */
+	struct dtab *dtab;	/* full DFA, if determinize() made one */
+	struct bpnfa *bits;	/* bit-parallel form, if bitnfa() made one */
 };
 #define	ZAPCNFA(cnfa)	((cnfa).nstates = 0)
 #define	NULLCNFA(cnfa)	((cnfa).nstates == 0)
 
+/*
+ * fully-determinized form of a small cnfa, walked by exec as a table;
+ * each entry is the next state's row offset, shifted, plus its flags
+ */
+struct dtab {
+	int nstates;		/* number of DFA states */
+	int *trans;		/* [state*ncolors + color] -> entry */
+	int start;		/* entry for the initial state */
+};
+#define	DSHIFT	3		/* entry is (state*ncolors)<<DSHIFT | flags */
+#define	DPOST	01		/* state includes the NFA's post state */
+#define	DNOPR	02		/* state is a zero-progress state */
+#define	DALWAYS	04		/* matches end everywhere from here on */
+#define	DDEAD	0		/* state 0 is the empty set, and its entry 0 */
+
+/*
+ * bit-parallel form of a small cnfa, one bit per (state, color entered
+ * on) pair; a set of those goes to the next set on a color by way of
+ * what follows each of its bits, looked up four bits at a time, masked
+ * down to those entered on that color
+ */
+struct bpnfa {
+	int npos;		/* number of bits in use */
+	bpword *follow;		/* [(pos/4)*16 + nibble] -> positions next */
+	bpword *colors;		/* [color] -> positions entered on it */
+	bpword start;		/* initial set */
+	bpword post;		/* positions of the post state */
+	bpword progress;	/* positions of states that aren't no-progress */
+	bpword live;		/* positions of states that can reach post */
+	bpword always;		/* positions of CALWAYS states */
+};
+#define	BPNIBBLES(npos)	(((npos) + 3) / 4)
+
+/*
+ * one-pass form of an RE in which the next chr (or the end of the string)
+ * always leaves just one way to go; exec walks it along a match, noting
+ * capture boundaries as it goes
+ */
+struct oarc {
+	int to;			/* next state, or ONONE */
+	unsigned tags;		/* capture boundaries to note first, by bit */
+};
+#define	ONONE	(-1)
+#define	OTAG(n, eo)	((unsigned)1 << (2*(n) + (eo)))	/* so, or eo */
+#define	OMAXSUB	((int)(UBITS/2) - 1)	/* most subexpressions tags cover */
+
+struct onepass {
+	int nstates;
+	int ncolors;
+	struct oarc *arcs;	/* [state*ncolors + color] */
+	struct oarc *ends;	/* [state*3 + how]; to is 0 if match can end */
+#		define	OMID	0	/* short of the end of the string */
+#		define	OEND(e)	(1 + (e))	/* at the end, eos color index e */
+	int start[3];		/* initial state, by bos color index... */
+#		define	OSTARTMID	2	/* ...or when not at the start */
+	int anchored;		/* can match only at the start of the string */
+};
+
 
 
 /*
@@ -379,6 +495,8 @@ struct subre {
 	int subno;		/* subexpression number (for 'b' and '(') */
 	short min;		/* min repetitions, for backref only */
 	short max;		/* max repetitions, for backref only */
+	unsigned refs;		/* groups its backrefs refer to, by bit */
+#		define	MANYREFS	01	/* (bit 0) too many to say */
 	struct subre *left;	/* left child, if any (also freelist chain) */
 	struct subre *right;	/* right child, if any */
 	struct state *begin;	/* outarcs from here... */
@@ -402,6 +520,10 @@ struct fns {
 /*
  * the insides of a regex_t, hidden behind a void *
  */
+struct dfa;			/* exec-time lazy DFA, opaque here */
+#define	MAXLIT	16		/* longest required literal we keep */
+#define	MAXPFX	32		/* most alternative prefixes we keep */
+
 struct guts {
 	int magic;
 #		define	GUTSMAGIC	0xfed9
@@ -410,9 +532,38 @@ struct guts {
 	size_t nsub;		/* copy of re_nsub */
 	struct subre *tree;
 	struct cnfa search;	/* for fast preliminary search */
+	struct cnfa reverse;	/* main NFA backward, for finding starts */
+	struct cnfa ahead;	/* and from anywhere, for bounding ends */
 	int ntree;
 	struct colormap cmap;
 	int FUNCPTR(compare, (CONST chr *, CONST chr *, size_t));
 	struct subre *lacons;	/* lookahead-constraint vector */
 	int nlacons;		/* size of lacons */
+	struct dfa **dfas;	/* DFAs kept between execs, by cnfa slot */
+	int ndfas;		/* size of dfas */
+#		define	DFASEARCH	0	/* slot of search; tree uses retry */
+#		define	DFAREVERSE(g)	((g)->ntree)	/* after the tree */
+#		define	DFAAHEAD(g)	((g)->ntree + 1)
+#		define	DFALACON(g, n)	((g)->ntree + 2 + (n))	/* then lacons */
+	VOID FUNCPTR(dfafree, (struct dfa *));	/* exec's freer for dfas */
+	rm_cache_t cache;	/* cache tuning, and totals of its counts */
+	chr lit[MAXLIT];	/* a literal every match contains */
+	int nlit;		/* length of lit, 0 if none known */
+	int litrare;		/* index of lit's least common chr */
+	chr pfx[MAXPFX][MAXLIT];	/* every match starts with one of these */
+	int pfxlen[MAXPFX];
+	int npfx;		/* number of prefixes, 0 if none known */
+	int pfxrare;		/* index of least common chr, if only one */
+	chr pfxfirst[MAXPFX];	/* the distinct first chrs of the prefixes */
+	int nfirst;
+	unsigned char pfxmap[BYTTAB];	/* which low byts start a prefix */
+	struct onepass *one;	/* one-pass program, if the RE allows one */
+	int minlen;		/* no match is shorter than this */
+	int maxlen;		/* nor longer than this, -1 if no limit */
+	int anchored;		/* matches can start only at the beginning */
+	unsigned char *startco;	/* [color] can a match start with it? */
+	int nset;		/* REs in a set (see regsetcomp()), 0 if none */
+	int *setpat;		/* [search state] RE it accepts for, or -1 */
+	unsigned *setmask;	/* bitvector of the accepting search states */
+	regex_t *setre;		/* [RE] compiled alone, if it needs checking */
 };
@@ -22,6 +22,8 @@ extern "C" {
 MOKIT_PRIVATE_EXTERN void MO_FreeRegex(void *re);
 MOKIT_PRIVATE_EXTERN void *MO_TestAndCompileExpressionString(NSString *expressionString, BOOL ignoreCase);
 BOOL MO_TestAndMatchCharactersInRangeWithExpression(const unichar *candidateChars, NSRange searchRange, void *re, NSRange *subrangeArray);
+MOKIT_PRIVATE_EXTERN void *MO_TestAndCompileExpressionSet(NSArray *expressions);
+MOKIT_PRIVATE_EXTERN unsigned MO_IndexOfFirstExpressionInSetMatchingCharactersInRange(const unichar *candidateChars, NSRange searchRange, void *set);
 
 #if defined(__cplusplus)
 }
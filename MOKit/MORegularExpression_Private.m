@@ -71,6 +71,56 @@ BOOL MO_TestAndMatchCharactersInRangeWithExpression(const unichar *candidateChar
 }
 
 
+void *MO_TestAndCompileExpressionSet(NSArray *expressions) {
+    // Caller frees return value (with MO_FreeRegex()) if non-null.  The set matches all the expressions in one pass over the candidate, see MO_ReSetComp().
+    regex_t *re = NULL;
+    int err;
+    unsigned i, c = [expressions count];
+    const unichar **chrs;
+    size_t *lens;
+    int *flags;
+
+    if (c == 0) {
+        return NULL;
+    }
+    re = malloc(sizeof(regex_t));
+    chrs = malloc(sizeof(unichar *) * c);
+    lens = malloc(sizeof(size_t) * c);
+    flags = malloc(sizeof(int) * c);
+    for (i=0; i<c; i++) {
+        MORegularExpression *expression = [expressions objectAtIndex:i];
+        NSString *expressionString = [expression expressionString];
+        unichar *buff;
+
+        lens[i] = [expressionString length];
+        buff = malloc(sizeof(unichar) * lens[i]);
+        [expressionString getCharacters:buff];
+        chrs[i] = buff;
+        flags[i] = ([expression ignoreCase] ? (REG_ADVANCED | REG_ICASE) : REG_ADVANCED);
+    }
+    err = MO_ReSetComp(re, (int)c, chrs, lens, flags);
+    for (i=0; i<c; i++) {
+        free((unichar *)chrs[i]);
+    }
+    free(chrs);
+    free(lens);
+    free(flags);
+    if (err != REG_OKAY) {
+        free(re), re = NULL;
+    }
+    return re;
+}
+
+unsigned MO_IndexOfFirstExpressionInSetMatchingCharactersInRange(const unichar *candidateChars, NSRange searchRange, void *set) {
+    int hit;
+
+    if (MO_ReSetExec((regex_t *)set, candidateChars + searchRange.location, searchRange.length, NULL, 1, &hit, 0) == REG_OKAY) {
+        return (unsigned)hit;
+    } else {
+        return NSNotFound;
+    }
+}
+
 /*
  This file contains Original Code and/or Modifications of Original Code as defined in and that are subject to the Ferris Public Source License Version 1.2 (the 'License'). You may not use this file except in compliance with the License. Please obtain a copy of the License at http://mokit.sourceforge.net/License.html and read it before using this file.
 
@@ -0,0 +1,1355 @@
+// RegexTest_engine.c
+// MOKit
+// RegexTest
+//
+// Copyright © 1996-2005, Mike Ferris.  All rights reserved.
+// See bottom of file for license and disclaimer.
+
+// These tests drive the regex package's own entry points, for the parts of it that MORegularExpression doesn't reach.  Each check counts as a test, and a failed one is logged with "FAILURE:" like the rest.
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "../MOKit/MORegexp/regcustom.h"
+
+static unsigned *totalTestsPtr;
+static unsigned *failCountPtr;
+
+static void check(int ok, const char *format, ...) {
+    va_list args;
+
+    (*totalTestsPtr)++;
+    if (!ok) {
+        (*failCountPtr)++;
+        fprintf(stderr, "FAILURE: regex engine test: ");
+        va_start(args, format);
+        vfprintf(stderr, format, args);
+        va_end(args);
+        fprintf(stderr, "\n");
+    }
+}
+
+// Widens a Latin-1 C string; returns its length.
+static size_t widen(const char *str, MO_unichar *buf) {
+    size_t i;
+
+    for (i = 0; str[i] != '\0'; i++) {
+        buf[i] = (unsigned char)str[i];
+    }
+    return i;
+}
+
+static int compileRE(regex_t *re, const char *pattern, int flags) {
+    MO_unichar buf[256];
+
+    return MO_ReComp(re, buf, widen(pattern, buf), flags);
+}
+
+// Formats the first match, and its first subexpression if that matched.
+static void formatMatch(int err, regmatch_t *match, char *result) {
+    result[0] = '\0';
+    if (err == REG_OKAY) {
+        sprintf(result, "[%ld,%ld)", (long)match[0].rm_so, (long)match[0].rm_eo);
+        if (match[1].rm_so >= 0) {
+            sprintf(result + strlen(result), "[%ld,%ld)", (long)match[1].rm_so, (long)match[1].rm_eo);
+        }
+    }
+}
+
+// Fills buf with len pseudo-random a's and b's, the same ones for the same seed, then a 'c'; returns the length with the 'c'.
+static size_t abString(unsigned seed, size_t len, MO_unichar *buf) {
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        seed = seed * 1103515245 + 12345;
+        buf[i] = ((seed >> 16) & 1) ? 'a' : 'b';
+    }
+    buf[len] = 'c';
+    return len + 1;
+}
+
+// A regex keeps its lazy DFAs from one exec to the next; an exec should match just as one building DFAs of its own (REG_SMALL) does, whatever execs came before it.
+static void testKeptDFAs() {
+    static const char *patterns[] = {
+        "[ab]*a[ab]{40}c",
+        "^b*a[ab]{40}",
+        "(?=[ab]*c)(a|b)*?(ab{2})",
+    };
+    static const int eflags[] = {0, REG_NOTBOL, 0, REG_NOTEOL};
+    regex_t re;
+    regmatch_t match[2];
+    MO_unichar str[4][400];
+    size_t len[4];
+    char expected[64];
+    char result[64];
+    unsigned i, j, k, round;
+    int flags;
+    int err;
+
+    len[0] = abString(1, 300, str[0]);
+    str[0][len[0] - 42] = 'a';
+    len[1] = abString(2, 300, str[1]);
+    str[1][len[1] - 42] = 'b';
+    len[2] = abString(3, 60, str[2]);
+    len[3] = abString(4, 399, str[3]);
+    for (i = 0; i < sizeof(patterns) / sizeof(patterns[0]); i++) {
+        if (compileRE(&re, patterns[i], REG_ADVANCED) != REG_OKAY) {
+            check(0, "'%s' did not compile", patterns[i]);
+            continue;
+        }
+        for (round = 0; round < 3; round++) {
+            for (j = 0; j < 4; j++) {
+                k = (round == 1) ? 3 - j : j;
+                flags = eflags[(k + round) % 4];
+                err = MO_ReExec(&re, str[k], len[k], NULL, 2, match, flags|REG_SMALL);
+                formatMatch(err, match, expected);
+                err = MO_ReExec(&re, str[k], len[k], NULL, 2, match, flags);
+                formatMatch(err, match, result);
+                check((err == REG_OKAY || err == REG_NOMATCH) && strcmp(result, expected) == 0, "'%s' on string %u with eflags %d, time %u, gave %s (error %d), expected %s", patterns[i], k, flags, round, result, err, expected);
+            }
+        }
+        MO_ReFree(&re);
+    }
+}
+
+// Nearly every chr of a long a/b string takes a DFA for these REs to a state set it hasn't seen, so the sets are found, added and dropped again and again.  The match depends only on the 41st chr from the end, whatever size the cache is.
+static void testStateSetIndex() {
+    static const struct {
+        const char *pattern;
+        int anchored;
+    } cases[] = {
+        {"[ab]*a[ab]{40}c", 1},
+        {"a[ab]{40}c", 0},
+    };
+    static const size_t budgets[] = {0, 1 << 22};
+    regex_t re;
+    rm_detail_t details;
+    regmatch_t match[2];
+    MO_unichar str[1001];
+    char expected[64];
+    char result[64];
+    unsigned i, j, k;
+    size_t len;
+    int err;
+
+    for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        if (compileRE(&re, cases[i].pattern, REG_ADVANCED) != REG_OKAY) {
+            check(0, "'%s' did not compile", cases[i].pattern);
+            continue;
+        }
+        for (j = 0; j < 8; j++) {
+            len = abString(j + 10, 200 + j * 100, str);
+            expected[0] = '\0';
+            if (str[len - 42] == 'a') {
+                sprintf(expected, "[%ld,%ld)", cases[i].anchored ? 0L : (long)(len - 42), (long)len);
+            }
+            for (k = 0; k < sizeof(budgets) / sizeof(budgets[0]); k++) {
+                memset(&details, 0, sizeof(details));
+                details.rm_cache.rc_budget = budgets[k];
+                err = MO_ReExec(&re, str, len, &details, 2, match, REG_CACHE);
+                formatMatch(err, match, result);
+                check((err == REG_OKAY || err == REG_NOMATCH) && strcmp(result, expected) == 0, "'%s' on string %u with a budget of %lu gave %s (error %d), expected %s", cases[i].pattern, j, (unsigned long)budgets[k], result, err, expected);
+            }
+            err = MO_ReExec(&re, str, len, NULL, 2, match, REG_SMALL);
+            formatMatch(err, match, result);
+            check((err == REG_OKAY || err == REG_NOMATCH) && strcmp(result, expected) == 0, "'%s' on string %u with REG_SMALL gave %s (error %d), expected %s", cases[i].pattern, j, result, err, expected);
+        }
+        MO_ReFree(&re);
+    }
+}
+
+// Exec finds colors through a flattened copy of the colormap; every chr should get the color of the class it is in, across the map's blocks and at their edges.
+static void testColorBlocks() {
+    static const struct {
+        const char *pattern;
+        int negated;
+        unsigned ranges[4][2];
+    } cases[] = {
+        {"^[\\u0100-\\u017f\\u3000-\\u30ff]$", 0, {{0x100, 0x17f}, {0x3000, 0x30ff}}},
+        {"^[^\\u00ff-\\u0100\\uffff]$", 1, {{0xff, 0x100}, {0xffff, 0xffff}}},
+        {"^[a-z\\u00e0-\\u00ff\\u4e00-\\u9fff\\ufff0-\\ufffe]$", 0, {{'a', 'z'}, {0xe0, 0xff}, {0x4e00, 0x9fff}, {0xfff0, 0xfffe}}},
+        {"^[\\u00ff\\u01ff\\u7fff\\u8000]$", 0, {{0xff, 0xff}, {0x1ff, 0x1ff}, {0x7fff, 0x8000}}},
+    };
+    regex_t re;
+    MO_unichar c;
+    unsigned i, j;
+    unsigned wrong;
+    unsigned long n;
+    int in;
+    int err;
+
+    for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        if (compileRE(&re, cases[i].pattern, REG_ADVANCED) != REG_OKAY) {
+            check(0, "'%s' did not compile", cases[i].pattern);
+            continue;
+        }
+        wrong = 0;
+        for (n = 0; n <= 0xffff; n++) {
+            c = (MO_unichar)n;
+            in = 0;
+            for (j = 0; j < 4 && cases[i].ranges[j][1] != 0; j++) {
+                if (n >= cases[i].ranges[j][0] && n <= cases[i].ranges[j][1]) {
+                    in = 1;
+                }
+            }
+            err = MO_ReExec(&re, &c, 1, NULL, 0, NULL, 0);
+            if (err != (in != cases[i].negated ? REG_OKAY : REG_NOMATCH)) {
+                if (wrong++ == 0) {
+                    check(0, "'%s' on \\u%04lx gave error %d", cases[i].pattern, n, err);
+                }
+            }
+        }
+        check(wrong == 0, "'%s' was wrong for %u chrs", cases[i].pattern, wrong);
+        MO_ReFree(&re);
+    }
+}
+
+// A cache of any size or policy should give the same matches as the default one.  A small one has to flush or evict, and the counts should show it, through the details and through regstats().
+static void testCacheTuning() {
+    static const char *patterns[] = {
+        "[ab]*a[ab]{40}c",
+        "a[ab]{40}c",
+        "(?=[ab]*c)(a|b)*?(ab{2})",
+    };
+    static const int policies[] = {REG_CSCAN, REG_CCLOCK, REG_CFLUSH};
+    regex_t re;
+    rm_detail_t details;
+    rm_cache_t tuning;
+    rm_cache_t before;
+    rm_cache_t after;
+    regmatch_t match[2];
+    MO_unichar str[4][400];
+    size_t len[4];
+    char expected[64];
+    char result[64];
+    unsigned i, j, k;
+    int err;
+
+    len[0] = abString(21, 300, str[0]);
+    str[0][len[0] - 42] = 'a';
+    len[1] = abString(22, 300, str[1]);
+    str[1][len[1] - 42] = 'b';
+    len[2] = abString(23, 60, str[2]);
+    len[3] = abString(24, 399, str[3]);
+    for (i = 0; i < sizeof(patterns) / sizeof(patterns[0]); i++) {
+        if (compileRE(&re, patterns[i], REG_ADVANCED) != REG_OKAY) {
+            check(0, "'%s' did not compile", patterns[i]);
+            continue;
+        }
+        for (j = 0; j < 4; j++) {
+            err = MO_ReExec(&re, str[j], len[j], NULL, 2, match, 0);
+            formatMatch(err, match, expected);
+            for (k = 0; k < sizeof(policies) / sizeof(policies[0]); k++) {
+                memset(&details, 0, sizeof(details));
+                details.rm_cache.rc_budget = 1;
+                details.rm_cache.rc_policy = policies[k];
+                err = MO_ReExec(&re, str[j], len[j], &details, 2, match, REG_CACHE);
+                formatMatch(err, match, result);
+                check((err == REG_OKAY || err == REG_NOMATCH) && strcmp(result, expected) == 0, "'%s' on string %u with a tiny cache and policy %d gave %s (error %d), expected %s", patterns[i], j, policies[k], result, err, expected);
+            }
+        }
+        MO_ReFree(&re);
+    }
+
+    // a long string through a tiny cache
+    compileRE(&re, patterns[0], REG_ADVANCED);
+    for (k = 0; k < sizeof(policies) / sizeof(policies[0]); k++) {
+        MO_ReStats(&re, &before);
+        memset(&details, 0, sizeof(details));
+        details.rm_cache.rc_budget = 1;
+        details.rm_cache.rc_policy = policies[k];
+        err = MO_ReExec(&re, str[3], len[3], &details, 0, NULL, REG_CACHE);
+        MO_ReStats(&re, &after);
+        if (policies[k] == REG_CFLUSH) {
+            check(details.rm_cache.rc_flushes > 0 && after.rc_flushes - before.rc_flushes == details.rm_cache.rc_flushes, "policy %d flushed %ld times, %ld by regstats(), expected some", policies[k], details.rm_cache.rc_flushes, after.rc_flushes - before.rc_flushes);
+        } else {
+            check(details.rm_cache.rc_evictions > 0 && after.rc_evictions - before.rc_evictions == details.rm_cache.rc_evictions, "policy %d evicted %ld times, %ld by regstats(), expected some", policies[k], details.rm_cache.rc_evictions, after.rc_evictions - before.rc_evictions);
+        }
+    }
+
+    // tuning reads back, and plain execs use it
+    memset(&tuning, 0, sizeof(tuning));
+    tuning.rc_budget = 12345;
+    tuning.rc_policy = REG_CCLOCK;
+    err = MO_ReTune(&re, &tuning);
+    MO_ReStats(&re, &after);
+    check(err == REG_OKAY && after.rc_budget == 12345 && after.rc_policy == REG_CCLOCK, "regtune() gave error %d, and regstats() read back budget %lu policy %d", err, (unsigned long)after.rc_budget, after.rc_policy);
+    tuning.rc_budget = 1;
+    MO_ReTune(&re, &tuning);
+    MO_ReStats(&re, &before);
+    MO_ReExec(&re, str[3], len[3], NULL, 0, NULL, 0);
+    MO_ReStats(&re, &after);
+    check(after.rc_evictions > before.rc_evictions, "a plain exec after tuning for a tiny cache evicted %ld times, expected some", after.rc_evictions - before.rc_evictions);
+
+    // bad tuning
+    tuning.rc_policy = REG_CFLUSH + 1;
+    err = MO_ReTune(&re, &tuning);
+    check(err == REG_INVARG, "regtune() with policy %d gave error %d, expected REG_INVARG", tuning.rc_policy, err);
+    tuning.rc_policy = -1;
+    err = MO_ReTune(&re, &tuning);
+    check(err == REG_INVARG, "regtune() with policy %d gave error %d, expected REG_INVARG", tuning.rc_policy, err);
+    memset(&details, 0, sizeof(details));
+    details.rm_cache.rc_policy = REG_CFLUSH + 1;
+    err = MO_ReExec(&re, str[0], len[0], &details, 0, NULL, REG_CACHE);
+    check(err == REG_INVARG, "REG_CACHE with policy %d gave error %d, expected REG_INVARG", details.rm_cache.rc_policy, err);
+    err = MO_ReExec(&re, str[0], len[0], NULL, 0, NULL, REG_CACHE);
+    check(err == REG_INVARG, "REG_CACHE without details gave error %d, expected REG_INVARG", err);
+    MO_ReFree(&re);
+}
+
+// What one thread of testSharedDFAs() does: execs on the strings over and over, starting with a different one from the other threads, and counts the results that aren't what a single thread got.
+struct sharer {
+    regex_t *re;
+    MO_unichar (*strs)[400];
+    size_t *lens;
+    char (*expected)[64];
+    unsigned first;
+    unsigned wrong;
+    char result[64];
+};
+
+static void *shareExecs(void *arg) {
+    struct sharer *sh = (struct sharer *)arg;
+    static const int eflags[] = {0, REG_NOTBOL};
+    regmatch_t match[2];
+    char result[64];
+    unsigned i, j, k;
+    int err;
+
+    sh->wrong = 0;
+    for (i = 0; i < 64; i++) {
+        j = (i / 4) % 2;
+        k = (sh->first + i) % 4;
+        err = MO_ReExec(sh->re, sh->strs[k], sh->lens[k], NULL, 2, match, eflags[j]);
+        formatMatch(err, match, result);
+        if (strcmp(result, sh->expected[j * 4 + k]) != 0 && sh->wrong++ == 0) {
+            strcpy(sh->result, result);
+        }
+    }
+    return NULL;
+}
+
+// Threads execing with one REG_SHARED regex share its DFAs; each should find just what a single thread does.
+static void testSharedDFAs() {
+    static const char *patterns[] = {
+        "[ab]*a[ab]{40}c",
+        "a[ab]{40}c",
+        "(?=[ab]*c)(a|b)*?(ab{2})",
+    };
+    static const int eflags[] = {0, REG_NOTBOL};
+    regex_t re;
+    regex_t shared;
+    regmatch_t match[2];
+    MO_unichar str[4][400];
+    size_t len[4];
+    char expected[8][64];
+    struct sharer sharers[8];
+    pthread_t threads[8];
+    int started[8];
+    unsigned i, j, k;
+    int err;
+
+    len[0] = abString(31, 300, str[0]);
+    str[0][len[0] - 42] = 'a';
+    len[1] = abString(32, 300, str[1]);
+    str[1][len[1] - 42] = 'b';
+    len[2] = abString(33, 60, str[2]);
+    len[3] = abString(34, 399, str[3]);
+    for (i = 0; i < sizeof(patterns) / sizeof(patterns[0]); i++) {
+        if (compileRE(&re, patterns[i], REG_ADVANCED) != REG_OKAY || compileRE(&shared, patterns[i], REG_ADVANCED|REG_SHARED) != REG_OKAY) {
+            check(0, "'%s' did not compile", patterns[i]);
+            continue;
+        }
+        for (j = 0; j < 2; j++) {
+            for (k = 0; k < 4; k++) {
+                err = MO_ReExec(&re, str[k], len[k], NULL, 2, match, eflags[j]);
+                formatMatch(err, match, expected[j * 4 + k]);
+            }
+        }
+        for (k = 0; k < 8; k++) {
+            sharers[k].re = &shared;
+            sharers[k].strs = str;
+            sharers[k].lens = len;
+            sharers[k].expected = expected;
+            sharers[k].first = k;
+            sharers[k].wrong = 0;
+            started[k] = (pthread_create(&threads[k], NULL, shareExecs, &sharers[k]) == 0);
+            if (!started[k]) {
+                shareExecs(&sharers[k]);
+            }
+        }
+        for (k = 0; k < 8; k++) {
+            if (started[k]) {
+                pthread_join(threads[k], NULL);
+            }
+            check(sharers[k].wrong == 0, "shared '%s' was wrong %u times in thread %u, first giving %s", patterns[i], sharers[k].wrong, k, sharers[k].result);
+        }
+        MO_ReFree(&shared);
+        MO_ReFree(&re);
+    }
+}
+
+// A regex compiled with REG_FULLDFA should match just as one without it does.  [ab]*a[ab]{8} has 512 DFA states, too many to get a table unasked; [ab]*a[ab]{12} has 8192, too many even when asked, and a[ab]{40}c far more, so those two go without one either way.
+static void testFullDFAs() {
+    static const char *patterns[] = {
+        "(ab|ba)*c(x+)",
+        "^(a|b)*?b{2}",
+        "[ab]*a[ab]{8}",
+        "[ab]*a[ab]{8}c",
+        "[ab]*a[ab]{12}",
+        "a[ab]{40}c",
+        "\\mword(s?)\\M",
+    };
+    static const int eflags[] = {0, REG_NOTBOL, REG_NOTEOL};
+    regex_t re;
+    regex_t full;
+    regmatch_t match[2];
+    MO_unichar str[4][400];
+    size_t len[4];
+    char expected[64];
+    char result[64];
+    unsigned i, j, k;
+    int err;
+
+    len[0] = abString(41, 30, str[0]);
+    len[1] = abString(42, 300, str[1]);
+    str[1][len[1] - 42] = 'a';
+    len[2] = abString(43, 399, str[2]);
+    len[3] = widen("xx abbac word words cxxx abab wordy abbbbbbbbbbab", str[3]);
+    for (i = 0; i < sizeof(patterns) / sizeof(patterns[0]); i++) {
+        if (compileRE(&re, patterns[i], REG_ADVANCED) != REG_OKAY || compileRE(&full, patterns[i], REG_ADVANCED|REG_FULLDFA) != REG_OKAY) {
+            check(0, "'%s' did not compile", patterns[i]);
+            continue;
+        }
+        for (j = 0; j < 4; j++) {
+            for (k = 0; k < sizeof(eflags) / sizeof(eflags[0]); k++) {
+                err = MO_ReExec(&re, str[j], len[j], NULL, 2, match, eflags[k]);
+                formatMatch(err, match, expected);
+                err = MO_ReExec(&full, str[j], len[j], NULL, 2, match, eflags[k]);
+                formatMatch(err, match, result);
+                check((err == REG_OKAY || err == REG_NOMATCH) && strcmp(result, expected) == 0, "'%s' with REG_FULLDFA on string %u with eflags %d gave %s (error %d), expected %s", patterns[i], j, eflags[k], result, err, expected);
+            }
+        }
+        MO_ReFree(&full);
+        MO_ReFree(&re);
+    }
+}
+
+// Formats every subexpression's match after the whole match's, "-" for one that didn't match.
+static void formatMatches(int err, regmatch_t *match, size_t nmatch, char *result) {
+    size_t i;
+
+    result[0] = '\0';
+    if (err == REG_OKAY) {
+        for (i = 0; i < nmatch; i++) {
+            if (match[i].rm_so >= 0) {
+                sprintf(result + strlen(result), "[%ld,%ld)", (long)match[i].rm_so, (long)match[i].rm_eo);
+            } else {
+                strcat(result, "-");
+            }
+        }
+    }
+}
+
+// Dissection keeps a DFA per tree node, and lookahead constraints theirs, from one exec to the next; later execs should find the same subexpressions a freshly compiled regex does.
+static void testNodeDFAs() {
+    static const char *patterns[] = {
+        "([a-c]+)(d+)\\2?([a-c]+)(e)",
+        "([ab]*?)(b+)\\2",
+        "(x+|y+)(z|\\1)",
+        "(a|ab)(c|bcd)(d*)",
+        "(?=.*d)([a-d]+?)(d)",
+    };
+    static const char *strs[] = {
+        "xxabcddcae abdde",
+        "aabbbbbb bbbabbb",
+        "xxxz yyyy xy",
+        "abcd abcdd acd",
+        "xxaccbd",
+    };
+    static const char *words[] = {"aabbab", "bbbaab", "ababab", "abbbba", "baabba", "bbaaab", "aaaabb", "bababa", "abaaba", "bbbbaa"};
+    regex_t re;
+    regex_t fresh;
+    regmatch_t match[5];
+    MO_unichar str[32];
+    MO_unichar abuf[251];
+    char pattern[256];
+    char expected[2048];
+    char result[2048];
+    unsigned i, j, k, round;
+    size_t len;
+    size_t pos;
+    int err;
+
+    for (i = 0; i < sizeof(patterns) / sizeof(patterns[0]); i++) {
+        if (compileRE(&re, patterns[i], REG_ADVANCED) != REG_OKAY) {
+            check(0, "'%s' did not compile", patterns[i]);
+            continue;
+        }
+        for (round = 0; round < 3; round++) {
+            for (j = 0; j < sizeof(strs) / sizeof(strs[0]); j++) {
+                len = widen(strs[j], str);
+                compileRE(&fresh, patterns[i], REG_ADVANCED);
+                err = MO_ReExec(&fresh, str, len, NULL, 5, match, 0);
+                formatMatches(err, match, 5, expected);
+                MO_ReFree(&fresh);
+                err = MO_ReExec(&re, str, len, NULL, 5, match, (round == 2) ? REG_SMALL : 0);
+                formatMatches(err, match, 5, result);
+                check((err == REG_OKAY || err == REG_NOMATCH) && strcmp(result, expected) == 0, "'%s' on '%s', time %u, gave %s (error %d), expected %s", patterns[i], strs[j], round, result, err, expected);
+            }
+        }
+        MO_ReFree(&re);
+    }
+
+    // more lookahead constraints than are held for a whole exec, asked about at every position
+    pattern[0] = '\0';
+    for (i = 0; i < sizeof(words) / sizeof(words[0]); i++) {
+        sprintf(pattern + strlen(pattern), "%s(?=%s).", (i == 0) ? "" : "|", words[i]);
+    }
+    if (compileRE(&re, pattern, REG_ADVANCED) != REG_OKAY) {
+        check(0, "'%s' did not compile", pattern);
+        return;
+    }
+    for (round = 0; round < 4; round++) {
+        len = abString(51 + round, 250, abuf) - 1;
+        expected[0] = '\0';
+        for (i = 0; i < len; i++) {
+            for (j = 0; j < sizeof(words) / sizeof(words[0]); j++) {
+                for (k = 0; k < 6 && i + k < len && abuf[i + k] == (MO_unichar)words[j][k]; k++) {
+                }
+                if (k == 6) {
+                    sprintf(expected + strlen(expected), "[%u,%u)", i, i + 1);
+                    break;
+                }
+            }
+        }
+        result[0] = '\0';
+        for (pos = 0; (err = MO_ReExec(&re, &abuf[pos], len - pos, NULL, 1, match, 0)) == REG_OKAY; pos += match[0].rm_eo) {
+            sprintf(result + strlen(result), "[%ld,%ld)", (long)(pos + match[0].rm_so), (long)(pos + match[0].rm_eo));
+        }
+        check(err == REG_NOMATCH && strcmp(result, expected) == 0, "%lu lookaheads on string %u gave %s (error %d), expected %s", (unsigned long)(sizeof(words) / sizeof(words[0])), round, result, err, expected);
+    }
+    MO_ReFree(&re);
+}
+
+// Dissection remembers attempts that failed, so as not to make them again; that should never change what it finds, even once more have failed than it has room for.  These REs get as far as dissection on strings starting with c and ending with dcx, and fail there at many starting points.
+static void testFailMemo() {
+    static const char *patterns[] = {
+        "(c+)d(?:(?:c|d)+\\1)*d\\1x",
+        "(c+)(?:d+\\1)*?d*\\1x",
+        "([cd])(?:[cd]\\1)*[cd]x",
+        "(cc?)(?:d+\\1)*d\\1x",
+    };
+    regex_t re;
+    rm_detail_t details;
+    regmatch_t match[3];
+    MO_unichar str[200];
+    char expected[128];
+    char result[128];
+    long used;
+    long usedWithout;
+    unsigned i, j;
+    size_t len;
+    size_t k;
+    int err;
+
+    used = usedWithout = 0;
+    for (i = 0; i < sizeof(patterns) / sizeof(patterns[0]); i++) {
+        if (compileRE(&re, patterns[i], REG_ADVANCED) != REG_OKAY) {
+            check(0, "'%s' did not compile", patterns[i]);
+            continue;
+        }
+        for (j = 0; j < 16; j++) {
+            str[0] = 'c';
+            len = abString(61 + j, 20 << (j % 4), &str[1]);
+            for (k = 1; k < len; k++) {
+                str[k] = (str[k] == 'a') ? 'c' : 'd';
+            }
+            str[len] = 'd';
+            str[len + 1] = 'c';
+            str[len + 2] = 'x';
+            len += 3;
+            memset(&details, 0, sizeof(details));
+            err = MO_ReExec(&re, str, len, &details, 3, match, REG_LIMIT|REG_NOMEMO);
+            formatMatches(err, match, 3, expected);
+            usedWithout += details.rm_limit.rl_used;
+            memset(&details, 0, sizeof(details));
+            err = MO_ReExec(&re, str, len, &details, 3, match, REG_LIMIT);
+            formatMatches(err, match, 3, result);
+            used += details.rm_limit.rl_used;
+            check((err == REG_OKAY || err == REG_NOMATCH) && strcmp(result, expected) == 0, "'%s' on string %u gave %s (error %d), expected %s", patterns[i], j, result, err, expected);
+        }
+        MO_ReFree(&re);
+    }
+    check(used < usedWithout, "remembering failures took %ld steps, %ld without", used, usedWithout);
+}
+
+// Submatches found by walking the one-pass program along a match should be those dissection finds; a lookahead constraint, even one that always holds, keeps the program from being built.
+static void testOnePass() {
+    static const char *patterns[] = {
+        "(\\d+)-(\\d+)-(\\w+)",
+        "([a-z]+)@([a-z]+)\\.(com|org)",
+        "(x*)(y?)z",
+        "(a|bc)(d)?e",
+        "^(\\w+) (\\w+)$",
+        "^(ab)*(c)",
+        "^(a)?(b){0,2}(c)$",
+        "(a*)(a)",
+    };
+    static const char *strs[] = {
+        "call 555-1234-ext9 or 1-2-3",
+        "mail bob@example.com, not al@b.c or x@y.org",
+        "xxyz yz z xyyz",
+        "abce bcde ae bcee",
+        "hello world",
+        "ababc",
+        "abbc",
+        "bc",
+        "c",
+        "aaaa",
+    };
+    regex_t walk;
+    regex_t plain;
+    regmatch_t match[4];
+    MO_unichar str[64];
+    char pattern[64];
+    char expected[256];
+    char result[256];
+    unsigned i, j;
+    size_t len;
+    int err;
+
+    for (i = 0; i < sizeof(patterns) / sizeof(patterns[0]); i++) {
+        sprintf(pattern, "(?=.*)%s", patterns[i]);
+        if (compileRE(&walk, patterns[i], REG_ADVANCED) != REG_OKAY || compileRE(&plain, pattern, REG_ADVANCED) != REG_OKAY) {
+            check(0, "'%s' did not compile", patterns[i]);
+            continue;
+        }
+        for (j = 0; j < sizeof(strs) / sizeof(strs[0]); j++) {
+            len = widen(strs[j], str);
+            err = MO_ReExec(&plain, str, len, NULL, 4, match, 0);
+            formatMatches(err, match, 4, expected);
+            err = MO_ReExec(&walk, str, len, NULL, 4, match, 0);
+            formatMatches(err, match, 4, result);
+            check((err == REG_OKAY || err == REG_NOMATCH) && strcmp(result, expected) == 0, "'%s' on '%s' gave %s (error %d), expected %s", patterns[i], strs[j], result, err, expected);
+        }
+        MO_ReFree(&plain);
+        MO_ReFree(&walk);
+    }
+}
+
+// A cache far too small for a DFA makes it thrash; the search should give up on the cache rather than evict at nearly every chr, and still find what it would have.
+static void testThrashing() {
+    static const struct {
+        const char *pattern;
+        int anchored;
+    } cases[] = {
+        {"[ab]*a[ab]{40}c", 1},
+        {"a[ab]{40}c", 0},
+    };
+    static const int policies[] = {REG_CSCAN, REG_CCLOCK, REG_CFLUSH};
+    regex_t re;
+    rm_detail_t details;
+    regmatch_t match[2];
+    MO_unichar str[5001];
+    char expected[64];
+    char result[64];
+    unsigned i, j, k;
+    size_t len;
+    int err;
+
+    for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        if (compileRE(&re, cases[i].pattern, REG_ADVANCED) != REG_OKAY) {
+            check(0, "'%s' did not compile", cases[i].pattern);
+            continue;
+        }
+        for (j = 0; j < 2; j++) {
+            len = abString(71 + j, 5000, str);
+            str[len - 42] = (j == 0) ? 'a' : 'b';
+            expected[0] = '\0';
+            if (j == 0) {
+                sprintf(expected, "[%ld,%ld)", cases[i].anchored ? 0L : (long)(len - 42), (long)len);
+            }
+            err = MO_ReExec(&re, str, len, NULL, 2, match, 0);
+            formatMatch(err, match, result);
+            check((err == REG_OKAY || err == REG_NOMATCH) && strcmp(result, expected) == 0, "'%s' on string %u gave %s (error %d), expected %s", cases[i].pattern, j, result, err, expected);
+            for (k = 0; k < sizeof(policies) / sizeof(policies[0]); k++) {
+                memset(&details, 0, sizeof(details));
+                details.rm_cache.rc_budget = 1;
+                details.rm_cache.rc_policy = policies[k];
+                err = MO_ReExec(&re, str, len, &details, 2, match, REG_CACHE);
+                formatMatch(err, match, result);
+                check((err == REG_OKAY || err == REG_NOMATCH) && strcmp(result, expected) == 0, "'%s' on string %u with a tiny cache and policy %d gave %s (error %d), expected %s", cases[i].pattern, j, policies[k], result, err, expected);
+                check(details.rm_cache.rc_evictions < (long)len / 10, "'%s' on string %u with a tiny cache and policy %d evicted %ld times in %lu chrs", cases[i].pattern, j, policies[k], details.rm_cache.rc_evictions, (unsigned long)len);
+            }
+        }
+        MO_ReFree(&re);
+    }
+}
+
+// A work limit should stop an exec that would take more steps than it allows, and not change what one that fits finds; a cancel flag already set should stop one at once.
+static void testWorkLimits() {
+    static const struct {
+        const char *pattern;
+        size_t len;
+    } cases[] = {
+        {"^(aa+)\\1+$", 59},
+        {"^(aa+)\\1+$", 85},
+        {"^(aa+)\\1+$", 97},
+    };
+    regex_t re;
+    rm_detail_t details;
+    regmatch_t match[2];
+    MO_unichar str[10001];
+    char expected[64];
+    char result[64];
+    volatile int cancel;
+    long used;
+    unsigned i;
+    size_t len;
+    size_t k;
+    int err;
+
+    for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        if (compileRE(&re, cases[i].pattern, REG_ADVANCED) != REG_OKAY) {
+            check(0, "'%s' did not compile", cases[i].pattern);
+            continue;
+        }
+        for (k = 0; k < cases[i].len; k++) {
+            str[k] = 'a';
+        }
+        err = MO_ReExec(&re, str, cases[i].len, NULL, 2, match, 0);
+        formatMatch(err, match, expected);
+
+        // no limit, just counting
+        memset(&details, 0, sizeof(details));
+        err = MO_ReExec(&re, str, cases[i].len, &details, 2, match, REG_LIMIT);
+        formatMatch(err, match, result);
+        used = details.rm_limit.rl_used;
+        check((err == REG_OKAY || err == REG_NOMATCH) && strcmp(result, expected) == 0 && used > 100, "'%s' on %lu a's with no limit gave %s (error %d) in %ld steps, expected %s in over 100", cases[i].pattern, (unsigned long)cases[i].len, result, err, used, expected);
+
+        // just enough
+        memset(&details, 0, sizeof(details));
+        details.rm_limit.rl_steps = used;
+        err = MO_ReExec(&re, str, cases[i].len, &details, 2, match, REG_LIMIT);
+        formatMatch(err, match, result);
+        check((err == REG_OKAY || err == REG_NOMATCH) && strcmp(result, expected) == 0 && details.rm_limit.rl_used == used, "'%s' on %lu a's limited to %ld steps gave %s (error %d) in %ld steps, expected %s", cases[i].pattern, (unsigned long)cases[i].len, used, result, err, details.rm_limit.rl_used, expected);
+
+        // one step short, or far short
+        memset(&details, 0, sizeof(details));
+        details.rm_limit.rl_steps = used - 1;
+        err = MO_ReExec(&re, str, cases[i].len, &details, 2, match, REG_LIMIT);
+        check(err == REG_ELIMIT, "'%s' on %lu a's limited to %ld steps gave error %d, expected REG_ELIMIT", cases[i].pattern, (unsigned long)cases[i].len, used - 1, err);
+        memset(&details, 0, sizeof(details));
+        details.rm_limit.rl_steps = 10;
+        err = MO_ReExec(&re, str, cases[i].len, &details, 2, match, REG_LIMIT);
+        check(err == REG_ELIMIT && details.rm_limit.rl_used > 10 && details.rm_limit.rl_used < used, "'%s' on %lu a's limited to 10 steps gave error %d after %ld steps, expected REG_ELIMIT soon after 10", cases[i].pattern, (unsigned long)cases[i].len, err, details.rm_limit.rl_used);
+
+        // cancelled, or not
+        cancel = 0;
+        memset(&details, 0, sizeof(details));
+        details.rm_limit.rl_cancel = &cancel;
+        err = MO_ReExec(&re, str, cases[i].len, &details, 2, match, REG_LIMIT);
+        formatMatch(err, match, result);
+        check((err == REG_OKAY || err == REG_NOMATCH) && strcmp(result, expected) == 0, "'%s' on %lu a's with a clear cancel flag gave %s (error %d), expected %s", cases[i].pattern, (unsigned long)cases[i].len, result, err, expected);
+        cancel = 1;
+        err = MO_ReExec(&re, str, cases[i].len, &details, 2, match, REG_LIMIT);
+        check(err == REG_ELIMIT, "'%s' on %lu a's with the cancel flag set gave error %d, expected REG_ELIMIT", cases[i].pattern, (unsigned long)cases[i].len, err);
+        MO_ReFree(&re);
+    }
+
+    // a long scan that has only the DFA to do sees the cancel flag too
+    compileRE(&re, "a[ab]{40}c", REG_ADVANCED);
+    len = abString(81, 10000, str);
+    cancel = 1;
+    memset(&details, 0, sizeof(details));
+    details.rm_limit.rl_cancel = &cancel;
+    err = MO_ReExec(&re, str, len, &details, 0, NULL, REG_LIMIT);
+    check(err == REG_ELIMIT, "a long scan with the cancel flag set gave error %d, expected REG_ELIMIT", err);
+
+    // bad limits
+    memset(&details, 0, sizeof(details));
+    details.rm_limit.rl_steps = -1;
+    err = MO_ReExec(&re, str, 1, &details, 0, NULL, REG_LIMIT);
+    check(err == REG_INVARG, "a limit of -1 steps gave error %d, expected REG_INVARG", err);
+    err = MO_ReExec(&re, str, 1, NULL, 0, NULL, REG_LIMIT);
+    check(err == REG_INVARG, "REG_LIMIT without details gave error %d, expected REG_INVARG", err);
+    MO_ReFree(&re);
+}
+
+// Formats the matches an iteration finds as "[so,eo)" pairs, one after another.
+static int iterate(const char *pattern, int cflags, const char *str, int eflags, char *result) {
+    regex_t re;
+    regiter_t it;
+    regmatch_t match;
+    MO_unichar buf[256];
+    size_t len = widen(str, buf);
+    int err;
+
+    result[0] = '\0';
+    err = compileRE(&re, pattern, cflags);
+    if (err != REG_OKAY) {
+        return err;
+    }
+    err = MO_ReIterBegin(&it, &re, buf, len, NULL, eflags);
+    if (err == REG_OKAY) {
+        while ((err = MO_ReIterNext(&it, 1, &match)) == REG_OKAY) {
+            sprintf(result + strlen(result), "[%ld,%ld)", (long)match.rm_so, (long)match.rm_eo);
+        }
+        MO_ReIterEnd(&it);
+    }
+    MO_ReFree(&re);
+    return (err == REG_NOMATCH) ? REG_OKAY : err;
+}
+
+static void testIteration() {
+    static const struct {
+        const char *pattern;
+        int cflags;
+        const char *str;
+        int eflags;
+        const char *matches;
+    } cases[] = {
+        // an empty match moves the next search on by one chr
+        {"x*", REG_ADVANCED, "abc", 0, "[0,0)[1,1)[2,2)[3,3)"},
+        {"a*", REG_ADVANCED, "baac", 0, "[0,0)[1,3)[3,3)[4,4)"},
+        {"", REG_ADVANCED, "ab", 0, "[0,0)[1,1)[2,2)"},
+        {"b*?", REG_ADVANCED, "bb", 0, "[0,0)[1,1)[2,2)"},
+        // the chrs before a match are context for the next search
+        {"^a", REG_ADVANCED, "aaa", 0, "[0,1)"},
+        {"^a", REG_ADVANCED, "aaa", REG_NOTBOL, ""},
+        {"^a", REG_ADVANCED|REG_NEWLINE, "a\naa", 0, "[0,1)[2,3)"},
+        {"\\mab", REG_ADVANCED, "abab ab", 0, "[0,2)[5,7)"},
+        {"\\yb", REG_ADVANCED, "bb b", 0, "[0,1)[3,4)"},
+        {"a$", REG_ADVANCED, "aa", REG_NOTEOL, ""},
+        {"(a|b)\\1", REG_ADVANCED, "aabbab bb", 0, "[0,2)[2,4)[7,9)"},
+        {"zz", REG_ADVANCED, "ab", 0, ""},
+    };
+    char result[256];
+    unsigned i;
+    int err;
+
+    for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        err = iterate(cases[i].pattern, cases[i].cflags, cases[i].str, cases[i].eflags, result);
+        check(err == REG_OKAY && strcmp(result, cases[i].matches) == 0, "iterating '%s' over '%s' gave %s (error %d), expected %s", cases[i].pattern, cases[i].str, result, err, cases[i].matches);
+    }
+}
+
+// Each match an iteration finds should be the one exec finds in what's left of the string, for REs that don't look behind where they start.
+static void testIterationAgainstExec() {
+    static const char *patterns[] = {"a*", "[ab]+", "a+?b", "(ab|a)(c|bcd)", "[0-9]{2,3}", "(a)|b", "([ab])\\1*", NULL};
+    static const char *strs[] = {"", "abab", "xx09abcd9", "aabbbcdab", "b0a1ab22a333", NULL};
+    regex_t re;
+    regiter_t it;
+    regmatch_t match[3];
+    regmatch_t expected[3];
+    MO_unichar buf[256];
+    size_t len;
+    size_t from;
+    unsigned i, j, k;
+    int err, err2;
+
+    for (i = 0; patterns[i] != NULL; i++) {
+        if (compileRE(&re, patterns[i], REG_ADVANCED) != REG_OKAY) {
+            check(0, "'%s' did not compile", patterns[i]);
+            continue;
+        }
+        for (j = 0; strs[j] != NULL; j++) {
+            len = widen(strs[j], buf);
+            from = 0;
+            MO_ReIterBegin(&it, &re, buf, len, NULL, 0);
+            do {
+                err = MO_ReIterNext(&it, 3, match);
+                err2 = (from <= len) ? MO_ReExec(&re, buf + from, len - from, NULL, 3, expected, (from > 0) ? REG_NOTBOL : 0) : REG_NOMATCH;
+                for (k = 0; err2 == REG_OKAY && k < 3; k++) {
+                    if (expected[k].rm_so >= 0) {
+                        expected[k].rm_so += from;
+                        expected[k].rm_eo += from;
+                    }
+                }
+                check(err == err2 && (err != REG_OKAY || memcmp(match, expected, sizeof(match)) == 0), "iterating '%s' over '%s' disagreed with exec at %ld", patterns[i], strs[j], (long)from);
+                if (err == REG_OKAY) {
+                    from = expected[0].rm_eo + ((expected[0].rm_eo == expected[0].rm_so) ? 1 : 0);
+                }
+            } while (err == REG_OKAY && err2 == REG_OKAY);
+            MO_ReIterEnd(&it);
+        }
+        MO_ReFree(&re);
+    }
+}
+
+// Feeds a string to a stream chunkSize chrs at a time, formatting the matches as iterate() does.
+static int stream(const char *pattern, int cflags, const char *str, size_t chunkSize, size_t max, char *result) {
+    regex_t re;
+    regstream_t rs;
+    regmatch_t match;
+    MO_unichar buf[256];
+    size_t len = widen(str, buf);
+    size_t pos, n;
+    int err;
+
+    result[0] = '\0';
+    err = compileRE(&re, pattern, cflags);
+    if (err != REG_OKAY) {
+        return err;
+    }
+    err = MO_ReStreamBegin(&rs, &re, max, NULL, 0);
+    if (err == REG_OKAY) {
+        pos = 0;
+        do {
+            n = (len - pos < chunkSize) ? len - pos : chunkSize;
+            err = MO_ReStreamFeed(&rs, buf + pos, n, (pos + n == len));
+            pos += n;
+            while (err == REG_OKAY && (err = MO_ReStreamNext(&rs, 1, &match)) == REG_OKAY) {
+                sprintf(result + strlen(result), "[%ld,%ld)", (long)match.rm_so, (long)match.rm_eo);
+            }
+        } while (err == REG_NOMATCH && pos < len);
+        MO_ReStreamEnd(&rs);
+    }
+    MO_ReFree(&re);
+    return (err == REG_NOMATCH) ? REG_OKAY : err;
+}
+
+// A stream should find just what an iteration over the whole string does, however the string is cut up.
+static void testStreams() {
+    static const char *patterns[] = {"abc", "a*", "x*", "", "[0-9]+", "(ab|a)(c|bcd)", "ab$", "a+$", "b\\M", "\\mab", "^a", "(a|b)\\1", "a+?b", "(?:c.|a)cb", NULL};
+    static const char *strs[] = {"", "a", "abc", "xabcabc", "ab ab", "aab9 0123 ab", "aabbbcdab", "abab", "bab aab", "acb", "xacxacbcacb", NULL};
+    static const size_t chunkSizes[] = {1, 2, 3, 7, 256};
+    char expected[256];
+    char result[256];
+    unsigned i, j, k;
+    int err;
+
+    for (i = 0; patterns[i] != NULL; i++) {
+        for (j = 0; strs[j] != NULL; j++) {
+            iterate(patterns[i], REG_ADVANCED, strs[j], 0, expected);
+            for (k = 0; k < sizeof(chunkSizes) / sizeof(chunkSizes[0]); k++) {
+                err = stream(patterns[i], REG_ADVANCED, strs[j], chunkSizes[k], 0, result);
+                check(err == REG_OKAY && strcmp(result, expected) == 0, "streaming '%s' over '%s' %lu chrs at a time gave %s (error %d), iterating gave %s", patterns[i], strs[j], (unsigned long)chunkSizes[k], result, err, expected);
+            }
+        }
+    }
+
+    // only a stretch that could still be a match has to be held on to
+    err = stream("a+b", REG_ADVANCED, "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaab", 1, 8, result);
+    check(err == REG_ESPACE, "streaming a long partial match with a small cap gave error %d, expected REG_ESPACE", err);
+    err = stream("a+b", REG_ADVANCED, "ccccccccccccccccccccccccccccccccccab ab", 1, 8, result);
+    check(err == REG_OKAY && strcmp(result, "[34,36)[37,39)") == 0, "streaming with a small cap gave %s (error %d), expected [34,36)[37,39)", result, err);
+
+    // a prefix cut off by the end of a chunk, with a shorter one after it
+    err = stream("(?:c.|a)cb", REG_ADVANCED, "acb", 2, 0, result);
+    check(err == REG_OKAY && strcmp(result, "[0,3)") == 0, "streaming across a cut prefix gave %s (error %d), expected [0,3)", result, err);
+}
+
+// UTF-8 text should match the same way through regexecu() and through a stream fed a byte at a time, with offsets in bytes.
+static void testUTF8() {
+    static const struct {
+        const char *pattern;
+        const char *str;
+        const char *match;
+    } cases[] = {
+        {"\xe9+", "a\xc3\xa9\xc3\xa9 b", "[1,5)"},
+        {"\\u20ac(.)", "ab\xe2\x82\xac\xc3\xa9", "[2,7)[5,7)"},
+        // malformed bytes are U+FFFD, one apiece
+        {"\\ufffd+", "a\xff\xfe" "b", "[1,3)"},
+        {"\\ufffd(x)", "\xe2\x82x", "[1,3)[2,3)"},
+        {"\\ufffd$", "a\xc3", "[1,2)"},
+        {"\\ufffd\\ufffd", "\xc0\xaf", "[0,2)"},
+        // past the BMP, both surrogate halves are at the sequence's offset
+        {"\\ud83d\\ude00", "x\xf0\x9f\x98\x80y", "[1,5)"},
+        {"\\ude00", "x\xf0\x9f\x98\x80y", "[1,5)"},
+        {"\\ud83d", "x\xf0\x9f\x98\x80y", "[1,1)"},
+        {"(.)y", "x\xf0\x9f\x98\x80y", "[1,6)[1,5)"},
+        // lookahead constraints take the other way through regexecu()
+        {"a(?=\xe9)", "ba\xc3\xa9", "[1,2)"},
+        {"(?!\xe9).b", "\xc3\xa9" "bab", "[3,5)"},
+        {"\xe9\\M", "\xc3\xa9\xc3\xa9 x", "[2,4)"},
+        {"zz", "\xc3\xa9", ""},
+    };
+    regex_t re;
+    regstream_t rs;
+    regmatch_t match[2];
+    char expected[64];
+    char result[64];
+    static char text[4094 + 3];
+    size_t len, pos;
+    unsigned i;
+    int err;
+
+    for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        if (compileRE(&re, cases[i].pattern, REG_ADVANCED) != REG_OKAY) {
+            check(0, "'%s' did not compile", cases[i].pattern);
+            continue;
+        }
+        len = strlen(cases[i].str);
+        strcpy(expected, cases[i].match);
+
+        err = MO_ReExecUTF8(&re, cases[i].str, len, NULL, 2, match, 0);
+        formatMatch(err, match, result);
+        check((err == REG_OKAY || err == REG_NOMATCH) && strcmp(result, expected) == 0, "regexecu() of '%s' gave %s (error %d), expected %s", cases[i].pattern, result, err, expected);
+
+        err = MO_ReStreamBegin(&rs, &re, 0, NULL, 0);
+        if (err == REG_INVARG) {
+            MO_ReFree(&re);
+            continue;   // lookahead constraints can't be streamed
+        }
+        for (pos = 0, err = REG_NOMATCH; err == REG_NOMATCH && pos < len; pos++) {
+            err = MO_ReStreamFeedUTF8(&rs, cases[i].str + pos, 1, (pos + 1 == len));
+            if (err == REG_OKAY) {
+                err = MO_ReStreamNext(&rs, 2, match);
+            }
+        }
+        MO_ReStreamEnd(&rs);
+        formatMatch(err, match, result);
+        check((err == REG_OKAY || err == REG_NOMATCH) && strcmp(result, expected) == 0, "regsfeedu() of '%s' a byte at a time gave %s (error %d), expected %s", cases[i].pattern, result, err, expected);
+        MO_ReFree(&re);
+    }
+
+    // regexecu() feeds its stream 4096 bytes at a time; a prefix cut off by the first chunk's end has to wait for the next
+    memset(text, 'x', 4094);
+    memcpy(text + 4094, "acb", 3);
+    if (compileRE(&re, "(?:c.|a)cb", REG_ADVANCED) == REG_OKAY) {
+        err = MO_ReExecUTF8(&re, text, sizeof(text), NULL, 1, match, 0);
+        formatMatch(err, match, result);
+        check(err == REG_OKAY && strcmp(result, "[4094,4097)") == 0, "regexecu() across a chunk boundary gave %s (error %d), expected [4094,4097)", result, err);
+        MO_ReFree(&re);
+    } else {
+        check(0, "'(?:c.|a)cb' did not compile");
+    }
+}
+
+// The 8-bit build, through its char names, should know Latin-1 and nothing past it.
+static void test8Bit() {
+    static const struct {
+        const char *pattern;
+        int cflags;
+        const char *str;
+        int err;
+        const char *match;
+    } cases[] = {
+        // Latin-1 case folding
+        {"\xe9+", REG_ADVANCED|REG_ICASE, "x\xc9\xe9", REG_OKAY, "[1,3)"},
+        {"[\xe0-\xe2]+", REG_ADVANCED|REG_ICASE, "a\xc1\xc0\xe2", REG_OKAY, "[1,4)"},
+        {"\xde", REG_ADVANCED|REG_ICASE, "\xfe", REG_OKAY, "[0,1)"},
+        {"\xe9", REG_ADVANCED, "\xc9", REG_NOMATCH, ""},
+        {"\xd7", REG_ADVANCED|REG_ICASE, "\xf7", REG_NOMATCH, ""},
+        // counterparts past 0xff are left out, not cut down to a chr
+        {"\xff", REG_ADVANCED|REG_ICASE, "x\xff", REG_OKAY, "[1,2)"},
+        {"[\xb5\xfe-\xff]", REG_ADVANCED|REG_ICASE, "x\x9c\xb5", REG_OKAY, "[2,3)"},
+        // escapes for chrs it can't hold
+        {"\\u00e9", REG_ADVANCED, "a\xe9", REG_OKAY, "[1,2)"},
+        {"\\u0100", REG_ADVANCED, "", REG_EESCAPE, ""},
+        {"\\u20ac", REG_ADVANCED, "", REG_EESCAPE, ""},
+        {"[a\\u0101]", REG_ADVANCED, "", REG_EESCAPE, ""},
+        {"\\x100", REG_ADVANCED, "", REG_EESCAPE, ""},
+        // classes
+        {"[[:alpha:]]+", REG_ADVANCED, "1\xe9\xdfz2", REG_OKAY, "[1,4)"},
+        {"[[:upper:]]", REG_ADVANCED, "a\xe9\xc9", REG_OKAY, "[2,3)"},
+        {"[[:digit:]]+", REG_ADVANCED, "a12\xb2", REG_OKAY, "[1,3)"},
+        {"\\w+", REG_ADVANCED, " \xe7\xdf_ ", REG_OKAY, "[1,4)"},
+        {"[^[:alpha:]]", REG_ADVANCED, "\xe9\xf7", REG_OKAY, "[1,2)"},
+    };
+    regex_t re;
+    regmatch_t match;
+    char result[64];
+    unsigned i;
+    int err;
+
+    for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        result[0] = '\0';
+        err = re_comp(&re, cases[i].pattern, strlen(cases[i].pattern), cases[i].cflags);
+        if (err == REG_OKAY) {
+            err = re_exec(&re, cases[i].str, strlen(cases[i].str), NULL, 1, &match, 0);
+            if (err == REG_OKAY) {
+                sprintf(result, "[%ld,%ld)", (long)match.rm_so, (long)match.rm_eo);
+            }
+            MO_ReFree(&re);
+        }
+        check(err == cases[i].err && strcmp(result, cases[i].match) == 0, "8-bit '%s' gave %s (error %d), expected %s (error %d)", cases[i].pattern, result, err, cases[i].match, cases[i].err);
+    }
+}
+
+// Leaves the stack below the caller's frame full of 0xff bytes, so what isn't set there isn't zero by luck.
+static void dirtyStack() {
+    volatile unsigned char junk[4096];
+    size_t i;
+
+    for (i = 0; i < sizeof(junk); i++) {
+        junk[i] = 0xff;
+    }
+}
+
+// A set should find the same REs that matching each one alone finds, lowest-numbered first.
+static void testSets() {
+    static const char *patterns[] = {
+        "key[0-9]+",
+        "((((((a*)*)*)*)*)*)b",
+        "(x|y)*z",
+        "^start",
+        "(a|b)\\1",
+        "[[:digit:]]{3}",
+        "(c?)*d",
+    };
+    static const char *strs[] = {"key12", "aab", "xyz", "start", "abba", "a123", "xd", "", "none"};
+    enum { npatterns = sizeof(patterns) / sizeof(patterns[0]) };
+    MO_unichar bufs[npatterns][64];
+    const MO_unichar *pats[npatterns];
+    size_t lens[npatterns];
+    int flags[npatterns];
+    MO_unichar str[64];
+    char expected[64];
+    char result[64];
+    regex_t set, re;
+    rm_detail_t details;
+    int hits[npatterns];
+    unsigned i, j;
+    size_t len;
+    int err;
+
+    for (i = 0; i < npatterns; i++) {
+        lens[i] = widen(patterns[i], bufs[i]);
+        pats[i] = bufs[i];
+        flags[i] = REG_ADVANCED;
+    }
+    err = MO_ReSetComp(&set, npatterns, pats, lens, flags);
+    if (err != REG_OKAY) {
+        check(0, "set did not compile (error %d)", err);
+        return;
+    }
+    for (i = 0; i < sizeof(strs) / sizeof(strs[0]); i++) {
+        len = widen(strs[i], str);
+        expected[0] = '\0';
+        for (j = 0; j < npatterns; j++) {
+            if (compileRE(&re, patterns[j], REG_ADVANCED) == REG_OKAY) {
+                if (MO_ReExec(&re, str, len, NULL, 0, NULL, 0) == REG_OKAY) {
+                    sprintf(expected + strlen(expected), "%u ", j);
+                }
+                MO_ReFree(&re);
+            }
+        }
+        result[0] = '\0';
+        err = MO_ReSetExec(&set, str, len, NULL, npatterns, hits, 0);
+        for (j = 0; err == REG_OKAY && j < npatterns && hits[j] >= 0; j++) {
+            sprintf(result + strlen(result), "%d ", hits[j]);
+        }
+        check((err == REG_OKAY || err == REG_NOMATCH) && strcmp(result, expected) == 0, "set on '%s' gave %s(error %d), expected %s", strs[i], result, err, expected);
+    }
+
+    // a plain exec can't take a set
+    len = widen("key1", str);
+    err = MO_ReExec(&set, str, len, NULL, 0, NULL, 0);
+    check(err == REG_INVARG, "exec of a set gave error %d, expected REG_INVARG", err);
+    MO_ReFree(&set);
+
+    // confirming a backref RE alone used to take REG_PARALLEL along, with details left as the stack had them
+    lens[0] = widen("(a+)x\\1", bufs[0]);
+    lens[1] = widen("q", bufs[1]);
+    err = MO_ReSetComp(&set, 2, pats, lens, flags);
+    if (err != REG_OKAY) {
+        check(0, "set did not compile (error %d)", err);
+        return;
+    }
+    len = widen("baaxaa", str);
+    memset(&details, 0, sizeof(details));
+    details.rm_par.rp_threads = 2;
+    dirtyStack();
+    err = MO_ReSetExec(&set, str, len, &details, npatterns, hits, REG_PARALLEL);
+    check(err == REG_OKAY && hits[0] == 0 && hits[1] < 0, "set with REG_PARALLEL gave %d %d (error %d), expected 0 -1", hits[0], hits[1], err);
+    MO_ReFree(&set);
+}
+
+// Nested loops of EMPTY arcs used to keep fixempties() going forever.
+static void testNestedLoops() {
+    static const struct {
+        const char *pattern;
+        const char *str;
+        const char *match;
+    } cases[] = {
+        {"(((((a*)*)*)*)*)*b", "xaab", "[1,4)[3,3)"},
+        {"((((((a*)*)*)*)*)*)c", "aac", "[0,3)[0,2)"},
+        {"((a?b?)*)*c", "xabbac", "[1,6)[5,5)"},
+        // the outer loop's last time around matches nothing
+        {"(a|b*)*", "bba", "[0,3)[3,3)"},
+    };
+    regex_t re;
+    regmatch_t match[2];
+    MO_unichar str[64];
+    char result[64];
+    unsigned i;
+    int err;
+
+    for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        err = compileRE(&re, cases[i].pattern, REG_ADVANCED);
+        if (err == REG_OKAY) {
+            err = MO_ReExec(&re, str, widen(cases[i].str, str), NULL, 2, match, 0);
+            MO_ReFree(&re);
+        }
+        formatMatch(err, match, result);
+        check(err == REG_OKAY && strcmp(result, cases[i].match) == 0, "'%s' gave %s (error %d), expected %s", cases[i].pattern, result, err, cases[i].match);
+    }
+}
+
+// makesearch() splits each state the start state leads to; one with several arcs from the start used to leave others unsplit, and the search then missed the leftmost match.
+static void testSearchSplits() {
+    static const struct {
+        const char *pattern;
+        const char *str;
+        const char *match;
+    } cases[] = {
+        {"a*?.*(a+b*)*a+", "cxaA", "[0,3)"},
+        {"a*?.*(a+b*)*a+", "cxa", "[0,3)"},
+        {"((?!b)b?x{2}|x+c{2})*.??\\y", "  b", "[1,2)"},
+    };
+    regex_t re;
+    regmatch_t match;
+    MO_unichar str[64];
+    char result[64];
+    unsigned i;
+    int err;
+
+    for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        result[0] = '\0';
+        err = compileRE(&re, cases[i].pattern, REG_ADVANCED);
+        if (err == REG_OKAY) {
+            err = MO_ReExec(&re, str, widen(cases[i].str, str), NULL, 1, &match, 0);
+            if (err == REG_OKAY) {
+                sprintf(result, "[%ld,%ld)", (long)match.rm_so, (long)match.rm_eo);
+            }
+            MO_ReFree(&re);
+        }
+        check(err == REG_OKAY && strcmp(result, cases[i].match) == 0, "'%s' on '%s' gave %s (error %d), expected %s", cases[i].pattern, cases[i].str, result, err, cases[i].match);
+    }
+}
+
+// A search split among threads should find just what a sequential one does, however the string is cut up.
+static void testParallel() {
+    static const struct {
+        const char *pattern;
+        int cflags;
+    } cases[] = {
+        {"needle", REG_ADVANCED},
+        {"(x+)y", REG_ADVANCED},
+        {"a[^b]*b", REG_ADVANCED},
+        {"(ab|ba)+c", REG_ADVANCED},
+        {"\\mword(s?)\\M", REG_ADVANCED},
+        {"q.*z", REG_ADVANCED|REG_NLSTOP},
+        {"q.*z", REG_ADVANCED},
+        {"zzz", REG_ADVANCED},
+    };
+    static const size_t pieceSizes[] = {1, 3, 7, 64};
+    static const char *strs[] = {
+        "aaaaaaaaaaaa needle aaaaaaa xxxxxxy ab ba babac words word q..\nq..z ccccccc",
+        "xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxy needle a..................................b",
+        "qqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqz",
+    };
+    regex_t re;
+    rm_detail_t details;
+    regmatch_t match[2];
+    MO_unichar str[128];
+    char expected[64];
+    char result[64];
+    unsigned i, j, k;
+    int threads;
+    size_t len;
+    int err;
+
+    for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        if (compileRE(&re, cases[i].pattern, cases[i].cflags) != REG_OKAY) {
+            check(0, "'%s' did not compile", cases[i].pattern);
+            continue;
+        }
+        for (j = 0; j < sizeof(strs) / sizeof(strs[0]); j++) {
+            len = widen(strs[j], str);
+            err = MO_ReExec(&re, str, len, NULL, 2, match, 0);
+            formatMatch(err, match, expected);
+            for (k = 0; k < sizeof(pieceSizes) / sizeof(pieceSizes[0]); k++) {
+                for (threads = 2; threads <= 8; threads *= 2) {
+                    memset(&details, 0, sizeof(details));
+                    details.rm_par.rp_threads = threads;
+                    details.rm_par.rp_piece = pieceSizes[k];
+                    err = MO_ReExec(&re, str, len, &details, 2, match, REG_PARALLEL);
+                    formatMatch(err, match, result);
+                    check((err == REG_OKAY || err == REG_NOMATCH) && strcmp(result, expected) == 0, "parallel '%s' on string %u in pieces of %lu with %d threads gave %s (error %d), expected %s", cases[i].pattern, j, (unsigned long)pieceSizes[k], threads, result, err, expected);
+                }
+            }
+        }
+        MO_ReFree(&re);
+    }
+
+    // a short piece means many of them
+    compileRE(&re, "needle", REG_ADVANCED);
+    len = widen(strs[1], str);
+    memset(&details, 0, sizeof(details));
+    details.rm_par.rp_threads = 2;
+    details.rm_par.rp_piece = 4;
+    err = MO_ReExec(&re, str, len, &details, 0, NULL, REG_PARALLEL);
+    check(err == REG_OKAY && details.rm_par.rp_pieces > 1, "parallel search searched %d pieces (error %d), expected more than one", details.rm_par.rp_pieces, err);
+    MO_ReFree(&re);
+}
+
+// With captures, the reverse DFA picks each next start to try; one past the search's close used to be tried before an earlier start the next search would find.
+static void testBackwardStarts() {
+    static const struct {
+        const char *pattern;
+        const char *str;
+        const char *match;
+    } cases[] = {
+        {"(?:a|.\\w(b))\\1", "cxabaaabbb", "[5,9)"},
+        {"(?:(?:caba(?:.|.c)|(c[^a]\\d[ab]|b).c)|\\1)", "1bbaxcabacaac", "[5,10)"},
+    };
+    regex_t re;
+    regmatch_t match[2];
+    MO_unichar str[64];
+    char result[64];
+    unsigned i;
+    int err;
+
+    for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        result[0] = '\0';
+        err = compileRE(&re, cases[i].pattern, REG_ADVANCED);
+        if (err == REG_OKAY) {
+            err = MO_ReExec(&re, str, widen(cases[i].str, str), NULL, 2, match, 0);
+            if (err == REG_OKAY) {
+                sprintf(result, "[%ld,%ld)", (long)match[0].rm_so, (long)match[0].rm_eo);
+            }
+            MO_ReFree(&re);
+        }
+        check(err == REG_OKAY && strcmp(result, cases[i].match) == 0, "'%s' on '%s' gave %s (error %d), expected %s", cases[i].pattern, cases[i].str, result, err, cases[i].match);
+    }
+}
+
+void testMORegexpEngine(unsigned *totalTests, unsigned *failCount) {
+    totalTestsPtr = totalTests;
+    failCountPtr = failCount;
+
+    testKeptDFAs();
+    testStateSetIndex();
+    testColorBlocks();
+    testCacheTuning();
+    testSharedDFAs();
+    testFullDFAs();
+    testNodeDFAs();
+    testFailMemo();
+    testOnePass();
+    testThrashing();
+    testWorkLimits();
+    testIteration();
+    testIterationAgainstExec();
+    testStreams();
+    testUTF8();
+    test8Bit();
+    testSets();
+    testSearchSplits();
+    testNestedLoops();
+    testParallel();
+    testBackwardStarts();
+}
+
+
+/*
+ This file contains Original Code and/or Modifications of Original Code as defined in and that are subject to the Ferris Public Source License Version 1.2 (the 'License'). You may not use this file except in compliance with the License. Please obtain a copy of the License at http://mokit.sourceforge.net/License.html and read it before using this file.
+
+ The Original Code and all software distributed under the License are distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER EXPRESS OR IMPLIED, AND MIKE FERRIS HEREBY DISCLAIMS ALL SUCH WARRANTIES, INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT. Please see the License for the specific language governing rights and limitations under the License.
+ */
@@ -10,6 +10,9 @@
 
 #define DEFAULT_DATA_FILE @"RegexTestData.plist"
 
+// In RegexTest_engine.c
+extern void testMORegexpEngine(unsigned *totalTests, unsigned *failCount);
+
 static NSArray *readTestData() {
     NSArray *args = [[NSProcessInfo processInfo] arguments];
     unsigned argCount = [args count];
@@ -387,6 +390,8 @@ int main (int argc, const char *argv[]) {
 
     testMORegexFormatter();
 
+    testMORegexpEngine(&totalTests, &failCount);
+
     if ((failCount == 0) && (expectedFailureCount == 0)) {
         NSLog(@"SUCCESS: All %u tests succeeded.", totalTests);
     } else if (failCount == 0) {